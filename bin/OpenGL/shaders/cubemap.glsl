@@ -3,8 +3,13 @@
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
 
 out vec3 WorldPos;
 
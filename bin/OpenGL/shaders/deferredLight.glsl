@@ -5,8 +5,13 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
 uniform mat4 model;
 uniform float lightRadius;
 
@@ -3,21 +3,31 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec4 aInstanceParam;  // (RGB) light color and (A) is light radius
-layout (location = 3) in mat4 aInstanceMatrix;
-
 
 out vec3 lightColor;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
+layout (std430, binding = POINT_LIGHT_POSITION_BINDING) readonly buffer PointLightPositions
+{
+    vec4 pointLightPositions[];  // (XYZ) light position and (W) is light radius
+};
+layout (std430, binding = POINT_LIGHT_COLOR_BINDING) readonly buffer PointLightColors
+{
+    vec4 pointLightColors[];     // (RGB) light color
+};
 
 void main()
 {
 	// pass the instance light color to fragment shader
-	//vec4 position = aInstanceMatrix[3];
-	lightColor = aInstanceParam.rgb;
-    gl_Position = projection * view * aInstanceMatrix  * vec4(aInstanceParam.w * aPos, 1.0);
+	lightColor = pointLightColors[gl_InstanceID].rgb;
+	vec4 positionRadius = pointLightPositions[gl_InstanceID];
+    gl_Position = projection * view * vec4(positionRadius.w * aPos + positionRadius.xyz, 1.0);
 }
 
 -- Fragment
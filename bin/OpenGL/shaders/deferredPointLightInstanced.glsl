@@ -2,23 +2,42 @@
 -- Vertex
 
 layout (location = 0) in vec3 aPos;
-layout (location = 2) in vec4 aInstanceParam;  // (RGB) light color and (A) is light radius
-layout (location = 3) in mat4 aInstanceMatrix;
 
 out vec3 lightColor;
 out vec3 lightPosition;
 out float lightRadius;
+flat out int shadowSlot;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
+layout (std430, binding = POINT_LIGHT_POSITION_BINDING) readonly buffer PointLightPositions
+{
+    vec4 pointLightPositions[];  // (XYZ) light position and (W) is light radius
+};
+layout (std430, binding = POINT_LIGHT_COLOR_BINDING) readonly buffer PointLightColors
+{
+    vec4 pointLightColors[];     // (RGB) light color
+};
+uniform int shadowedLights[MAX_SHADOWED_POINT_LIGHTS]; // scene light index per cube map slot
+uniform int shadowedLightCount;
 
 void main()
 {
-	lightColor = aInstanceParam.rgb;
-	lightRadius = aInstanceParam.w;
-	// extract light position from the instance model matrix
-	lightPosition = vec3(aInstanceMatrix[3]);
-    gl_Position = projection * view * aInstanceMatrix * vec4(lightRadius * aPos, 1.0);
+	vec4 positionRadius = pointLightPositions[gl_InstanceID];
+	lightColor = pointLightColors[gl_InstanceID].rgb;
+	lightRadius = positionRadius.w;
+	lightPosition = positionRadius.xyz;
+	// cube map slot of this light, -1 when it casts no shadow
+	shadowSlot = -1;
+	for(int slot = 0; slot < shadowedLightCount; ++slot)
+		if(shadowedLights[slot] == gl_InstanceID)
+			shadowSlot = slot;
+    gl_Position = projection * view * vec4(lightRadius * aPos + lightPosition, 1.0);
 }
 
 -- Fragment
@@ -28,39 +47,154 @@ layout (location = 0) out vec4 FragColor;
 in vec3 lightColor;
 in float lightRadius;
 in vec3 lightPosition;
+flat in int shadowSlot;
 
+#if GBUFFER_COMPACT
+uniform sampler2D gDepth;     // depth buffer, positions are reconstructed from it
+uniform sampler2D gNormal;    // octahedral normal (RG16 snorm)
+uniform sampler2D gDiffuse;
+uniform sampler2D gSpecular;  // r - specular intensity, g - log2(gloss) / 8
+#else
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gDiffuse;
 uniform sampler2D gSpecular;
-uniform vec3 viewPos;
+#endif
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
 uniform float lightIntensity;
 uniform vec2 screenSize;
 uniform float glossiness;
+uniform samplerCubeArray pointShadowMaps;
+
+#if GBUFFER_COMPACT
+// inverse of the octahedral mapping written by gBuffer.glsl
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
+
+// undo the optimized 16 bit moment quantization
+vec4 convertOptimizedMoments(vec4 optimizedMoments)
+{
+#if MSM_OPTIMIZED_MOMENTS
+    optimizedMoments[0] -= 0.035955884801;
+    return mat4(0.2227744146, 0.1549679261, 0.1451988946, 0.163127443,
+                0.0771972861, 0.1394629426, 0.2120202157, 0.2591432266,
+                0.7926986636, 0.7963415838, 0.7258694464, 0.6539092497,
+                0.0319417555, -0.1722823173, -0.2758014811, -0.3376131734) * optimizedMoments;
+#else
+    return optimizedMoments;
+#endif
+}
+
+float calculateMSMHamburger(vec4 moments, float frag_depth, float depth_bias, float moment_bias)
+{
+    // Bias input data to avoid artifacts
+    vec4 b = mix(moments, vec4(0.5f, 0.5f, 0.5f, 0.5f), moment_bias);
+    vec3 z;
+    z[0] = frag_depth - depth_bias;
+
+    // Compute a Cholesky factorization of the Hankel matrix B storing only non-
+    // trivial entries or related products
+    float L32D22 = fma(-b[0], b[1], b[2]);
+    float D22 = fma(-b[0], b[0], b[1]);
+    float squaredDepthVariance = fma(-b[1], b[1], b[3]);
+    float D33D22 = dot(vec2(squaredDepthVariance, -L32D22), vec2(D22, L32D22));
+    float InvD22 = 1.0f / D22;
+    float L32 = L32D22 * InvD22;
+
+    // Obtain a scaled inverse image of bz = (1,z[0],z[0]*z[0])^T
+    vec3 c = vec3(1.0f, z[0], z[0] * z[0]);
+
+    // Forward substitution to solve L*c1=bz
+    c[1] -= b.x;
+    c[2] -= b.y + L32 * c[1];
+
+    // Scaling to solve D*c2=c1
+    c[1] *= InvD22;
+    c[2] *= D22 / D33D22;
+
+    // Backward substitution to solve L^T*c3=c2
+    c[1] -= L32 * c[2];
+    c[0] -= dot(c.yz, b.xy);
+
+    // Solve the quadratic equation c[0]+c[1]*z+c[2]*z^2 to obtain solutions
+    // z[1] and z[2]
+    float p = c[1] / c[2];
+    float q = c[0] / c[2];
+    float D = (p * p * 0.25f) - q;
+    float r = sqrt(D);
+    z[1] =- p * 0.5f - r;
+    z[2] =- p * 0.5f + r;
+
+    // Compute the shadow intensity by summing the appropriate weights
+    vec4 switchVal = (z[2] < z[0]) ? vec4(z[1], z[0], 1.0f, 1.0f) :
+                      ((z[1] < z[0]) ? vec4(z[0], z[1], 0.0f, 1.0f) :
+                      vec4(0.0f,0.0f,0.0f,0.0f));
+    float quotient = (switchVal[0] * z[2] - b[0] * (switchVal[0] + z[2]) + b[1])/((z[2] - switchVal[1]) * (z[0] - z[1]));
+    float shadowIntensity = switchVal[2] + switchVal[3] * quotient;
+    return 1.0f - clamp(shadowIntensity, 0.0f, 1.0f);
+}
+
+// moment shadow of the point light from its cube map, 1.0 for lights without one
+float calculatePointShadow(vec3 fragPos)
+{
+	if(shadowSlot < 0)
+		return 1.0;
+	vec3 lightToFrag = fragPos - lightPosition;
+	float depth = length(lightToFrag) / lightRadius;
+	vec4 moments = texture(pointShadowMaps, vec4(lightToFrag, float(shadowSlot)));
+	float shadow = calculateMSMHamburger(convertOptimizedMoments(moments), depth, 0.0, 0.0003);
+	// same light bleeding reduction as the global light
+	return clamp((shadow - 0.2) / 0.8, 0.0, 1.0);
+}
 
 void main()
 {
 	vec2 uvCoords = gl_FragCoord.xy / screenSize;
-	vec3 FragPos = texture(gPosition, uvCoords).rgb;
-	vec3 Normal = texture(gNormal, uvCoords).rgb;
-	vec3 Diffuse = texture(gDiffuse, uvCoords).rgb;
-	vec4 Specular = texture(gSpecular, uvCoords);
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec3 Diffuse = texelFetch(gDiffuse, texel, 0).rgb;
+#if GBUFFER_COMPACT
+	// position from the depth buffer, normal and specular unpacked
+	float depth = texelFetch(gDepth, texel, 0).r;
+	vec4 worldPos = inverseViewProjection * vec4(vec3(uvCoords, depth) * 2.0 - 1.0, 1.0);
+	vec3 FragPos = worldPos.xyz / worldPos.w;
+	vec3 Normal = decodeOctahedral(texelFetch(gNormal, texel, 0).rg);
+	vec2 packedSpecular = texelFetch(gSpecular, texel, 0).rg;
+	vec4 Specular = vec4(vec3(1.0), packedSpecular.r);
+	float gloss = exp2(packedSpecular.g * 8.0);
+#else
+	vec3 FragPos = texelFetch(gPosition, texel, 0).rgb;
+	vec3 Normal = texelFetch(gNormal, texel, 0).rgb;
+	vec4 Specular = texelFetch(gSpecular, texel, 0);
+	float gloss = glossiness;
+#endif
 	
 	// do Phong lighting calculation
 	vec3 ambient  = Diffuse * 0.2; // ambient contribution
-	vec3 viewDir  = normalize(viewPos - FragPos);
+	vec3 viewDir  = normalize(viewPos.xyz - FragPos);
 	
 	// diffuse
 	vec3 lightDir = normalize(lightPosition - FragPos);
 	vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lightColor;
 	// specular
 	vec3 halfwayDir = normalize(lightDir + viewDir);  
-	float spec = pow(max(dot(Normal, halfwayDir), 0.0), glossiness) * Specular.a;
+	float spec = pow(max(dot(Normal, halfwayDir), 0.0), gloss) * Specular.a;
 	vec3 specular = lightColor * spec * Specular.rgb;
 	// attenuation
 	float distToL = length(lightPosition - FragPos);
 	float attenuation = 1.0 - pow(smoothstep(0.0, 1.0, clamp(distToL/lightRadius, 0.0, 1.0)), 4.0);
-	vec3 result = ambient + diffuse + specular;
+	vec3 result = ambient + (diffuse + specular) * calculatePointShadow(FragPos);
 	float noZTestFix = step(0.0, lightRadius - distToL); //0.0 if distToL > radius, 1.0 otherwise
 	vec4 outColor = vec4(result, noZTestFix) * attenuation * lightIntensity;
 	
@@ -1,43 +1,114 @@
+-- _global
 
--- Vertex
-
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-
-out vec2 TexCoords;
-
-void main()
-{
-    TexCoords = aTexCoords;
-    gl_Position = vec4(aPos, 1.0);
-}
-
--- Fragment
-
-out vec4 FragColor;
-
-in vec2 TexCoords;
-
+#if GBUFFER_COMPACT
+uniform sampler2D gDepth;     // depth buffer, positions are reconstructed from it
+uniform sampler2D gNormal;    // octahedral normal (RG16 snorm)
+uniform sampler2D gDiffuse;
+uniform sampler2D gSpecular;  // r - specular intensity, g - log2(gloss) / 8
+#else
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gDiffuse;
 uniform sampler2D gSpecular;
+#endif
 uniform sampler2D shadowMap;
-uniform mat4 lightSpaceMatrix;
+uniform usampler2D shadowSAT;
+uniform sampler2DArray cascadeShadowMap;
 uniform float glossiness;
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-    
-    float Linear;
-    float Quadratic;
-	float Radius;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
+
+layout (std140, binding = FRAME_UBO_BINDING) uniform FrameConstants
+{
+    mat4 lightSpaceMatrix;
+    vec4 lightPosition;    // xyz - global light position
+    vec4 lightColor;       // rgb - global light color
+    vec4 lightAttenuation; // x - linear, y - quadratic
 };
 
-uniform Light gLight;
-uniform vec3 viewPos;
 uniform int shadowMethod; // 0 - standard, 1 - MSM
+uniform int shadowFilter; // 0 - blurred moment map, 1 - summed-area table
+uniform int satKernelSize; // box size in texels used with the summed-area table
+uniform int cascadeCount;  // 0 - single shadow map, otherwise number of cascades
+uniform mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+uniform float cascadeSplits[MAX_SHADOW_CASCADES]; // view depth at which each cascade ends
+uniform vec3 cameraForward;
+
+// fraction of a cascade over which it fades into the next one
+const float cCascadeBlendFraction = 0.1;
+
+// decoded G-buffer contents of a pixel
+struct GBufferSample
+{
+    vec3 position;         // world position
+    vec3 normal;
+    vec3 diffuse;
+    vec4 specular;         // rgb - specular color, a - intensity
+    float gloss;
+    bool covered;          // false for background pixels
+};
+
+#if GBUFFER_COMPACT
+// inverse of the octahedral mapping written by gBuffer.glsl
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// world position of a G-buffer texel from its depth
+vec3 reconstructPosition(ivec2 texel, float depth)
+{
+    vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(gDepth, 0));
+    vec4 worldPos = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return worldPos.xyz / worldPos.w;
+}
+#endif
+
+GBufferSample readGBuffer(ivec2 texel)
+{
+    GBufferSample g;
+    g.diffuse = texelFetch(gDiffuse, texel, 0).rgb;
+#if GBUFFER_COMPACT
+    float depth = texelFetch(gDepth, texel, 0).r;
+    vec2 packedSpecular = texelFetch(gSpecular, texel, 0).rg;
+    g.position = reconstructPosition(texel, depth);
+    g.normal = decodeOctahedral(texelFetch(gNormal, texel, 0).rg);
+    g.specular = vec4(vec3(1.0), packedSpecular.r);
+    g.gloss = exp2(packedSpecular.g * 8.0);
+    g.covered = depth < 1.0;
+#else
+    g.position = texelFetch(gPosition, texel, 0).rgb;
+    g.normal = texelFetch(gNormal, texel, 0).rgb;
+    g.specular = texelFetch(gSpecular, texel, 0);
+    g.gloss = glossiness;
+    g.covered = dot(g.normal, g.normal) > 0.0;
+#endif
+    return g;
+}
+
+// undo the optimized 16 bit moment quantization, the basis change is linear so it
+// commutes with the box filtering and can be applied to the filtered moments
+vec4 convertOptimizedMoments(vec4 optimizedMoments)
+{
+#if MSM_OPTIMIZED_MOMENTS
+    optimizedMoments[0] -= 0.035955884801;
+    return mat4(0.2227744146, 0.1549679261, 0.1451988946, 0.163127443,
+                0.0771972861, 0.1394629426, 0.2120202157, 0.2591432266,
+                0.7926986636, 0.7963415838, 0.7258694464, 0.6539092497,
+                0.0319417555, -0.1722823173, -0.2758014811, -0.3376131734) * optimizedMoments;
+#else
+    return optimizedMoments;
+#endif
+}
 
 float calculateShadow(vec3 fragPos, vec3 normal)
 {
@@ -47,10 +118,10 @@ float calculateShadow(vec3 fragPos, vec3 normal)
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
     // calculate bias
-    vec3 lightDir = normalize(gLight.Position - fragPos);
+    vec3 lightDir = normalize(lightPosition.xyz - fragPos);
     float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
 	
-    float shadowDepth = texture(shadowMap, projCoords.xy).r; 
+    float shadowDepth = convertOptimizedMoments(texture(shadowMap, projCoords.xy)).r; 
 	
     float shadowCoef = projCoords.z - bias > shadowDepth  ? 0.0 : 1.0;
 	
@@ -120,6 +191,29 @@ float calculateMSMHamburger(vec4 moments, float frag_depth, float depth_bias, fl
     return 1.0f - clamp(shadowIntensity, 0.0f, 1.0f);
 }
 
+// fetch an inclusive SAT entry, everything left of / below the map sums to zero
+uvec4 fetchSAT(ivec2 texel)
+{
+    if(texel.x < 0 || texel.y < 0)
+        return uvec4(0u);
+    return texelFetch(shadowSAT, min(texel, cRTScreenSizeI.zw - 1), 0);
+}
+
+// average moments over a kernelSize x kernelSize box centered on uv with 4 SAT taps
+vec4 filterMomentsSAT(vec2 uv, int kernelSize)
+{
+    int halfSize = kernelSize / 2;
+    ivec2 center = ivec2(uv * vec2(cRTScreenSizeI.zw));
+    // exclusive lower and inclusive upper corner; at the map edges the box is cut off and averaged
+    // over the texels left, unlike the blur passes, which repeat the edge texels over the full kernel
+    ivec2 lower = max(center - halfSize - 1, ivec2(-1));
+    ivec2 upper = min(center + halfSize, cRTScreenSizeI.zw - 1);
+    // unsigned wrap-around makes the difference exact even if the corner sums overflowed
+    uvec4 boxSum = fetchSAT(upper) - fetchSAT(ivec2(lower.x, upper.y)) - fetchSAT(ivec2(upper.x, lower.y)) + fetchSAT(lower);
+    float area = float((upper.x - lower.x) * (upper.y - lower.y));
+    return vec4(boxSum) / (area * SAT_FIXED_POINT_SCALE);
+}
+
 float calculateShadow4MSM(vec3 fragPos)
 {
     vec4 fragPosLightSpace = lightSpaceMatrix * vec4(fragPos, 1.0);
@@ -132,37 +226,90 @@ float calculateShadow4MSM(vec3 fragPos)
         return 1.0;
 	
     float currentDepth = projCoords.z;
+
+    vec4 moments;
+    if(shadowFilter == 1) {
+        // nothing outside the light's frustum is shadowed (matches the white border of the shadow map)
+        if(any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
+            return 1.0;
+        moments = filterMomentsSAT(projCoords.xy, satKernelSize);
+    }
+    else {
+        moments = texture(shadowMap, projCoords.xy);
+    }
 	
-    return calculateMSMHamburger(texture(shadowMap, projCoords.xy), currentDepth, 0.0000, 0.0003);
+    return calculateMSMHamburger(convertOptimizedMoments(moments), currentDepth, 0.0000, 0.0003);
 }
 
-void main()
-{             
-    // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gDiffuse, TexCoords).rgb;
-    vec4 Specular = texture(gSpecular, TexCoords);
-	
+// shadow term of a single cascade, MSM results are returned before light bleeding reduction
+float calculateCascadeShadow(vec3 fragPos, vec3 normal, int cascade)
+{
+    vec4 fragPosLightSpace = cascadeMatrices[cascade] * vec4(fragPos, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz * 0.5 + 0.5;
+    // keep the shadow at 1.0 when outside the zFar region of the light's frustum.
+    if(projCoords.z > 1.0)
+        return 1.0;
+
+    vec4 moments = convertOptimizedMoments(texture(cascadeShadowMap, vec3(projCoords.xy, float(cascade))));
+    if(shadowMethod == 1)
+        return calculateMSMHamburger(moments, projCoords.z, 0.0000, 0.0003);
+
+    vec3 lightDir = normalize(lightPosition.xyz - fragPos);
+    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
+    return projCoords.z - bias > moments.r ? 0.0 : 1.0;
+}
+
+float calculateCascadedShadow(vec3 fragPos, vec3 normal)
+{
+    // pick the cascade by view depth, nothing beyond the last split is shadowed
+    float viewDepth = dot(fragPos - viewPos.xyz, cameraForward);
+    if(viewDepth > cascadeSplits[cascadeCount - 1])
+        return 1.0;
+    int cascade = 0;
+    while(cascade < cascadeCount - 1 && viewDepth > cascadeSplits[cascade])
+        cascade++;
+
+    float shadow = calculateCascadeShadow(fragPos, normal, cascade);
+
+    // fade into the next cascade near the end of the split to hide the seam
+    if(cascade + 1 < cascadeCount) {
+        float splitStart = cascade == 0 ? 0.0 : cascadeSplits[cascade - 1];
+        float blendStart = mix(cascadeSplits[cascade], splitStart, cCascadeBlendFraction);
+        if(viewDepth > blendStart) {
+            float nextShadow = calculateCascadeShadow(fragPos, normal, cascade + 1);
+            shadow = mix(shadow, nextShadow, linstep(blendStart, cascadeSplits[cascade], viewDepth));
+        }
+    }
+    return shadow;
+}
+
+// global light (with its shadow) at a G-buffer sample, shared by the fragment and the tiled compute path
+vec3 shadeGlobalLight(vec3 FragPos, vec3 Normal, vec3 Diffuse, vec4 Specular, float Gloss)
+{
     // do Phong lighting calculation
     vec3 ambient  = Diffuse * 0.2; // hard-coded ambient component
-    vec3 viewDir  = normalize(viewPos - FragPos);
+    vec3 viewDir  = normalize(viewPos.xyz - FragPos);
 	
     // diffuse
-    vec3 lightDir = normalize(gLight.Position - FragPos);
-    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * gLight.Color;
+    vec3 lightDir = normalize(lightPosition.xyz - FragPos);
+    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lightColor.rgb;
     // specular
     vec3 halfwayDir = normalize(lightDir + viewDir);  
-    float spec = pow(max(dot(Normal, halfwayDir), 0.0), glossiness) * Specular.a;
-    vec3 specular = gLight.Color * spec * Specular.rgb;
+    float spec = pow(max(dot(Normal, halfwayDir), 0.0), Gloss) * Specular.a;
+    vec3 specular = lightColor.rgb * spec * Specular.rgb;
     // attenuation
-    float distance = length(gLight.Position - FragPos);
-    float attenuation = 1.0 / (1.0 + gLight.Linear * distance + gLight.Quadratic * distance * distance);
+    float distance = length(lightPosition.xyz - FragPos);
+    float attenuation = 1.0 / (1.0 + lightAttenuation.x * distance + lightAttenuation.y * distance * distance);
     diffuse *= attenuation;
     specular *= attenuation;
 	
     float shadowFactor = 1.0;
-    if(shadowMethod == 1) {
+    if(cascadeCount > 0) {
+        shadowFactor = calculateCascadedShadow(FragPos, Normal);
+        if(shadowMethod == 1)
+            shadowFactor = reduceLightBleeding(shadowFactor, 0.2);
+    }
+    else if(shadowMethod == 1) {
     	// calculate shadow using Moment Shadow Map
 	shadowFactor = calculateShadow4MSM(FragPos);
 	// use linear step function to reduce light bleeding more
@@ -173,7 +320,174 @@ void main()
 	shadowFactor = calculateShadow(FragPos, Normal);	
     }
 	
-    vec3 result = ambient + (diffuse + specular) * shadowFactor;
+    return ambient + (diffuse + specular) * shadowFactor;
+}
+
+-- Vertex
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = vec4(aPos, 1.0);
+}
+
+-- Fragment
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+void main()
+{             
+    // retrieve data from gbuffer (the quad covers it texel for texel)
+    GBufferSample g = readGBuffer(ivec2(gl_FragCoord.xy));
+	
+    vec3 result = shadeGlobalLight(g.position, g.normal, g.diffuse, g.specular, g.gloss);
 			
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
+
+-- TiledCompute
+
+// Tiled deferred lighting: one workgroup per screen tile reads its G-buffer samples once,
+// culls the point lights against the world space bounds of those samples and then shades
+// the global light and every point light of the tile list in a single pass.
+layout (local_size_x = LIGHT_TILE_SIZE, local_size_y = LIGHT_TILE_SIZE, local_size_z = 1) in;
+
+layout (rgba8, binding = 0) uniform writeonly image2D lightingResult;
+
+// the same point light storage buffers the light volumes are drawn from
+layout (std430, binding = POINT_LIGHT_POSITION_BINDING) readonly buffer PointLightPositions
+{
+    vec4 pointLightPositions[];  // (XYZ) light position and (W) is light radius
+};
+layout (std430, binding = POINT_LIGHT_COLOR_BINDING) readonly buffer PointLightColors
+{
+    vec4 pointLightColors[];     // (RGB) light color
+};
+
+uniform int pointLightCount;
+uniform float lightIntensity;
+uniform samplerCubeArray pointShadowMaps;
+uniform int shadowedLights[MAX_SHADOWED_POINT_LIGHTS]; // scene light index per cube map slot
+uniform int shadowedLightCount;
+
+shared uint sTileMin[3];
+shared uint sTileMax[3];
+shared uint sTileLightCount;
+shared uint sTileLights[LIGHT_TILE_MAX_LIGHTS];
+
+// order preserving mapping of floats to uints, so the tile bounds can use integer atomics
+uint orderedFloat(float value)
+{
+    uint bits = floatBitsToUint(value);
+    return (bits & 0x80000000u) != 0u ? ~bits : bits | 0x80000000u;
+}
+
+float unorderedFloat(uint value)
+{
+    return uintBitsToFloat((value & 0x80000000u) != 0u ? value & 0x7FFFFFFFu : ~value);
+}
+
+// moment shadow of a point light from its cube map, 1.0 for lights without one
+float calculatePointShadow(vec3 fragPos, vec3 pointPosition, float radius, uint light)
+{
+    int slot = -1;
+    for(int i = 0; i < shadowedLightCount; ++i)
+        if(shadowedLights[i] == int(light))
+            slot = i;
+    if(slot < 0)
+        return 1.0;
+    vec3 lightToFrag = fragPos - pointPosition;
+    vec4 moments = textureLod(pointShadowMaps, vec4(lightToFrag, float(slot)), 0.0);
+    float shadow = calculateMSMHamburger(convertOptimizedMoments(moments), length(lightToFrag) / radius, 0.0, 0.0003);
+    return reduceLightBleeding(shadow, 0.2);
+}
+
+// same lighting model as deferredPointLightInstanced.glsl
+vec3 shadePointLight(uint light, vec3 FragPos, vec3 Normal, vec3 Diffuse, vec4 Specular, float Gloss, vec3 viewDir)
+{
+    vec4 positionRadius = pointLightPositions[light];
+    vec3 pointColor = pointLightColors[light].rgb;
+    vec3 pointPosition = positionRadius.xyz;
+    float radius = positionRadius.w;
+    float distToL = length(pointPosition - FragPos);
+    if(distToL >= radius)
+        return vec3(0.0);
+
+    vec3 ambient = Diffuse * 0.2;
+    vec3 lightDir = normalize(pointPosition - FragPos);
+    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * pointColor;
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(Normal, halfwayDir), 0.0), Gloss) * Specular.a;
+    vec3 specular = pointColor * spec * Specular.rgb;
+    float attenuation = 1.0 - pow(smoothstep(0.0, 1.0, clamp(distToL / radius, 0.0, 1.0)), 4.0);
+    float shadow = calculatePointShadow(FragPos, pointPosition, radius, light);
+    return (ambient + (diffuse + specular) * shadow) * attenuation * lightIntensity;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 screenSize = imageSize(lightingResult);
+    bool onScreen = all(lessThan(pixel, screenSize));
+    uint localIndex = gl_LocalInvocationIndex;
+
+    if(localIndex == 0u) {
+        for(int i = 0; i < 3; ++i) {
+            sTileMin[i] = 0xFFFFFFFFu;
+            sTileMax[i] = 0u;
+        }
+        sTileLightCount = 0u;
+    }
+    barrier();
+
+    // read the G-buffer once per pixel
+    GBufferSample g = readGBuffer(min(pixel, screenSize - 1));
+
+    // background pixels don't grow the tile bounds
+    bool hasGeometry = onScreen && g.covered;
+    if(hasGeometry) {
+        for(int i = 0; i < 3; ++i) {
+            atomicMin(sTileMin[i], orderedFloat(g.position[i]));
+            atomicMax(sTileMax[i], orderedFloat(g.position[i]));
+        }
+    }
+    barrier();
+
+    // cull the point lights against the bounds of the tile, every invocation tests a subset
+    // (lights beyond LIGHT_TILE_MAX_LIGHTS in a single tile are dropped)
+    if(sTileMin[0] <= sTileMax[0]) {
+        vec3 boundsMin = vec3(unorderedFloat(sTileMin[0]), unorderedFloat(sTileMin[1]), unorderedFloat(sTileMin[2]));
+        vec3 boundsMax = vec3(unorderedFloat(sTileMax[0]), unorderedFloat(sTileMax[1]), unorderedFloat(sTileMax[2]));
+        for(uint light = localIndex; light < uint(pointLightCount); light += uint(LIGHT_TILE_SIZE * LIGHT_TILE_SIZE)) {
+            vec4 positionRadius = pointLightPositions[light];
+            vec3 offset = clamp(positionRadius.xyz, boundsMin, boundsMax) - positionRadius.xyz;
+            if(dot(offset, offset) < positionRadius.w * positionRadius.w) {
+                uint index = atomicAdd(sTileLightCount, 1u);
+                if(index < uint(LIGHT_TILE_MAX_LIGHTS))
+                    sTileLights[index] = light;
+            }
+        }
+    }
+    barrier();
+
+    if(!onScreen)
+        return;
+
+    // background stays black like in the fragment path, the skybox is drawn on top later
+    vec3 result = vec3(0.0);
+    if(hasGeometry) {
+        result = shadeGlobalLight(g.position, g.normal, g.diffuse, g.specular, g.gloss);
+        vec3 viewDir = normalize(viewPos.xyz - g.position);
+        uint tileLightCount = min(sTileLightCount, uint(LIGHT_TILE_MAX_LIGHTS));
+        for(uint i = 0u; i < tileLightCount; ++i)
+            result += shadePointLight(sTileLights[i], g.position, g.normal, g.diffuse, g.specular, g.gloss, viewDir);
+    }
+    imageStore(lightingResult, pixel, vec4(result, 1.0));
+}
@@ -18,19 +18,51 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
+#if GBUFFER_COMPACT
+uniform sampler2D gDepth;
+#else
 uniform sampler2D gPosition;
+#endif
 uniform sampler2D gNormal;
 uniform sampler2D gDiffuse;
 uniform sampler2D gSpecular;
 uniform int gBufferMode;
 
+#if GBUFFER_COMPACT
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
+
+// inverse of the octahedral mapping written by gBuffer.glsl
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
+
 void main()
 {             
     // retrieve data from gbuffer
+#if GBUFFER_COMPACT
+    float depth = texture(gDepth, TexCoords).r;
+    vec4 worldPos = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = depth < 1.0 ? worldPos.xyz / worldPos.w : vec3(0.0);
+    vec3 Normal = depth < 1.0 ? decodeOctahedral(texture(gNormal, TexCoords).rg) : vec3(0.0);
+    // intensity and normalized log2 gloss
+    vec3 Specular = vec3(texture(gSpecular, TexCoords).rg, 0.0);
+#else
     vec3 FragPos = texture(gPosition, TexCoords).rgb;
     vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gDiffuse, TexCoords).rgb;
     vec3 Specular = texture(gSpecular, TexCoords).rgb;
+#endif
+    vec3 Diffuse = texture(gDiffuse, TexCoords).rgb;
 	vec3 outColor = vec3(0.0);
 	
 	if(gBufferMode == 1) // world position
@@ -10,8 +10,13 @@ out vec2 TexCoords;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = VIEW_UBO_BINDING) uniform ViewConstants
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;          // xyz - camera position
+    mat4 inverseViewProjection;  // clip space -> world space
+};
 
 void main()
 {
@@ -27,10 +32,17 @@ void main()
 
 -- Fragment
 
+#if GBUFFER_COMPACT
+// location 0 is the depth buffer, the position is reconstructed from it
+layout (location = 1) out vec2 gNormal;
+layout (location = 2) out vec3 gDiffuse;
+layout (location = 3) out vec2 gSpecular;
+#else
 layout (location = 0) out vec3 gPosition;
 layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec3 gDiffuse;
 layout (location = 3) out vec4 gSpecular;
+#endif
 
 in vec2 TexCoords;
 in vec3 FragPos;
@@ -39,9 +51,33 @@ in vec3 Normal;
 uniform sampler2D texture_diffuse1;
 //uniform sampler2D texture_specular1; // should be using texture instead of uniform color
 uniform vec4 specularCol;
+uniform float glossiness;
+
+#if GBUFFER_COMPACT
+// octahedral normal encoding: the unit sphere folded onto the [-1, 1] square
+vec2 encodeOctahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+// specular color and gloss packed into intensity (r) and log2(gloss) / 8 (g)
+vec2 packSpecular(vec4 specular, float gloss)
+{
+    float intensity = specular.a * dot(specular.rgb, vec3(0.2126, 0.7152, 0.0722));
+    return vec2(clamp(intensity, 0.0, 1.0), clamp(log2(gloss) / 8.0, 0.0, 1.0));
+}
+#endif
 
 void main()
 {    
+#if GBUFFER_COMPACT
+    gNormal = encodeOctahedral(normalize(Normal));
+    gDiffuse = texture(texture_diffuse1, TexCoords).rgb;
+    gSpecular = packSpecular(specularCol, glossiness);
+#else
     // store the fragment position vector in the first gbuffer texture
     gPosition = FragPos;
     // also store the per-fragment normals into the gbuffer
@@ -50,4 +86,5 @@ void main()
     gDiffuse.rgb = texture(texture_diffuse1, TexCoords).rgb;
     // specular per-fragment color
     gSpecular = specularCol;
+#endif
 }
\ No newline at end of file
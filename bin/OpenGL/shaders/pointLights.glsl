@@ -0,0 +1,70 @@
+
+-- Update
+
+// Generates (and animates) the point light data directly in the light storage buffers,
+// one invocation per light. Mirrors PointLightGrid in pointlights.cpp.
+layout (local_size_x = LIGHT_UPDATE_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout (std430, binding = POINT_LIGHT_POSITION_BINDING) writeonly buffer PointLightPositions
+{
+    vec4 pointLightPositions[];  // (XYZ) light position and (W) is light radius
+};
+layout (std430, binding = POINT_LIGHT_COLOR_BINDING) writeonly buffer PointLightColors
+{
+    vec4 pointLightColors[];     // (RGB) light color
+};
+
+uniform int lightCount;
+uniform int gridWidth;           // the grid is gridWidth x gridWidth x POINT_LIGHT_GRID_HEIGHT
+uniform float spacing;           // distance between neighbouring grid cells
+uniform float yOffset;
+uniform float radius;
+uniform float time;              // animation time in seconds
+uniform float amplitude;         // orbit radius as a fraction of the spacing
+
+const float PI = 3.14159265359;
+
+uint lightHash(uint value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
+
+float hashUnit(uint value, int shift)
+{
+    return float((value >> shift) & 0xFFFFu) / 65535.0;
+}
+
+void main()
+{
+    int light = int(gl_GlobalInvocationID.x);
+    if(light >= lightCount)
+        return;
+
+    int lightIndexX = light / (gridWidth * POINT_LIGHT_GRID_HEIGHT);
+    int lightIndexZ = (light / POINT_LIGHT_GRID_HEIGHT) % gridWidth;
+    int lightIndexY = light % POINT_LIGHT_GRID_HEIGHT;
+    vec3 position = vec3((float(lightIndexX) - (float(gridWidth) - 1.0) / 2.0) * spacing,
+                         (float(lightIndexY) - (float(POINT_LIGHT_GRID_HEIGHT) - 1.0) / 2.0) * spacing + yOffset,
+                         (float(lightIndexZ) - (float(gridWidth) - 1.0) / 2.0) * spacing);
+
+    // fixed random offset in the xz plane (up to half a unit)
+    uint hash = lightHash(uint(light) * 2u);
+    float angle = hashUnit(hash, 0) * 2.0 * PI;
+    float len = hashUnit(hash, 16) * 0.5;
+    position.xz += vec2(cos(angle), sin(angle)) * len;
+
+    // every light orbits its cell with its own phase
+    float phase = angle + time;
+    float orbit = amplitude * spacing;
+    position += vec3(cos(phase), sin(2.0 * phase) * 0.5, sin(phase)) * orbit;
+    pointLightPositions[light] = vec4(position, radius);
+
+    // every channel between 0.5 and 1.0
+    uint colorHash = lightHash(uint(light) * 2u + 1u);
+    pointLightColors[light] = vec4(0.5 + 0.5 * vec3(float(colorHash & 0x3FFu), float((colorHash >> 10) & 0x3FFu), float((colorHash >> 20) & 0x3FFu)) / 1023.0, 1.0);
+}
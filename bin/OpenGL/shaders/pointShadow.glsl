@@ -0,0 +1,107 @@
+
+-- Vertex
+
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+flat out int vLight;
+
+void main()
+{
+    // one instance per shadowed light, the geometry shader does the projection
+    vLight = gl_InstanceID;
+    gl_Position = model * vec4(aPos, 1.0);
+}
+
+-- Geometry
+
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+flat in int vLight[];
+
+uniform mat4 faceViews[6];
+uniform mat4 cubeProjection;
+uniform vec4 lightPositions[MAX_SHADOWED_POINT_LIGHTS]; // xyz - position, w - radius
+
+out vec3 worldPos;
+flat out int light;
+
+void main()
+{
+    // every invocation renders the triangle into one cube face of its light
+    int face = gl_InvocationID;
+    vec3 lightPos = lightPositions[vLight[0]].xyz;
+    for(int i = 0; i < 3; ++i)
+    {
+        worldPos = gl_in[i].gl_Position.xyz;
+        light = vLight[0];
+        gl_Layer = vLight[0] * 6 + face;
+        gl_Position = cubeProjection * faceViews[face] * vec4(worldPos - lightPos, 1.0);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+
+-- Fragment
+
+in vec3 worldPos;
+flat in int light;
+
+uniform vec4 lightPositions[MAX_SHADOWED_POINT_LIGHTS];
+
+out vec4 FragColor;
+
+void main()
+{
+    // distance to the light normalized by its radius, the same for every face
+    float depth = clamp(length(worldPos - lightPositions[light].xyz) / lightPositions[light].w, 0.0, 1.0);
+    float squared = depth * depth;
+    vec4 moments = vec4(depth, squared, depth * squared, squared * squared);
+#if MSM_OPTIMIZED_MOMENTS
+    // rotate the moments into the basis that makes 16 bit quantization usable (Peters & Klein 2015)
+    moments = mat4(-2.07224649, 13.7948857237, 0.105877704, 9.7924062118,
+                   32.23703778, -59.4683975703, -1.9077466311, -33.7652110555,
+                   -68.571074599, 82.0359750338, 9.3496555107, 47.9456096605,
+                   39.3703274134, -35.364903257, -6.6543490743, -23.9728048165) * moments;
+    moments[0] += 0.035955884801;
+#endif
+    FragColor = moments;
+}
+
+-- BlurH
+
+// box filter of every cube face on its own (no filtering across face edges),
+// one invocation per texel and the z dimension walks light * 6 + face
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+layout(MSM_IMAGE_FORMAT, binding = 0) uniform readonly imageCubeArray uSource;
+layout(MSM_IMAGE_FORMAT, binding = 1) uniform writeonly imageCubeArray uTarget;
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int lastTexel = POINT_SHADOW_SIZE - 1;
+    vec4 sum = vec4(0.0);
+    for(int i = -POINT_SHADOW_KERNEL_HALF; i <= POINT_SHADOW_KERNEL_HALF; ++i)
+        sum += imageLoad(uSource, ivec3(clamp(texel.x + i, 0, lastTexel), texel.y, texel.z));
+    imageStore(uTarget, texel, sum / float(2 * POINT_SHADOW_KERNEL_HALF + 1));
+}
+
+-- BlurV
+
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+layout(MSM_IMAGE_FORMAT, binding = 0) uniform readonly imageCubeArray uSource;
+layout(MSM_IMAGE_FORMAT, binding = 1) uniform writeonly imageCubeArray uTarget;
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int lastTexel = POINT_SHADOW_SIZE - 1;
+    vec4 sum = vec4(0.0);
+    for(int i = -POINT_SHADOW_KERNEL_HALF; i <= POINT_SHADOW_KERNEL_HALF; ++i)
+        sum += imageLoad(uSource, ivec3(texel.x, clamp(texel.y + i, 0, lastTexel), texel.z));
+    imageStore(uTarget, texel, sum / float(2 * POINT_SHADOW_KERNEL_HALF + 1));
+}
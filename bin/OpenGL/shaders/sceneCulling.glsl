@@ -0,0 +1,68 @@
+
+-- Cull
+
+// one invocation per draw command slot: test the object's bounding sphere against the planes and
+// append its command, at its mesh's level, to the output list
+layout( local_size_x = SCENE_CULL_GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct ObjectBounds
+{
+    vec4 sphere;    // xyz - world space center, w - radius
+    uint mesh;
+};
+
+layout(std430, binding = SCENE_BOUNDS_BINDING) readonly buffer Bounds
+{
+    ObjectBounds bounds[];
+};
+
+// a block of objectCount commands per level, baseInstance is the object
+layout(std430, binding = SCENE_COMMAND_BINDING) readonly buffer Commands
+{
+    DrawCommand commands[];
+};
+
+layout(std430, binding = SCENE_CULLED_COMMAND_BINDING) writeonly buffer CulledCommands
+{
+    DrawCommand culledCommands[];
+};
+
+// visible objects and their triangles per list
+layout(std430, binding = SCENE_CULL_COUNTER_BINDING) buffer Counters
+{
+    uint counters[];
+};
+
+uniform int objectCount;
+uniform vec4 planes[6];
+uniform int planeCount;
+uniform int meshLevels[SCENE_MAX_MESHES];
+uniform int outputOffset;
+uniform int counterOffset;
+
+void main()
+{
+    int slot = int(gl_GlobalInvocationID.x);
+    if( slot >= objectCount ) return;
+
+    uint object = commands[slot].baseInstance;
+    vec4 sphere = bounds[object].sphere;
+    for( int i = 0; i < planeCount; i++ )
+    {
+        if( dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w ) return;
+    }
+
+    DrawCommand command = commands[meshLevels[bounds[object].mesh] * objectCount + slot];
+    uint index = atomicAdd(counters[counterOffset], 1u);
+    atomicAdd(counters[counterOffset + 1], command.count / 3u);
+    culledCommands[outputOffset + int(index)] = command;
+}
@@ -0,0 +1,93 @@
+-- _global
+
+precision highp float;
+precision highp int;
+
+// Summed-area table of the 4 moments.
+// Moments are stored as fixed point unsigned integers and all sums wrap modulo 2^32. A box sum
+// recovered from 4 SAT taps is exact as long as the true sum of the box fits into 32 bits, which
+// SAT_FIXED_POINT_SCALE guarantees for boxes up to SAT_MAX_KERNEL_SIZE^2 texels. This keeps full
+// precision regardless of the shadow map size, unlike a 32-bit float SAT where the large running
+// sums swallow the low bits of the moments.
+
+shared uvec4 sScan[CS_SAT_GROUP_SIZE];
+
+// inclusive Hillis-Steele scan of sScan across the workgroup
+void scanShared(int lid)
+{
+    for( int offset = 1; offset < CS_SAT_GROUP_SIZE; offset <<= 1 )
+    {
+        uvec4 addend = lid >= offset ? sScan[lid - offset] : uvec4(0u);
+        memoryBarrierShared();
+        barrier();
+        sScan[lid] += addend;
+        memoryBarrierShared();
+        barrier();
+    }
+}
+
+-- ComputeRows
+
+// one workgroup scans one row of the moment map in chunks of CS_SAT_GROUP_SIZE texels
+
+layout( local_size_x = CS_SAT_GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+layout(MSM_IMAGE_FORMAT, binding = 0) readonly uniform image2D uMoments;
+layout(rgba32ui, binding = 1) writeonly uniform uimage2D uSatOut;
+
+void main()
+{
+    int y = int(gl_WorkGroupID.x);
+    int lid = int(gl_LocalInvocationID.x);
+    uvec4 carry = uvec4(0u);
+
+    for( int chunk = 0; chunk < cRTScreenSizeI.z; chunk += CS_SAT_GROUP_SIZE )
+    {
+        int x = chunk + lid;
+        vec4 moments = x < cRTScreenSizeI.z ? imageLoad( uMoments, ivec2( x, y ) ) : vec4(0.0);
+        sScan[lid] = uvec4( clamp( moments, 0.0, 1.0 ) * SAT_FIXED_POINT_SCALE + 0.5 );
+        memoryBarrierShared();
+        barrier();
+
+        scanShared( lid );
+
+        if( x < cRTScreenSizeI.z )
+            imageStore( uSatOut, ivec2( x, y ), carry + sScan[lid] );
+        carry += sScan[CS_SAT_GROUP_SIZE - 1];
+
+        // everyone has read the chunk total before the next chunk overwrites it
+        barrier();
+    }
+}
+
+-- ComputeColumns
+
+// x and y are swapped for vertical: one workgroup scans one column of the row sums
+
+layout( local_size_x = CS_SAT_GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+layout(rgba32ui, binding = 0) readonly uniform uimage2D uSatIn;
+layout(rgba32ui, binding = 1) writeonly uniform uimage2D uSatOut;
+
+void main()
+{
+    int y = int(gl_WorkGroupID.x);
+    int lid = int(gl_LocalInvocationID.x);
+    uvec4 carry = uvec4(0u);
+
+    for( int chunk = 0; chunk < cRTScreenSizeI.w; chunk += CS_SAT_GROUP_SIZE )
+    {
+        int x = chunk + lid;
+        sScan[lid] = x < cRTScreenSizeI.w ? imageLoad( uSatIn, ivec2( y, x ) ) : uvec4(0u);
+        memoryBarrierShared();
+        barrier();
+
+        scanShared( lid );
+
+        if( x < cRTScreenSizeI.w )
+            imageStore( uSatOut, ivec2( y, x ), carry + sScan[lid] );
+        carry += sScan[CS_SAT_GROUP_SIZE - 1];
+
+        barrier();
+    }
+}
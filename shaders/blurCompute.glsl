@@ -3,8 +3,8 @@
 precision highp float;
 precision highp int;
 
-layout(rgba32f, binding = 0, location = 0) uniform image2D uTex0;
-layout(rgba32f, binding = 1, location = 1) uniform image2D uTex1;
+layout(MSM_IMAGE_FORMAT, binding = 0, location = 0) uniform image2D uTex0;
+layout(MSM_IMAGE_FORMAT, binding = 1, location = 1) uniform image2D uTex1;
 
 uniform int ComputeKernelSize;
 
@@ -70,4 +70,84 @@ void main()
         colorSum -= leftBorder;
         colorSum += rightBorder;
     }
-}
\ No newline at end of file
+}
+-- ComputeTiledH
+
+// Tiled variant: a whole workgroup cooperates on a CS_BLUR_TILE_SIZE wide segment of one row.
+// The segment plus its apron is loaded into shared memory once, then every invocation runs a
+// short sliding window over CS_BLUR_TILE_SIZE / CS_THREAD_GROUP_SIZE consecutive output texels.
+// Edges are clamped exactly like the sliding window passes above.
+
+layout( local_size_x = CS_THREAD_GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+const int cTexelsPerThread = CS_BLUR_TILE_SIZE / CS_THREAD_GROUP_SIZE;
+
+shared vec4 sTile[CS_BLUR_TILE_SIZE + 2 * CS_BLUR_MAX_KERNEL_HALF];
+
+void main()
+{
+    int y = int(gl_WorkGroupID.y);
+    int tileStart = int(gl_WorkGroupID.x) * CS_BLUR_TILE_SIZE;
+    int tileLength = CS_BLUR_TILE_SIZE + 2 * cKernelHalfDist;
+
+    // cooperative load of the tile and its apron (clamped to the edge texels)
+    for( int i = int(gl_LocalInvocationID.x); i < tileLength; i += CS_THREAD_GROUP_SIZE )
+        sTile[i] = imageLoad( uTex0, ivec2( clamp( tileStart - cKernelHalfDist + i, 0, cRTScreenSizeI.z-1 ), y ) );
+
+    barrier();
+
+    // sTile[l .. l + cKernelSize - 1] is the window of output texel tileStart + l
+    int first = int(gl_LocalInvocationID.x) * cTexelsPerThread;
+    vec4 colorSum = vec4(0.0);
+    for( int i = 0; i < cKernelSize; i++ )
+        colorSum += sTile[first + i];
+
+    for( int l = first; l < first + cTexelsPerThread; l++ )
+    {
+        int x = tileStart + l;
+        if( x < cRTScreenSizeI.z )
+            imageStore( uTex1, ivec2( x, y ), colorSum * recKernelSize );
+
+        // move window to the next (the last slide would read past the apron)
+        if( l + 1 < first + cTexelsPerThread )
+            colorSum += sTile[l + cKernelSize] - sTile[l];
+    }
+}
+
+-- ComputeTiledV
+
+// x and y are swapped for vertical: each workgroup filters a segment of one column
+
+layout( local_size_x = CS_THREAD_GROUP_SIZE, local_size_y = 1, local_size_z = 1 ) in;
+
+const int cTexelsPerThread = CS_BLUR_TILE_SIZE / CS_THREAD_GROUP_SIZE;
+
+shared vec4 sTile[CS_BLUR_TILE_SIZE + 2 * CS_BLUR_MAX_KERNEL_HALF];
+
+void main()
+{
+    int y = int(gl_WorkGroupID.y);
+    int tileStart = int(gl_WorkGroupID.x) * CS_BLUR_TILE_SIZE;
+    int tileLength = CS_BLUR_TILE_SIZE + 2 * cKernelHalfDist;
+
+    for( int i = int(gl_LocalInvocationID.x); i < tileLength; i += CS_THREAD_GROUP_SIZE )
+        sTile[i] = imageLoad( uTex0, ivec2( y, clamp( tileStart - cKernelHalfDist + i, 0, cRTScreenSizeI.w-1 ) ) );
+
+    barrier();
+
+    int first = int(gl_LocalInvocationID.x) * cTexelsPerThread;
+    vec4 colorSum = vec4(0.0);
+    for( int i = 0; i < cKernelSize; i++ )
+        colorSum += sTile[first + i];
+
+    for( int l = first; l < first + cTexelsPerThread; l++ )
+    {
+        int x = tileStart + l;
+        if( x < cRTScreenSizeI.w )
+            imageStore( uTex1, ivec2( y, x ), colorSum * recKernelSize );
+
+        // move window to the next (the last slide would read past the apron)
+        if( l + 1 < first + cTexelsPerThread )
+            colorSum += sTile[l + cKernelSize] - sTile[l];
+    }
+}
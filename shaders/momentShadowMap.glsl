@@ -11,6 +11,23 @@ void main()
     gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
 }
 
+-- VertexBatched
+
+layout (location = 0) in vec3 aPos;
+// the object of the draw command (its base instance), indexes the model matrices
+layout (location = 3) in uint aObject;
+
+uniform mat4 lightSpaceMatrix;
+layout (std430, binding = OBJECT_TRANSFORM_BINDING) readonly buffer ObjectTransforms
+{
+    mat4 objectModels[];
+};
+
+void main()
+{
+    gl_Position = lightSpaceMatrix * objectModels[aObject] * vec4(aPos, 1.0);
+}
+
 -- Fragment
 
 out vec4 FragColor;
@@ -19,5 +36,14 @@ void main()
 {
     float depth = gl_FragCoord.z;	
     float squared = depth * depth;
-    FragColor = vec4(depth, squared, depth * squared, squared * squared);
+    vec4 moments = vec4(depth, squared, depth * squared, squared * squared);
+#if MSM_OPTIMIZED_MOMENTS
+    // rotate the moments into the basis that makes 16 bit quantization usable (Peters & Klein 2015)
+    moments = mat4(-2.07224649, 13.7948857237, 0.105877704, 9.7924062118,
+                   32.23703778, -59.4683975703, -1.9077466311, -33.7652110555,
+                   -68.571074599, 82.0359750338, 9.3496555107, 47.9456096605,
+                   39.3703274134, -35.364903257, -6.6543490743, -23.9728048165) * moments;
+    moments[0] += 0.035955884801;
+#endif
+    FragColor = moments;
 }
\ No newline at end of file
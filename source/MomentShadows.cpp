@@ -11,6 +11,21 @@
 #include "arcball_camera.h"
 #include "framebuffer.h"
 #include "utility.h"
+#include "gputimer.h"
+#include "cascades.h"
+#include "pointshadows.h"
+#include "uniformbuffer.h"
+#include "streambuffer.h"
+#include "pointlights.h"
+#include "hashkey.h"
+#include "programcache.h"
+#include "assetloader.h"
+#include "shadowcache.h"
+#include "meshcache.h"
+#include "staticmesh.h"
+#include "scenebatch.h"
+#include "benchmark.h"
+#include "cpubenchmark.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -37,6 +52,10 @@ using namespace gl;
 #endif
 
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cmath>
 #include <experimental/filesystem>
 namespace fs = std::experimental::filesystem;
 
@@ -47,9 +66,18 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(const char *path, bool gammaCorrection);
+// 8 bit image decoded by a worker thread
+struct TextureImage
+{
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char* data = nullptr;
+};
+void uploadTexture(unsigned int textureID, const TextureImage& image, bool gammaCorrection);
 void renderQuad();
 void renderCube();
+CameraKey cameraKey(ArcballCamera& camera);
 
 
 // settings
@@ -57,14 +85,44 @@ const unsigned int SCR_WIDTH = 1024;
 const unsigned int SCR_HEIGHT = 768;
 const unsigned int SHADOW_MAP_SIZE = 2048;
 const float MAX_CAMERA_DISTANCE = 200.0f;
-const unsigned int LIGHT_GRID_WIDTH = 5;  // point light grid size
-const unsigned int LIGHT_GRID_HEIGHT = 4;  // point light vertical grid height
+const int INITIAL_POINT_LIGHT_COUNT = 100;
+const int MAX_POINT_LIGHT_COUNT = 131072;  // upper bound of the runtime light count
 const float INITIAL_POINT_LIGHT_RADIUS = 0.870f;
+const unsigned int POINT_SHADOW_SIZE = 256;  // cube face size of the point light shadows
+const int POINT_SHADOW_KERNEL_SIZE = 5;      // box filter applied to every cube face
+const float SHADOW_LOD_TOLERANCE = 0.125f;   // part of the filter width a caster silhouette may move by
+const unsigned int VIEW_UBO_BINDING = 0;     // ViewConstants uniform block
+const unsigned int FRAME_UBO_BINDING = 1;    // FrameConstants uniform block
+const unsigned int POINT_LIGHT_POSITION_BINDING = 0;  // light position + radius storage buffer
+const unsigned int POINT_LIGHT_COLOR_BINDING = 1;     // light color storage buffer
+const unsigned int OBJECT_TRANSFORM_BINDING = 2;      // scene object model matrix storage buffer
+// scene culling storage buffers: object bounds, draw commands, culled command lists, visible counters
+const GLuint SCENE_CULL_BINDINGS[4] = { 3, 4, 5, 6 };
+// command lists of the culled passes, one per shadow cascade follows the shadow map
+const int CAMERA_CULL_LIST = 0;
+const int SHADOW_CULL_LIST = 1;
+const int CASCADE_CULL_LIST = 2;
+static_assert(CASCADE_CULL_LIST + ShadowCascades::MAX_CASCADES <= SceneBatch::CULL_LISTS, "a culled command list per pass");
+const int MAX_SCENE_OBJECTS = 16384;                  // upper bound of the model copies on the floor grid
+const float OBJECT_SPACING = 2.5f;                    // distance between two copies
 
 // compute shader related:
 // 16 and 32 do well on BYT, anything in between or below is bad, values above were not thoroughly tested; 32 seems to do well on laptop/desktop Windows Intel and on NVidia/AMD as well
 // (further hardware-specific tuning probably needed for optimal performance)
 static const int CS_THREAD_GROUP_SIZE = 32;
+// tiled blur: texels of a row/column segment filtered by one workgroup (multiple of CS_THREAD_GROUP_SIZE)
+static const int CS_BLUR_TILE_SIZE = 256;
+// summed-area table scan: texels scanned per workgroup iteration
+static const int CS_SAT_GROUP_SIZE = 256;
+// largest SAT box and the fixed point scale that keeps its sum within 32 bits (127^2 * 2^18 < 2^32)
+static const int SAT_MAX_KERNEL_SIZE = 127;
+static const float SAT_FIXED_POINT_SCALE = 262144.0f;
+// tiled lighting: screen tile (and workgroup) edge length, point lights are culled per tile
+static const int LIGHT_TILE_SIZE = 16;
+// longest light list of a single tile (shared memory), further lights of the tile are dropped
+static const int LIGHT_TILE_MAX_LIGHTS = 512;
+// point light generation/animation: lights written per workgroup
+static const int LIGHT_UPDATE_GROUP_SIZE = 64;
 
 
 // camera
@@ -94,17 +152,38 @@ struct SceneLight {
 
 };
 
-// buffer for light instance data
-unsigned int matrixBuffer;
-unsigned int colorSizeBuffer;
-
-void configurePointLights(std::vector<glm::mat4>& modelMatrices, std::vector<glm::vec4>& modelColorSizes, float radius = 1.0f, float separation = 1.0f, float yOffset = 0.0f);
-void updatePointLights(std::vector<glm::mat4>& modelMatrices, std::vector<glm::vec4>& modelColorSizes, float separation, float yOffset, float radiusScale);
+void uploadPointLights(StreamBuffer& positionBuffer, StreamBuffer& colorBuffer, const std::vector<glm::vec4>& lightPositions, const std::vector<glm::vec4>& lightColors);
 
-int main()
+int main(int argc, char** argv)
 {
+    // command line: headless benchmark and camera path recording
+    // -----------------------------------------------------------
+    BenchmarkSettings benchSettings;
+    if (!benchSettings.parse(argc, argv))
+    {
+        BenchmarkSettings::printUsage(argv[0]);
+        return -1;
+    }
+    const bool headless = benchSettings.headless;
+    const auto startupStart = std::chrono::high_resolution_clock::now();
+    if (benchSettings.cpuMomentBenchmark) {
+        return runMomentEvaluatorBenchmark();
+    }
+    if (benchSettings.cpuFilterBenchmark) {
+        return runMomentFilterBenchmark();
+    }
+    if (benchSettings.meshBenchmark) {
+        return runMeshLoadBenchmark(benchSettings.meshBenchmarkPath);
+    }
+
     // glfw: initialize and configure
     // ------------------------------
+#ifdef GLFW_PLATFORM_NULL
+    // GLFW 3.4+: no display server is needed when rendering offscreen through EGL/OSMesa
+    if (headless && benchSettings.contextApi != "native") {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+#endif
     glfwInit();
     const char* glsl_version = "#version 430";
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -115,6 +194,17 @@ int main()
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    if (headless) {
+        // hidden window, the default framebuffer is used as an offscreen surface
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (benchSettings.contextApi == "egl") {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        }
+        else if (benchSettings.contextApi == "osmesa") {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        }
+    }
+
     // glfw window creation
     // --------------------
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Moment Shadow Mapping (Roman Timurson)", NULL, NULL);
@@ -125,6 +215,10 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    if (headless) {
+        // never wait on vsync while measuring
+        glfwSwapInterval(0);
+    }
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -138,6 +232,21 @@ int main()
         return -1;
     }
 
+    // let the driver compile on its own threads, the programs are only queried once all are issued
+    typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+    const bool parallelShaderCompile = glfwExtensionSupported("GL_KHR_parallel_shader_compile") == GLFW_TRUE;
+    if (parallelShaderCompile) {
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (maxShaderCompilerThreads != NULL) {
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+        }
+    }
+
+    // first imports of the OBJ models (before the loader, its jobs use it until they are done)
+    ObjImporter objImporter;
+    // decoding and parsing on worker threads, GL uploads back on this thread
+    AssetLoader assetLoader;
+
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
@@ -176,30 +285,116 @@ int main()
     globalShaderConstants = cStringFormatA("#define CS_THREAD_GROUP_SIZE %d\n", CS_THREAD_GROUP_SIZE);
     glswAddDirectiveToken("*", globalShaderConstants.c_str());
 
+    // moment storage: 128 bit canonical moments or 64 bit moments in the optimized (rotated) basis of the MSM paper
+    const bool momentStorage16 = benchSettings.momentBits == 16;
+    const GLenum momentFormat = momentStorage16 ? GL_RGBA16 : GL_RGBA32F;
+    globalShaderConstants = cStringFormatA("#define MSM_IMAGE_FORMAT %s\n#define MSM_OPTIMIZED_MOMENTS %d\n", momentStorage16 ? "rgba16" : "rgba32f", momentStorage16 ? 1 : 0);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    // G-buffer layout: RGB16F world position + normal, or depth + octahedral RG16 snorm normal + packed specular
+    const bool compactGBuffer = benchSettings.gBufferLayout == 1;
+    globalShaderConstants = cStringFormatA("#define GBUFFER_COMPACT %d\n", compactGBuffer ? 1 : 0);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define CS_SAT_GROUP_SIZE %d\n#define SAT_FIXED_POINT_SCALE %.1f\n", CS_SAT_GROUP_SIZE, SAT_FIXED_POINT_SCALE);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define MAX_SHADOW_CASCADES %d\n", ShadowCascades::MAX_CASCADES);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define MAX_SHADOWED_POINT_LIGHTS %d\n#define POINT_SHADOW_SIZE %d\n#define POINT_SHADOW_KERNEL_HALF %d\n",
+        PointShadows::MAX_SHADOWED_LIGHTS, POINT_SHADOW_SIZE, POINT_SHADOW_KERNEL_SIZE / 2);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define VIEW_UBO_BINDING %d\n#define FRAME_UBO_BINDING %d\n", VIEW_UBO_BINDING, FRAME_UBO_BINDING);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define LIGHT_TILE_SIZE %d\n#define LIGHT_TILE_MAX_LIGHTS %d\n#define POINT_LIGHT_POSITION_BINDING %d\n#define POINT_LIGHT_COLOR_BINDING %d\n",
+        LIGHT_TILE_SIZE, LIGHT_TILE_MAX_LIGHTS, POINT_LIGHT_POSITION_BINDING, POINT_LIGHT_COLOR_BINDING);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define OBJECT_TRANSFORM_BINDING %d\n", OBJECT_TRANSFORM_BINDING);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define SCENE_BOUNDS_BINDING %d\n#define SCENE_COMMAND_BINDING %d\n#define SCENE_CULLED_COMMAND_BINDING %d\n#define SCENE_CULL_COUNTER_BINDING %d\n#define SCENE_CULL_GROUP_SIZE %d\n#define SCENE_MAX_MESHES %d\n",
+        SCENE_CULL_BINDINGS[0], SCENE_CULL_BINDINGS[1], SCENE_CULL_BINDINGS[2], SCENE_CULL_BINDINGS[3], SceneBatch::CULL_GROUP_SIZE, SceneBatch::MAX_MESHES);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    globalShaderConstants = cStringFormatA("#define LIGHT_UPDATE_GROUP_SIZE %d\n#define POINT_LIGHT_GRID_HEIGHT %d\n", LIGHT_UPDATE_GROUP_SIZE, PointLightGrid::HEIGHT);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+    // shared memory apron of the tiled blur is sized for the largest kernel
+    globalShaderConstants = cStringFormatA("#define CS_BLUR_TILE_SIZE %d\n#define CS_BLUR_MAX_KERNEL_HALF %d\n", CS_BLUR_TILE_SIZE, computeShaderKernel[IM_ARRAYSIZE(computeShaderKernel) - 1] / 2);
+    glswAddDirectiveToken("*", globalShaderConstants.c_str());
+
+
+    // program binaries of earlier runs, keyed by the final sources and the driver
+    const auto shaderStart = std::chrono::high_resolution_clock::now();
+    std::string programCacheDirectory = PATH + "/OpenGL/programcache";
+    if (benchSettings.programCache) {
+        std::error_code programCacheError;
+        fs::create_directories(programCacheDirectory, programCacheError);
+    }
+    ProgramCache binaryCache(programCacheDirectory);
+    ProgramCache* programCache = benchSettings.programCache ? &binaryCache : nullptr;
 
     // hdr cubemap shaders
-    Shader equirectangularToCubemapShader(glswGetShader("equirectToCubemap.Vertex"), glswGetShader("equirectToCubemap.Fragment"));
-    Shader cubemapShader(glswGetShader("cubemap.Vertex"), glswGetShader("cubemap.Fragment"));
+    Shader equirectangularToCubemapShader(glswGetShader("equirectToCubemap.Vertex"), glswGetShader("equirectToCubemap.Fragment"), nullptr, programCache);
+    Shader cubemapShader(glswGetShader("cubemap.Vertex"), glswGetShader("cubemap.Fragment"), nullptr, programCache);
     // Shader for writing into a depth texture
-    Shader shaderDepthWrite(glswGetShader("momentShadowMap.Vertex"), glswGetShader("momentShadowMap.Fragment"));
+    Shader shaderDepthWrite(glswGetShader("momentShadowMap.Vertex"), glswGetShader("momentShadowMap.Fragment"), nullptr, programCache);
+    // and its multi-draw variant reading the model matrices of the scene batch
+    Shader shaderDepthWriteBatched(glswGetShader("momentShadowMap.VertexBatched"), glswGetShader("momentShadowMap.Fragment"), nullptr, programCache);
     // Compute shader for doing multi-pass moving average box filtering
-    Shader computeBlurShaderH(glswGetShader("blurCompute.ComputeH"));
-    Shader computeBlurShaderV(glswGetShader("blurCompute.ComputeV"));
+    Shader computeBlurShaderH(glswGetShader("blurCompute.ComputeH"), programCache);
+    Shader computeBlurShaderV(glswGetShader("blurCompute.ComputeV"), programCache);
+    // Tiled shared memory variant of the same box filter
+    Shader computeBlurShaderTiledH(glswGetShader("blurCompute.ComputeTiledH"), programCache);
+    Shader computeBlurShaderTiledV(glswGetShader("blurCompute.ComputeTiledV"), programCache);
+    // Compute shaders building a summed-area table of the moments (rows then columns)
+    Shader computeSatRowsShader(glswGetShader("summedAreaTable.ComputeRows"), programCache);
+    Shader computeSatColumnsShader(glswGetShader("summedAreaTable.ComputeColumns"), programCache);
+    // Layered shader writing the moments of all shadowed point lights into their cube maps in one pass
+    Shader shaderPointShadowWrite(glswGetShader("pointShadow.Vertex"), glswGetShader("pointShadow.Fragment"), glswGetShader("pointShadow.Geometry"), programCache);
+    // Per cube face box filter of the point light moments
+    Shader computePointShadowBlurH(glswGetShader("pointShadow.BlurH"), programCache);
+    Shader computePointShadowBlurV(glswGetShader("pointShadow.BlurV"), programCache);
     // Shader for visualiazing the depth texture
-    Shader shaderDebugDepthMap(glswGetShader("debugMSM.Vertex"), glswGetShader("debugMSM.Fragment"));
+    Shader shaderDebugDepthMap(glswGetShader("debugMSM.Vertex"), glswGetShader("debugMSM.Fragment"), nullptr, programCache);
     // G-Buffer pass shader for models w/o textures and just Kd, Ks, etc colors 
-    Shader shaderGeometryPass(glswGetShader("gBuffer.Vertex"), glswGetShader("gBuffer.Fragment"));
+    Shader shaderGeometryPass(glswGetShader("gBuffer.Vertex"), glswGetShader("gBuffer.Fragment"), nullptr, programCache);
+    Shader shaderGeometryPassBatched(glswGetShader("gBuffer.VertexBatched"), glswGetShader("gBuffer.Fragment"), nullptr, programCache);
     // G-Buffer pass shader for the models with textures (diffuse, specular, etc)
-    Shader shaderTexturedGeometryPass(glswGetShader("gBufferTextured.Vertex"), glswGetShader("gBufferTextured.Fragment"));
+    Shader shaderTexturedGeometryPass(glswGetShader("gBufferTextured.Vertex"), glswGetShader("gBufferTextured.Fragment"), nullptr, programCache);
     // First pass of deferred shader that will render the scene with a global light and shadow mapping
-    Shader shaderLightingPass(glswGetShader("deferredShading.Vertex"), glswGetShader("deferredShading.Fragment"));
+    Shader shaderLightingPass(glswGetShader("deferredShading.Vertex"), glswGetShader("deferredShading.Fragment"), nullptr, programCache);
+    // Compute alternative that culls the point lights per screen tile and shades them together with the global light
+    Shader computeTiledLightingShader(glswGetShader("deferredShading.TiledCompute"), programCache);
+    // Compute shader generating and animating the point lights in place in their storage buffers
+    Shader computeLightUpdateShader(glswGetShader("pointLights.Update"), programCache);
+    // Compute shader culling the scene objects against a frustum into a list of multi-draw commands
+    Shader computeSceneCullShader(glswGetShader("sceneCulling.Cull"), programCache);
     // Shader for debugging the G-Buffer contents
-    Shader shaderGBufferDebug(glswGetShader("gBufferDebug.Vertex"), glswGetShader("gBufferDebug.Fragment"));
+    Shader shaderGBufferDebug(glswGetShader("gBufferDebug.Vertex"), glswGetShader("gBufferDebug.Fragment"), nullptr, programCache);
     // Shader to render the light geometry for visualization and debugging
-    Shader shaderGlobalLightSphere(glswGetShader("deferredLight.Vertex"), glswGetShader("deferredLight.Fragment"));
-    Shader shaderLightSphere(glswGetShader("deferredLightInstanced.Vertex"), glswGetShader("deferredLightInstanced.Fragment"));
+    Shader shaderGlobalLightSphere(glswGetShader("deferredLight.Vertex"), glswGetShader("deferredLight.Fragment"), nullptr, programCache);
+    Shader shaderLightSphere(glswGetShader("deferredLightInstanced.Vertex"), glswGetShader("deferredLightInstanced.Fragment"), nullptr, programCache);
     // Shader for a final composite rendering of point(area) lights with generated G-Buffer
-    Shader shaderPointLightingPass(glswGetShader("deferredPointLightInstanced.Vertex"), glswGetShader("deferredPointLightInstanced.Fragment"));
+    Shader shaderPointLightingPass(glswGetShader("deferredPointLightInstanced.Vertex"), glswGetShader("deferredPointLightInstanced.Fragment"), nullptr, programCache);
+
+    // nothing has been checked yet, the results are collected right before the programs are configured
+    const std::chrono::duration<double, std::milli> shaderIssueTime = std::chrono::high_resolution_clock::now() - shaderStart;
+    Shader* shaderPrograms[] = {
+        &equirectangularToCubemapShader, &cubemapShader, &shaderDepthWrite, &shaderDepthWriteBatched, &computeBlurShaderH, &computeBlurShaderV,
+        &computeBlurShaderTiledH, &computeBlurShaderTiledV, &computeSatRowsShader, &computeSatColumnsShader,
+        &shaderPointShadowWrite, &computePointShadowBlurH, &computePointShadowBlurV, &shaderDebugDepthMap,
+        &shaderGeometryPass, &shaderGeometryPassBatched, &shaderTexturedGeometryPass, &shaderLightingPass, &computeTiledLightingShader,
+        &computeLightUpdateShader, &computeSceneCullShader, &shaderGBufferDebug, &shaderGlobalLightSphere, &shaderLightSphere, &shaderPointLightingPass
+    };
+
+    // camera and global light constants shared by all programs through fixed binding points
+    UniformBuffer viewUniforms(sizeof(ViewConstants), VIEW_UBO_BINDING);
+    UniformBuffer frameUniforms(sizeof(FrameConstants), FRAME_UBO_BINDING);
 
     // pbr: load the HDR environment map and render it into cubemap
     // ---------------------------------
@@ -213,28 +408,10 @@ int main()
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-    int width, height, nrComponents;
+    // placeholder until the decoded image arrives: the skybox is skipped
     std::string hdrMapPath = PATH + "/OpenGL/images/newport_loft.hdr";
-    float *data = stbi_loadf(hdrMapPath.c_str(), &width, &height, &nrComponents, 0);
-    unsigned int hdrTexture;
-    if (data)
-    {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        // load a floating point HDR texture data
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Failed to load HDR image." << std::endl;
-    }
+    unsigned int hdrTexture = 0;
+    bool environmentReady = false;
 
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
@@ -264,24 +441,58 @@ int main()
         glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
     };
 
-    // pbr: convert HDR equirectangular environment map to cubemap equivalent
+    // pbr: convert HDR equirectangular environment map to cubemap equivalent (decoded on a worker)
     // ----------------------------------------------------------------------
-    equirectangularToCubemapShader.use();
-    equirectangularToCubemapShader.setUniformInt("equirectangularMap", 0);
-    equirectangularToCubemapShader.setUniformMat4("projection", captureProjection);
-
-    // set viewport for rendering into cubemap
-    glViewport(0, 0, 512, 512);
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
+    struct HdrImage
     {
-        equirectangularToCubemapShader.setUniformMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        float* data = nullptr;
+    };
+    std::shared_ptr<HdrImage> hdrImage = std::make_shared<HdrImage>();
+    assetLoader.run([hdrImage, hdrMapPath] {
+        hdrImage->data = stbi_loadf(hdrMapPath.c_str(), &hdrImage->width, &hdrImage->height, &hdrImage->components, 0);
+    }, [&, hdrImage] {
+        if (!hdrImage->data)
+        {
+            std::cout << "Failed to load HDR image." << std::endl;
+            return;
+        }
+        glGenTextures(1, &hdrTexture);
+        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+        // load a floating point HDR texture data
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, hdrImage->width, hdrImage->height, 0, GL_RGB, GL_FLOAT, hdrImage->data);
 
-        renderCube();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(hdrImage->data);
+        hdrImage->data = nullptr;
+
+        equirectangularToCubemapShader.use();
+        equirectangularToCubemapShader.setUniformInt("equirectangularMap", 0);
+        equirectangularToCubemapShader.setUniformMat4("projection", captureProjection);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+
+        // set viewport for rendering into cubemap
+        glViewport(0, 0, 512, 512);
+        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            equirectangularToCubemapShader.setUniformMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            renderCube();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        environmentReady = true;
+    });
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -313,8 +524,28 @@ int main()
 
     // load textures
     // -------------
+    // a grey texel until the decoded image is uploaded
     std::string woodTexturePath = PATH + "/OpenGL/images/wood.png";
-    unsigned int woodTexture = loadTexture(woodTexturePath.c_str(), false);
+    unsigned int woodTexture;
+    glGenTextures(1, &woodTexture);
+    unsigned char placeholderTexel[3] = { 128, 128, 128 };
+    TextureImage placeholderImage;
+    placeholderImage.width = placeholderImage.height = 1;
+    placeholderImage.components = 3;
+    placeholderImage.data = placeholderTexel;
+    uploadTexture(woodTexture, placeholderImage, false);
+    std::shared_ptr<TextureImage> woodImage = std::make_shared<TextureImage>();
+    assetLoader.run([woodImage, woodTexturePath] {
+        woodImage->data = stbi_load(woodTexturePath.c_str(), &woodImage->width, &woodImage->height, &woodImage->components, 0);
+    }, [woodTexture, woodImage, woodTexturePath] {
+        if (!woodImage->data) {
+            std::cout << "Texture failed to load at path: " << woodTexturePath << std::endl;
+            return;
+        }
+        uploadTexture(woodTexture, *woodImage, false);
+        stbi_image_free(woodImage->data);
+        woodImage->data = nullptr;
+    });
 
     // load models
     // -----------
@@ -324,32 +555,71 @@ int main()
     std::string lucyPath = PATH + "/OpenGL/models/Lucy.obj";
     std::string heptoroid = PATH + "/OpenGL/models/heptoroid.obj";
     //std::string modelPath = PATH + "/OpenGL/models/Aphrodite.obj";
-    Model meshModelA(dragonPath);
-    //Model meshModelB(dragonPath);
-   // Model meshModelC(bunnyPath);
     std::string spherePath = PATH + "/OpenGL/models/Sphere.obj";
-    Model lightModel(spherePath);
-    std::vector<glm::vec3> objectPositions;
-    objectPositions.push_back(glm::vec3(0.0, 1.0, 0.0));
-   /* objectPositions.push_back(glm::vec3(2.5, 1.0, -0.5));
-    objectPositions.push_back(glm::vec3(-2.5, 1.0, -0.5));
-    objectPositions.push_back(glm::vec3(0.0, 1.0, 2.0));*/
-    std::vector<Model*> meshModels;
-    meshModels.push_back(&meshModelA);
-   // meshModels.push_back(&meshModelB);
-    //meshModels.push_back(&meshModelC);
+    // the meshes are mapped from their binary cache (or imported) on a worker and uploaded between
+    // frames (queued below); until then the scene is the floor and the point lights aren't drawn
+    std::unique_ptr<StaticMesh> lightModel;
+    // the scene meshes share the buffers of one batch, the objects (copies of the model on a grid)
+    // are laid out once it is loaded and whenever their count changes
+    SceneBatch sceneBatch(OBJECT_TRANSFORM_BINDING, SCENE_CULL_BINDINGS);
+    int sceneMesh = -1;
+    int sceneObjectCount = glm::clamp(benchSettings.sceneObjects, 1, MAX_SCENE_OBJECTS);
+    int laidOutObjects = 0;
+    bool batchedDraws = benchSettings.drawPath == 1; // one multi-draw per pass instead of a draw per object
+    bool gpuCulling = benchSettings.culling == 1;    // the multi-draws only get the objects in the pass frustum
+    glm::vec4 cullPlanes[6];
+    float modelScale = 0.9f;
+    unsigned long long objectLayoutHash = 0;
+    auto layoutObjects = [&]() {
+        sceneBatch.clearObjects();
+        laidOutObjects = 0;
+        if (sceneMesh < 0) {
+            return;
+        }
+        // the cells of a square grid closest to the origin, so the first copy stands where the single model did
+        int side = 1;
+        while (side * side < sceneObjectCount) {
+            side += 2;
+        }
+        std::vector<glm::vec3> cells;
+        for (int z = 0; z < side; z++) {
+            for (int x = 0; x < side; x++) {
+                cells.push_back(glm::vec3((x - side / 2) * OBJECT_SPACING, 1.0f, (z - side / 2) * OBJECT_SPACING));
+            }
+        }
+        std::stable_sort(cells.begin(), cells.end(), [](const glm::vec3& a, const glm::vec3& b) {
+            return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+        });
+        HashKey layout;
+        for (int i = 0; i < sceneObjectCount; i++)
+        {
+            glm::mat4 objectModel = glm::translate(glm::mat4(1.0f), cells[i]);
+            objectModel = glm::scale(objectModel, glm::vec3(modelScale));
+            sceneBatch.addObject(sceneMesh, objectModel);
+            layout.add(cells[i]);
+        }
+        layout.add(modelScale);
+        objectLayoutHash = layout.get();
+        laidOutObjects = sceneObjectCount;
+    };
 
     // configure depth map framebuffer for shadow generation/filtering
     // ----------------------
     FrameBuffer sBuffer(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
-    sBuffer.attachTexture(GL_RGBA32F);
-    sBuffer.attachTexture(GL_RGBA32F);            // attach secondary texture for ping-pong blurring
+    sBuffer.attachTexture(momentFormat);
+    sBuffer.attachTexture(momentFormat);          // attach secondary texture for ping-pong blurring
     sBuffer.attachRender(GL_DEPTH_COMPONENT);     // attach Depth render buffer
     sBuffer.bindInput(0);
     // Remove artefacts on the edges of the shadowmap
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    // moments of the far plane (depth = 1) in the storage basis, nothing outside the map casts a shadow
     float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    if (momentStorage16) {
+        borderColor[1] = 0.99756f;
+        borderColor[2] = 0.89344f;
+        borderColor[3] = 0.0f;
+    }
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
     sBuffer.bindInput(1);
     // Remove artefacts on the edges of the shadowmap
@@ -357,23 +627,98 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
+    // baked shadow maps of a static light: files keyed by the light matrix, the casters and the filter
+    // (the caster geometry is hashed once, the transforms and settings every frame)
+    ShadowMapCache shadowCache(PATH + "/OpenGL/shadowcache", SHADOW_MAP_SIZE, momentFormat);
+    HashKey sceneKey;
+    auto hashSceneGeometry = [&]() {
+        sceneKey = HashKey();
+        sceneKey.add(planeVertices, sizeof(planeVertices));
+        for (int i = 0; i < sceneBatch.getMeshCount(); i++) {
+            sceneKey.add(sceneBatch.getGeometryHash(i));
+        }
+    };
+    hashSceneGeometry();
+
+    // the light volumes first, they are small
+    std::shared_ptr<MeshCache> sphereMesh = std::make_shared<MeshCache>();
+    assetLoader.run([sphereMesh, spherePath, &objImporter] {
+        sphereMesh->open(spherePath, &objImporter);
+    }, [&, sphereMesh, spherePath] {
+        if (sphereMesh->getSource() == MeshCache::NONE) {
+            std::cout << "Model failed to load at path: " << spherePath << std::endl;
+            return;
+        }
+        lightModel.reset(new StaticMesh(*sphereMesh));
+        sphereMesh->close();
+    });
+    std::shared_ptr<MeshCache> dragonMesh = std::make_shared<MeshCache>();
+    assetLoader.run([dragonMesh, dragonPath, &objImporter] {
+        dragonMesh->open(dragonPath, &objImporter);
+    }, [&, dragonMesh, dragonPath] {
+        if (dragonMesh->getSource() == MeshCache::NONE) {
+            std::cout << "Model failed to load at path: " << dragonPath << std::endl;
+            return;
+        }
+        sceneMesh = sceneBatch.addMesh(*dragonMesh);
+        dragonMesh->close();
+        layoutObjects();
+        // new casters, the shadow map key changes with them
+        hashSceneGeometry();
+    });
+
+    // cascaded shadow maps for large view distances, one SHADOW_MAP_SIZE layer per cascade
+    // (the texture array is only allocated once cascades get enabled)
+    ShadowCascades shadowCascades(SHADOW_MAP_SIZE, momentFormat, borderColor);
+    const char* cascadePassNames[] = { "Cascade 0", "Cascade 1", "Cascade 2", "Cascade 3" };
+    const char* cascadeFilterPassNames[] = { "Cascade 0 filter", "Cascade 1 filter", "Cascade 2 filter", "Cascade 3 filter" };
+
+    // omnidirectional shadows for a bounded number of point lights (allocated on first use)
+    PointShadows pointShadows(POINT_SHADOW_SIZE, momentFormat, borderColor);
+
+    // summed-area table of the moments (never rendered into, only written by compute)
+    // -------------------------------------------------------------------------------
+    FrameBuffer satBuffer(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    satBuffer.attachTexture(GL_RGBA32UI);         // row prefix sums
+    satBuffer.attachTexture(GL_RGBA32UI);         // final table (row + column prefix sums)
+
     // configure g-buffer framebuffer
     // ------------------------------
+    // full:    6 (position) + 6 (normal) + 3 (Kd) + 4 (Ks) + 4 (depth) = 23 bytes per pixel
+    // compact: 4 (depth) + 4 (normal) + 3 (Kd) + 2 (Ks intensity, gloss)  = 13 bytes per pixel
     FrameBuffer gBuffer(SCR_WIDTH, SCR_HEIGHT);
-    gBuffer.attachTexture(GL_RGB16F, GL_NEAREST); // Position color buffer
-    gBuffer.attachTexture(GL_RGB16F, GL_NEAREST); // Normal color buffer
-    gBuffer.attachTexture(GL_RGB, GL_NEAREST);    // Diffuse (Kd)
-    gBuffer.attachTexture(GL_RGBA, GL_NEAREST);   // Specular (Ks)
-    gBuffer.bindOutput();                         // calls glDrawBuffers[i] for all attached textures
-    gBuffer.attachRender(GL_DEPTH_COMPONENT);     // attach Depth render buffer
+    if (compactGBuffer) {
+        gBuffer.attachTexture(GL_DEPTH_COMPONENT24);      // Depth, takes the position slot (unit 0)
+        gBuffer.attachTexture(GL_RG16_SNORM, GL_NEAREST); // Octahedral normal
+        gBuffer.attachTexture(GL_RGB, GL_NEAREST);        // Diffuse (Kd)
+        gBuffer.attachTexture(GL_RG8, GL_NEAREST);        // Specular intensity and gloss
+        gBuffer.bindOutput();
+    }
+    else {
+        gBuffer.attachTexture(GL_RGB16F, GL_NEAREST); // Position color buffer
+        gBuffer.attachTexture(GL_RGB16F, GL_NEAREST); // Normal color buffer
+        gBuffer.attachTexture(GL_RGB, GL_NEAREST);    // Diffuse (Kd)
+        gBuffer.attachTexture(GL_RGBA, GL_NEAREST);   // Specular (Ks)
+        gBuffer.bindOutput();                         // calls glDrawBuffers[i] for all attached textures
+        gBuffer.attachRender(GL_DEPTH_COMPONENT);     // attach Depth render buffer
+    }
     gBuffer.check();
+    const int gBufferBytesPerPixel = compactGBuffer ? 13 : 23;
     FrameBuffer::unbind();                        // unbind framebuffer for now
 
+    // output of the tiled lighting compute pass, blitted to the default framebuffer
+    FrameBuffer lightBuffer(SCR_WIDTH, SCR_HEIGHT);
+    lightBuffer.attachTexture(GL_RGBA8, GL_NEAREST);
+
     // lighting info
     // -------------
-    // instance array data for our light volumes
-    std::vector<glm::mat4> modelMatrices;
-    std::vector<glm::vec4> modelColorSizes;
+    // per light data of our light volumes (CPU copies of the storage buffers, upload path only)
+    std::vector<glm::vec4> lightPositions;
+    std::vector<glm::vec4> lightColors;
+    // procedural layout both update paths evaluate, and the lights shadow selection looks at
+    PointLightGrid lightGrid;
+    std::vector<glm::vec4> nearbyLightPositions;
+    std::vector<int> nearbyLightIndices;
 
     // single global light
     SceneLight globalLight(glm::vec3(-2.5f, 5.0f, -1.25f), glm::vec3(1.0f, 1.0f, 1.0f), 0.125f);
@@ -382,7 +727,34 @@ int main()
     int gBufferMode = 0;
     int ShadowMethod = 1;  // 0 - Standard, 1 - MSM
     int KernelSizeOption = 0; // 7, 15, 23, 35, 63, 127
+    int BlurBackend = 0;      // 0 - Sliding window, 1 - Tiled (shared memory)
+    int ShadowFilter = 0;     // 0 - Box blur chain, 1 - Summed-area table
+    int satKernelSize = 15;   // any box size up to SAT_MAX_KERNEL_SIZE
+    bool useCascades = false;
+    int cascadeCount = ShadowCascades::MAX_CASCADES;
+    float cascadeShadowDistance = 60.0f;  // view depth covered by the cascades
+    float cascadeSplitLambda = 0.75f;     // 0 - uniform splits, 1 - logarithmic splits
+    int pointShadowCount = 0;             // closest point lights casting shadows each frame
+    int pointLightCount = INITIAL_POINT_LIGHT_COUNT;
+    int LightingPath = 0;     // 0 - Fragment quad + light volumes, 1 - Tiled compute
+    int LightUpdate = 0;      // 0 - CPU generation + upload, 1 - GPU compute
+    bool animateLights = false;
+    float lightAnimationSpeed = 1.0f;
+    float lightAnimationTime = 0.0f;
+    bool lightsDirty = true;  // light data has to be regenerated before the next frame
     bool enableShadows = true;
+    bool reuseShadows = true;                // skip the shadow pass and filter while nothing feeding them changes
+    bool cacheStaticShadows = false;         // bake unchanged maps to disk and load them on later runs
+    bool shadowLods = true;                  // draw the casters at the coarsest level the filter hides
+    int shadowCasterTriangles = 0;           // mesh triangles of the last shadow map rebuild
+    unsigned int shadowCullLists = 0;        // bit per command list that rebuild culled, their triangles arrive frames later
+    unsigned long long residentShadowKey = 0; // key of the map sBuffer texture 0 holds, 0 - none
+    bool residentShadowStored = false;       // that map is on disk already
+    int reusedShadowFrames = 0;
+    int shadowRebuilds = 0;                  // shadow pass + filter runs so far
+    int sampledShadowRebuilds = 0;           // shadowRebuilds at the start of the rate window
+    float shadowRateStart = 0.0f;
+    float shadowRebuildsPerSecond = 0.0f;
     bool drawPointLights = false;
     bool showDepthMap = false;
     bool drawPointLightsWireframe = true;
@@ -395,73 +767,93 @@ int main()
     float pointLightRadius = INITIAL_POINT_LIGHT_RADIUS;
     float pointLightVerticalOffset = 1.205f;
     float pointLightSeparation = 0.620f;
-    float modelScale = 0.9f;
 
-    const int totalLights = LIGHT_GRID_WIDTH * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT;
-    // initialize point lights
-    configurePointLights(modelMatrices, modelColorSizes, pointLightRadius, pointLightSeparation, pointLightVerticalOffset);
-    
-    // configure instanced array of model transform matrices
-    // -------------------------
-    glGenBuffers(1, &matrixBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer);
-    glBufferData(GL_ARRAY_BUFFER, totalLights * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-    // light model has only one mesh
-    unsigned int VAO = lightModel.meshes[0].VAO;
-    glBindVertexArray(VAO);
-
-    // set attribute pointers for matrix (4 times vec4)
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-    glVertexAttribDivisor(5, 1);
-    glVertexAttribDivisor(6, 1);
-
-    // configure instanced array of light colors
+    // command line overrides of the shadow configuration
+    ShadowMethod = benchSettings.shadowMethod;
+    BlurBackend = benchSettings.blurBackend;
+    ShadowFilter = benchSettings.shadowFilter;
+    satKernelSize = glm::clamp(benchSettings.kernelSize, 1, SAT_MAX_KERNEL_SIZE);
+    pointShadowCount = glm::clamp(benchSettings.pointShadows, 0, int(PointShadows::MAX_SHADOWED_LIGHTS));
+    LightingPath = benchSettings.lightingPath == 1 ? 1 : 0;
+    pointLightCount = glm::clamp(benchSettings.pointLights, 1, MAX_POINT_LIGHT_COUNT);
+    LightUpdate = benchSettings.lightUpdate == 1 ? 1 : 0;
+    animateLights = benchSettings.animateLights;
+    cacheStaticShadows = benchSettings.shadowCache;
+    reuseShadows = !benchSettings.forceShadowRebuild;
+    useCascades = benchSettings.cascades > 0;
+    if (useCascades) {
+        cascadeCount = glm::clamp(benchSettings.cascades, 1, int(ShadowCascades::MAX_CASCADES));
+    }
+    for (int i = 0; i < IM_ARRAYSIZE(computeShaderKernel); i++) {
+        if (computeShaderKernel[i] == benchSettings.kernelSize) {
+            KernelSizeOption = i;
+        }
+    }
+
+    // configure the point light storage buffers, read by gl_InstanceID (volumes) or light index (tiled)
+    // CPU path: every edit goes into the next ring region, the regions the GPU still reads stay untouched
     // -------------------------
-    unsigned int colorSizeBuffer;
-    glGenBuffers(1, &colorSizeBuffer);
-   
-    glBindVertexArray(VAO);
-    // set attribute pointers for light color + radius (vec4)
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, colorSizeBuffer);
-    glBufferData(GL_ARRAY_BUFFER, totalLights * sizeof(glm::vec4), &modelColorSizes[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
-    glVertexAttribDivisor(2, 1);
+    StreamBuffer lightPositionBuffer(pointLightCount * sizeof(glm::vec4));   // vec4 per light: xyz - position, w - radius
+    StreamBuffer lightColorBuffer(pointLightCount * sizeof(glm::vec4));      // vec4 per light: rgb - color
+    // GPU path: device local buffers the update shader writes in place (no CPU copy at all)
+    unsigned int gpuLightBuffers[2];   // positions, colors
+    glGenBuffers(2, gpuLightBuffers);
+    int gpuLightCapacity = 0;          // lights the device local buffers can hold
+
+    // collect the compile and link results (the driver had all of the setup above to work on them)
+    const auto shaderFinishStart = std::chrono::high_resolution_clock::now();
+    for (Shader* program : shaderPrograms) {
+        program->finish();
+    }
+    const std::chrono::duration<double, std::milli> shaderTime = shaderIssueTime + (std::chrono::high_resolution_clock::now() - shaderFinishStart);
+    std::cout << "Shader programs: " << shaderTime.count() << " ms blocking" << (parallelShaderCompile ? " (parallel compile), " : ", ");
+    if (programCache == nullptr) {
+        std::cout << "binary cache off" << std::endl;
+    }
+    else {
+        std::cout << binaryCache.getHitCount() << " linked from the binary cache, " << binaryCache.getMissCount() << " missing, "
+            << binaryCache.getRejectCount() << " rejected" << (binaryCache.isSupported() ? "" : " (no program binary formats)") << std::endl;
+    }
 
-    glBindVertexArray(0);
-    
     // shader configuration
     // --------------------
     shaderLightingPass.use();
     shaderLightingPass.setUniformInt("gPosition", 0);
+    shaderLightingPass.setUniformInt("gDepth", 0);
     shaderLightingPass.setUniformInt("gNormal", 1);
     shaderLightingPass.setUniformInt("gDiffuse", 2);
     shaderLightingPass.setUniformInt("gSpecular", 3);
     shaderLightingPass.setUniformInt("shadowMap", 4);
+    shaderLightingPass.setUniformInt("shadowSAT", 5);
+    shaderLightingPass.setUniformInt("cascadeShadowMap", 6);
     shaderLightingPass.setUniformInt("shadowMethod", ShadowMethod);
 
+    // tiled lighting shader (same units as above, the point light shadows come last)
+    computeTiledLightingShader.use();
+    computeTiledLightingShader.setUniformInt("gPosition", 0);
+    computeTiledLightingShader.setUniformInt("gDepth", 0);
+    computeTiledLightingShader.setUniformInt("gNormal", 1);
+    computeTiledLightingShader.setUniformInt("gDiffuse", 2);
+    computeTiledLightingShader.setUniformInt("gSpecular", 3);
+    computeTiledLightingShader.setUniformInt("shadowMap", 4);
+    computeTiledLightingShader.setUniformInt("shadowSAT", 5);
+    computeTiledLightingShader.setUniformInt("cascadeShadowMap", 6);
+    computeTiledLightingShader.setUniformInt("pointShadowMaps", 7);
+
     // deferred point lighting shader
     shaderPointLightingPass.use();
     shaderPointLightingPass.setUniformInt("gPosition", 0);
+    shaderPointLightingPass.setUniformInt("gDepth", 0);
     shaderPointLightingPass.setUniformInt("gNormal", 1);
     shaderPointLightingPass.setUniformInt("gDiffuse", 2);
     shaderPointLightingPass.setUniformInt("gSpecular", 3);
     shaderPointLightingPass.setUniformVec2f("screenSize", SCR_WIDTH, SCR_HEIGHT);
+    shaderPointLightingPass.setUniformInt("pointShadowMaps", 4);
 
     // G-Buffer debug shader
     shaderGBufferDebug.use();
     shaderGBufferDebug.setUniformInt("gPosition", 0);
+    shaderGBufferDebug.setUniformInt("gDepth", 0);
     shaderGBufferDebug.setUniformInt("gNormal", 1);
     shaderGBufferDebug.setUniformInt("gDiffuse", 2);
     shaderGBufferDebug.setUniformInt("gSpecular", 3);
@@ -475,11 +867,62 @@ int main()
     shaderDebugDepthMap.use();
     shaderDebugDepthMap.setUniformInt("depthMap", 0);
 
+    // uniform handles of the per-draw updates (no name lookup inside the draw loops)
+    const GLint depthWriteLightSpaceLocation = shaderDepthWrite.getUniformLocation("lightSpaceMatrix");
+    const GLint depthWriteModelLocation = shaderDepthWrite.getUniformLocation("model");
+    const GLint pointShadowModelLocation = shaderPointShadowWrite.getUniformLocation("model");
+    const GLint geometryModelLocation = shaderGeometryPass.getUniformLocation("model");
+    const GLint depthWriteBatchedLightSpaceLocation = shaderDepthWriteBatched.getUniformLocation("lightSpaceMatrix");
+    // mesh levels of detail of the shadow pass being drawn
+    std::vector<int> shadowLevels;
+
+    // benchmark configuration
+    // -----------------------
+    CameraPath cameraPath;
+    CameraPath recordedPath;
+    BenchmarkLog benchLog;
+    GpuTimer frameTimer;
+    GpuProfiler gpuProfiler;
+    int frameIndex = 0;
+    const int totalBenchmarkFrames = benchSettings.warmupFrames + benchSettings.frames;
+    if (headless) {
+        if (benchSettings.cameraPath.empty() || !cameraPath.load(benchSettings.cameraPath)) {
+            // no recorded path: orbit the camera around the scene once over the measured frames
+            PathFrame start;
+            start.camera = cameraKey(arcballCamera);
+            start.light = cameraKey(arcballLight);
+            cameraPath.generateOrbit(start, benchSettings.frames);
+        }
+    }
+
+    const std::chrono::duration<double, std::milli> startupTime = std::chrono::high_resolution_clock::now() - startupStart;
+    std::cout << "Startup: " << startupTime.count() << " ms (shader programs " << shaderTime.count() << " ms)" << std::endl;
+    if (headless) {
+        // measure the loaded scene, not the placeholders
+        assetLoader.finish();
+    }
+    bool assetsLoaded = false;
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (!glfwWindowShouldClose(window) && (!headless || frameIndex < totalBenchmarkFrames))
     {
+        auto cpuFrameStart = std::chrono::high_resolution_clock::now();
+        frameTimer.begin();
+
+        // replay the camera/light path when benchmarking
+        if (headless) {
+            const PathFrame& pathFrame = cameraPath.frame(frameIndex);
+            arcballCamera = ArcballCamera(pathFrame.camera.eye, pathFrame.camera.center, pathFrame.camera.up);
+            arcballLight = ArcballCamera(pathFrame.light.eye, pathFrame.light.center, pathFrame.light.up);
+        }
+        else if (!benchSettings.recordPath.empty()) {
+            PathFrame pathFrame;
+            pathFrame.camera = cameraKey(arcballCamera);
+            pathFrame.light = cameraKey(arcballLight);
+            recordedPath.append(pathFrame);
+        }
+
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
@@ -490,6 +933,69 @@ int main()
         // -----
         processInput(window);
 
+        // the object count slider only takes effect here, the transforms are uploaded on the next draw
+        if (sceneMesh >= 0 && sceneObjectCount != laidOutObjects) {
+            layoutObjects();
+        }
+        // visible counts of a frame the GPU is done with
+        sceneBatch.beginFrame();
+        if (shadowCullLists != 0)
+        {
+            // a static light isn't rebuilt again, so the readout follows the counters of its one rebuild
+            shadowCasterTriangles = 0;
+            for (int list = 0; list < SceneBatch::CULL_LISTS; list++) {
+                if (shadowCullLists & (1u << list)) {
+                    shadowCasterTriangles += sceneBatch.getCulledTriangles(list);
+                }
+            }
+        }
+
+        // 0. point light data: regenerated after edits and every frame while animating
+        // ------------------------------------------------------------------------------
+        lightGrid.count = pointLightCount;
+        lightGrid.spacing = 2.0f * INITIAL_POINT_LIGHT_RADIUS * pointLightSeparation;
+        lightGrid.yOffset = pointLightVerticalOffset;
+        lightGrid.radius = pointLightRadius;
+        if (animateLights) {
+            lightAnimationTime += deltaTime * lightAnimationSpeed;
+        }
+        lightGrid.time = lightAnimationTime;
+        if (lightsDirty || animateLights) {
+            if (LightUpdate == 1) {
+                GLsizeiptr lightDataSize = pointLightCount * sizeof(glm::vec4);
+                if (gpuLightCapacity < pointLightCount) {
+                    for (int i = 0; i < 2; i++) {
+                        glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpuLightBuffers[i]);
+                        glBufferData(GL_SHADER_STORAGE_BUFFER, lightDataSize, NULL, GL_DYNAMIC_COPY);
+                    }
+                    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+                    gpuLightCapacity = pointLightCount;
+                }
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_POSITION_BINDING, gpuLightBuffers[0], 0, lightDataSize);
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_COLOR_BINDING, gpuLightBuffers[1], 0, lightDataSize);
+
+                // one invocation per light, only a handful of uniforms cross the bus
+                gpuProfiler.beginPass("Light update");
+                computeLightUpdateShader.use();
+                computeLightUpdateShader.setUniformInt("lightCount", lightGrid.count);
+                computeLightUpdateShader.setUniformInt("gridWidth", lightGrid.width());
+                computeLightUpdateShader.setUniformFloat("spacing", lightGrid.spacing);
+                computeLightUpdateShader.setUniformFloat("yOffset", lightGrid.yOffset);
+                computeLightUpdateShader.setUniformFloat("radius", lightGrid.radius);
+                computeLightUpdateShader.setUniformFloat("time", lightGrid.time);
+                computeLightUpdateShader.setUniformFloat("amplitude", lightGrid.amplitude);
+                glDispatchCompute((pointLightCount + LIGHT_UPDATE_GROUP_SIZE - 1) / LIGHT_UPDATE_GROUP_SIZE, 1, 1);
+                // the light volumes read the positions per vertex, the tiled pass per invocation
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                gpuProfiler.endPass();
+            }
+            else {
+                lightGrid.generate(lightPositions, lightColors);
+                uploadPointLights(lightPositionBuffer, lightColorBuffer, lightPositions, lightColors);
+            }
+            lightsDirty = false;
+        }
+
         // render
         // ------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -502,99 +1008,335 @@ int main()
         glm::mat4 model = glm::mat4(1.0f);
         float zNear = 1.0f, zFar = 10.0f;
 
-        if (enableShadows) {
-            lightProjection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, zNear, zFar);
-            glm::vec3 lightPosition = arcballLight.eye();
-            lightView = glm::lookAt(lightPosition, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-            lightSpaceMatrix = lightProjection * lightView;
-            // render scene from light's point of view
+        // width of the filter the moments go through, in shadow map texels
+        int shadowFilterTexels = 1;
+        if (ShadowMethod == 1) {
+            shadowFilterTexels = ShadowFilter == 1 && !useCascades ? satKernelSize : computeShaderKernel[KernelSizeOption];
+        }
+
+        // draws every shadow caster into the moment target of sBuffer, returns the mesh triangles drawn
+        // (with culling 0, the list is marked in shadowCullLists and counted once the GPU is done)
+        auto renderShadowCasters = [&](const glm::mat4& casterMatrix, int cullList) {
+            // shadow map texels per world unit along the map axes
+            glm::vec3 axisX(casterMatrix[0][0], casterMatrix[1][0], casterMatrix[2][0]);
+            glm::vec3 axisY(casterMatrix[0][1], casterMatrix[1][1], casterMatrix[2][1]);
+            float texelsPerUnit = 0.5f * SHADOW_MAP_SIZE * glm::max(glm::length(axisX), glm::length(axisY));
+            // a simplified silhouette moving less than a part of the filter width disappears in the blur
+            float allowedError = glm::max(0.5f, SHADOW_LOD_TOLERANCE * shadowFilterTexels) / (texelsPerUnit * modelScale);
+            int triangles = 0;
+            shadowLevels.resize(sceneBatch.getMeshCount());
+            for (size_t i = 0; i < shadowLevels.size(); i++) {
+                shadowLevels[i] = shadowLods ? sceneBatch.selectLod(int(i), allowedError) : 0;
+            }
+
             shaderDepthWrite.use();
-            shaderDepthWrite.setUniformMat4("lightSpaceMatrix", lightSpaceMatrix);
-            shaderDepthWrite.setUniformMat4("model", model);
+            shaderDepthWrite.setUniformMat4(depthWriteLightSpaceLocation, casterMatrix);
+            shaderDepthWrite.setUniformMat4(depthWriteModelLocation, glm::mat4(1.0f));
 
             glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
             sBuffer.bindOutput();
+            // texels not covered by any caster hold the far plane moments
+            glClearColor(borderColor[0], borderColor[1], borderColor[2], borderColor[3]);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
             // render the textured floor
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, woodTexture);
             glBindVertexArray(planeVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
 
-            for (unsigned int i = 0; i < objectPositions.size(); i++)
+            if (batchedDraws && gpuCulling && sceneBatch.getObjectCount() > 0)
+            {
+                // casters outside the light frustum would be clipped away entirely
+                SceneBatch::frustumPlanes(casterMatrix, cullPlanes);
+                sceneBatch.cull(computeSceneCullShader, cullList, cullPlanes, 6, &shadowLevels[0]);
+                shaderDepthWriteBatched.use();
+                shaderDepthWriteBatched.setUniformMat4(depthWriteBatchedLightSpaceLocation, casterMatrix);
+                sceneBatch.drawCulled(cullList);
+                shadowCullLists |= 1u << cullList;
+            }
+            else if (batchedDraws && sceneBatch.getObjectCount() > 0)
+            {
+                shaderDepthWriteBatched.use();
+                shaderDepthWriteBatched.setUniformMat4(depthWriteBatchedLightSpaceLocation, casterMatrix);
+                triangles = sceneBatch.draw(&shadowLevels[0]);
+            }
+            else
             {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, objectPositions[i]);
-                model = glm::scale(model, glm::vec3(modelScale));
-                shaderDepthWrite.setUniformMat4("model", model);
-                meshModels[i]->draw(shaderDepthWrite);
+                for (int i = 0; i < sceneBatch.getObjectCount(); i++)
+                {
+                    int level = shadowLevels[sceneBatch.getObjectMesh(i)];
+                    shaderDepthWrite.setUniformMat4(depthWriteModelLocation, sceneBatch.getTransform(i));
+                    sceneBatch.drawObject(i, level);
+                    triangles += sceneBatch.getLodTriangleCount(sceneBatch.getObjectMesh(i), level);
+                }
             }
             FrameBuffer::unbind();
+            return triangles;
+        };
 
-            if (ShadowMethod == 1) { // MSM4
-                // perform shadow map blurring 
-                int width = (int)SHADOW_MAP_SIZE;
-                int height = (int)SHADOW_MAP_SIZE;
-
-                // Horizontal
-                {
-                    computeBlurShaderH.use();
-                    computeBlurShaderH.setUniformInt("ComputeKernelSize", computeShaderKernel[KernelSizeOption]);
-                    sBuffer.bindImage(0, 0, GL_RGBA32F);
-                    sBuffer.bindImage(1, 1, GL_RGBA32F);
-                    glDispatchCompute((height + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE, 1, 1);
-                    // make sure writing to image has finished before read
-                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        // box blur of the moments in sBuffer texture 0 (the result ends up there again), with a
+        // cascade given the last pass writes into its layer instead and the caller times the chain
+        auto blurMoments = [&](int cascade) {
+            const bool timePasses = cascade < 0;
+            int width = (int)SHADOW_MAP_SIZE;
+            int height = (int)SHADOW_MAP_SIZE;
+
+            // sliding window: one invocation per row (column), tiled: one workgroup per row (column) segment
+            Shader& blurShaderH = BlurBackend == 1 ? computeBlurShaderTiledH : computeBlurShaderH;
+            Shader& blurShaderV = BlurBackend == 1 ? computeBlurShaderTiledV : computeBlurShaderV;
+            int groupsHX = BlurBackend == 1 ? (width + CS_BLUR_TILE_SIZE - 1) / CS_BLUR_TILE_SIZE : (height + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE;
+            int groupsHY = BlurBackend == 1 ? height : 1;
+            int groupsVX = BlurBackend == 1 ? (height + CS_BLUR_TILE_SIZE - 1) / CS_BLUR_TILE_SIZE : (width + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE;
+            int groupsVY = BlurBackend == 1 ? width : 1;
+
+            // Horizontal
+            {
+                blurShaderH.use();
+                blurShaderH.setUniformInt("ComputeKernelSize", computeShaderKernel[KernelSizeOption]);
+                if (timePasses) gpuProfiler.beginPass("Blur H1");
+                sBuffer.bindImage(0, 0, momentFormat);
+                sBuffer.bindImage(1, 1, momentFormat);
+                glDispatchCompute(groupsHX, groupsHY, 1);
+                // make sure writing to image has finished before read
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                if (timePasses) gpuProfiler.endPass();
+
+                if (timePasses) gpuProfiler.beginPass("Blur H2");
+                sBuffer.bindImage(1, 0, momentFormat);
+                sBuffer.bindImage(0, 1, momentFormat);
+                glDispatchCompute(groupsHX, groupsHY, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                if (timePasses) gpuProfiler.endPass();
+            }
 
-                    sBuffer.bindImage(1, 0, GL_RGBA32F);
-                    sBuffer.bindImage(0, 1, GL_RGBA32F);
-                    glDispatchCompute((height + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE, 1, 1);
-                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            // Vertical
+            {
+                blurShaderV.use();
+                blurShaderV.setUniformInt("ComputeKernelSize", computeShaderKernel[KernelSizeOption]);
+                if (timePasses) gpuProfiler.beginPass("Blur V1");
+                sBuffer.bindImage(0, 0, momentFormat);
+                sBuffer.bindImage(1, 1, momentFormat);
+                glDispatchCompute(groupsVX, groupsVY, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                if (timePasses) gpuProfiler.endPass();
+
+                if (timePasses) gpuProfiler.beginPass("Blur V2");
+                if (cascade >= 0) {
+                    shadowCascades.bindImage(1, cascade);
                 }
+                else {
+                    sBuffer.bindImage(1, 0, momentFormat);
+                }
+                sBuffer.bindImage(0, 1, momentFormat);
+                glDispatchCompute(groupsVX, groupsVY, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+                if (timePasses) gpuProfiler.endPass();
+            }
+        };
 
-                // Vertical
-                {
-                    computeBlurShaderV.use();
-                    computeBlurShaderV.setUniformInt("ComputeKernelSize", computeShaderKernel[KernelSizeOption]);
-                    sBuffer.bindImage(0, 0, GL_RGBA32F);
-                    sBuffer.bindImage(1, 1, GL_RGBA32F);
-                    glDispatchCompute((width + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE, 1, 1);
-                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        if (enableShadows && useCascades) {
+            // cascaded shadow maps: each cascade is rendered and filtered in sBuffer, then stored in its array layer
+            shadowCascades.allocate();
+            shadowCascades.setCount(cascadeCount);
+            shadowCascades.setSplitLambda(cascadeSplitLambda);
+            glm::vec3 lightDirection = glm::normalize(-arcballLight.eye());
+            shadowCascades.update(arcballCamera.transform(), glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, cascadeShadowDistance, lightDirection);
+            lightSpaceMatrix = shadowCascades.getMatrix(0);
+            // the cascades are filtered in sBuffer too, and follow the camera
+            residentShadowKey = 0;
+            shadowRebuilds++;
+            shadowCasterTriangles = 0;
+            shadowCullLists = 0;
+
+            for (int i = 0; i < shadowCascades.getCount(); i++)
+            {
+                gpuProfiler.beginPass(cascadePassNames[i]);
+                shadowCasterTriangles += renderShadowCasters(shadowCascades.getMatrix(i), CASCADE_CULL_LIST + i);
+                gpuProfiler.endPass();
+
+                gpuProfiler.beginPass(cascadeFilterPassNames[i]);
+                if (ShadowMethod == 1) {
+                    // the summed-area table is not used with cascades, they always take the blur chain
+                    blurMoments(i);
+                }
+                else {
+                    shadowCascades.copyFrom(sBuffer.getTexture(0), i);
+                }
+                gpuProfiler.endPass();
+            }
+        }
+        else if (enableShadows) {
+            lightProjection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, zNear, zFar);
+            glm::vec3 lightPosition = arcballLight.eye();
+            lightView = glm::lookAt(lightPosition, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
+            lightSpaceMatrix = lightProjection * lightView;
 
-                    sBuffer.bindImage(1, 0, GL_RGBA32F);
-                    sBuffer.bindImage(0, 1, GL_RGBA32F);
-                    glDispatchCompute((width + CS_THREAD_GROUP_SIZE - 1) / CS_THREAD_GROUP_SIZE, 1, 1);
+            // everything that feeds the moments in sBuffer (and the summed-area table built from them),
+            // the camera is not part of it
+            HashKey key = sceneKey;
+            key.add(lightSpaceMatrix);
+            key.add(objectLayoutHash);
+            key.add(SHADOW_MAP_SIZE);
+            key.add(momentFormat);
+            key.add(ShadowMethod);
+            key.add(ShadowFilter);
+            key.add(computeShaderKernel[KernelSizeOption]);
+            key.add(BlurBackend);
+            key.add(shadowLods);
+            key.add(shadowFilterTexels);
+            const unsigned long long shadowKey = key.get();
+            // the summed-area table lives in satBuffer, only maps filtered in sBuffer go to disk
+            const bool cacheable = reuseShadows && cacheStaticShadows && (ShadowMethod == 0 || ShadowFilter == 0);
+
+            if (reuseShadows && shadowKey == residentShadowKey) {
+                // nothing relevant changed since the last rebuild, sBuffer (and satBuffer) still hold the map
+                if (cacheable && !residentShadowStored) {
+                    // static for a second frame: worth baking (a dragged light never gets here)
+                    std::error_code error;
+                    fs::create_directories(shadowCache.getDirectory(), error);
+                    shadowCache.store(shadowKey, sBuffer.getTexture(0));
+                    residentShadowStored = true;
+                }
+                reusedShadowFrames++;
+            }
+            else if (cacheable && shadowCache.load(shadowKey, sBuffer.getTexture(0))) {
+                // baked by an earlier run (or earlier in this one)
+                residentShadowKey = shadowKey;
+                residentShadowStored = true;
+            }
+            else {
+                // render scene from light's point of view
+                gpuProfiler.beginPass("Shadow map");
+                shadowCullLists = 0;
+                shadowCasterTriangles = renderShadowCasters(lightSpaceMatrix, SHADOW_CULL_LIST);
+                gpuProfiler.endPass();
+
+                if (ShadowMethod == 1 && ShadowFilter == 1) { // MSM4 filtered through a summed-area table
+                    // the table is built once, any box size is then a 4 tap lookup in the lighting pass
+                    gpuProfiler.beginPass("SAT rows");
+                    computeSatRowsShader.use();
+                    sBuffer.bindImage(0, 0, momentFormat, GL_READ_ONLY);
+                    satBuffer.bindImage(1, 0, GL_RGBA32UI, GL_WRITE_ONLY);
+                    glDispatchCompute(SHADOW_MAP_SIZE, 1, 1);
                     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                    gpuProfiler.endPass();
+
+                    gpuProfiler.beginPass("SAT columns");
+                    computeSatColumnsShader.use();
+                    satBuffer.bindImage(0, 0, GL_RGBA32UI, GL_READ_ONLY);
+                    satBuffer.bindImage(1, 1, GL_RGBA32UI, GL_WRITE_ONLY);
+                    glDispatchCompute(SHADOW_MAP_SIZE, 1, 1);
+                    // the table is read with texelFetch in the lighting pass
+                    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+                    gpuProfiler.endPass();
+                }
+                else if (ShadowMethod == 1) { // MSM4
+                    // perform shadow map blurring 
+                    blurMoments(-1);
                 }
-            }     
+
+                residentShadowKey = shadowKey;
+                residentShadowStored = false;
+                shadowRebuilds++;
+            }
         }
         else {
             // just clear the depth texture if shadows aren't being generated
+            gpuProfiler.beginPass("Shadow map");
+            residentShadowKey = 0;
             glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
             sBuffer.bindOutput();
-            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            glClearColor(borderColor[0], borderColor[1], borderColor[2], borderColor[3]);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            gpuProfiler.endPass();
+        }
+
+        // rebuilds per second over windows of about a second
+        if (currentFrame - shadowRateStart >= 1.0f) {
+            shadowRebuildsPerSecond = (shadowRebuilds - sampledShadowRebuilds) / (currentFrame - shadowRateStart);
+            sampledShadowRebuilds = shadowRebuilds;
+            shadowRateStart = currentFrame;
+        }
+
+        // 1.5 omnidirectional moment shadows of the point lights closest to the viewer
+        // ----------------------------------------------------------------------------
+        if (enableShadows && pointShadowCount > 0) {
+            pointShadows.allocate();
+            // only the grid cells around the viewer can hold the closest lights (and the GPU path has no CPU copy)
+            lightGrid.nearbyLights(arcballCamera.eye(), nearbyLightPositions, nearbyLightIndices);
+            pointShadows.selectLights(nearbyLightPositions, arcballCamera.eye(), pointShadowCount, &nearbyLightIndices);
+            int shadowedLights = pointShadows.getCount();
+
+            // one instance per light, the geometry shader fans every triangle out to the 6 faces
+            gpuProfiler.beginPass("Point shadows");
+            pointShadows.bindOutput();
+            shaderPointShadowWrite.use();
+            shaderPointShadowWrite.setUniformMat4v("faceViews", pointShadows.getFaceViews(), 6);
+            shaderPointShadowWrite.setUniformMat4("cubeProjection", glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, pointShadows.getMaxRadius()));
+            shaderPointShadowWrite.setUniformVec4v("lightPositions", pointShadows.getLightPositions(), shadowedLights);
+            shaderPointShadowWrite.setUniformMat4(pointShadowModelLocation, glm::mat4(1.0f));
+            glBindVertexArray(planeVAO);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, shadowedLights);
+            // the instances are the lights here, so the objects can't go through the batch
+            for (int i = 0; i < sceneBatch.getObjectCount(); i++)
+            {
+                shaderPointShadowWrite.setUniformMat4(pointShadowModelLocation, sceneBatch.getTransform(i));
+                sceneBatch.drawObject(i, 0, shadowedLights);
+            }
+            glBindVertexArray(0);
+            FrameBuffer::unbind();
+            gpuProfiler.endPass();
+
+            gpuProfiler.beginPass("Point shadow blur");
+            int groups = (POINT_SHADOW_SIZE + 15) / 16;
+            computePointShadowBlurH.use();
+            pointShadows.bindImage(0, 0, GL_READ_ONLY);
+            pointShadows.bindImage(1, 1, GL_WRITE_ONLY);
+            glDispatchCompute(groups, groups, 6 * shadowedLights);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            computePointShadowBlurV.use();
+            pointShadows.bindImage(0, 1, GL_READ_ONLY);
+            pointShadows.bindImage(1, 0, GL_WRITE_ONLY);
+            glDispatchCompute(groups, groups, 6 * shadowedLights);
+            // the moments are sampled as a cube map array in the point light pass
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+            gpuProfiler.endPass();
         }
         
         // 2. geometry pass: render scene's geometry/color data into gbuffer
         // -----------------------------------------------------------------
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 150.0f);
+        glm::mat4 view = arcballCamera.transform();
+
+        // upload the view and frame constants once, every program reads them from the uniform blocks
+        ViewConstants viewConstants;
+        viewConstants.view = view;
+        viewConstants.projection = projection;
+        viewConstants.viewPos = glm::vec4(arcballCamera.eye(), 1.0f);
+        viewConstants.inverseViewProjection = glm::inverse(projection * view);
+        viewUniforms.update(&viewConstants);
+
+        FrameConstants frameConstants;
+        frameConstants.lightSpaceMatrix = lightSpaceMatrix;
+        frameConstants.lightPosition = glm::vec4(arcballLight.eye(), 1.0f);
+        frameConstants.lightColor = glm::vec4(globalLight.color, 1.0f);
+        frameConstants.lightAttenuation = glm::vec4(gLinearAttenuation, gQuadraticAttenuation, 0.0f, 0.0f);
+        frameUniforms.update(&frameConstants);
+
         // reset viewport
+        gpuProfiler.beginPass("G-Buffer");
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         gBuffer.bindOutput();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 150.0f);
-        glm::mat4 view = arcballCamera.transform();
         model = glm::mat4(1.0f);
-        cubemapShader.use();
-        cubemapShader.setUniformMat4("projection", projection);
 
         shaderTexturedGeometryPass.use();
-        shaderTexturedGeometryPass.setUniformMat4("projection", projection);
-        shaderTexturedGeometryPass.setUniformMat4("view", view);
         shaderTexturedGeometryPass.setUniformMat4("model", model);
         glm::vec4 floorSpecular = glm::vec4(0.5f, 0.5f, 0.5f, 0.8f);
         shaderTexturedGeometryPass.setUniformVec4f("specularCol", floorSpecular);
+        shaderTexturedGeometryPass.setUniformFloat("glossiness", glossiness);
         // render the textured floor
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, woodTexture);
@@ -603,68 +1345,128 @@ int main()
 
         // render non-textured models
         shaderGeometryPass.use();
-        shaderGeometryPass.setUniformMat4("projection", projection);
-        shaderGeometryPass.setUniformMat4("view", view);
         shaderGeometryPass.setUniformMat4("model", model);
         shaderGeometryPass.setUniformVec3f("diffuseCol", diffuseColor);
         glm::vec4 specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.1f);
         glm::vec4 spec = glm::vec4(1.0f, 1.0f, 1.0f, 0.1f);
         shaderGeometryPass.setUniformVec4f("specularCol", specularColor);
-        for (unsigned int i = 0; i < objectPositions.size(); i++)
+        shaderGeometryPass.setUniformFloat("glossiness", glossiness);
+        if (batchedDraws && sceneBatch.getObjectCount() > 0)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, objectPositions[i]);
-            model = glm::scale(model, glm::vec3(modelScale));
-            shaderGeometryPass.setUniformMat4("model", model);
-            meshModels[i]->draw(shaderGeometryPass);
+            if (gpuCulling)
+            {
+                SceneBatch::frustumPlanes(projection * view, cullPlanes);
+                sceneBatch.cull(computeSceneCullShader, CAMERA_CULL_LIST, cullPlanes, 6);
+            }
+            shaderGeometryPassBatched.use();
+            shaderGeometryPassBatched.setUniformVec3f("diffuseCol", diffuseColor);
+            shaderGeometryPassBatched.setUniformVec4f("specularCol", specularColor);
+            shaderGeometryPassBatched.setUniformFloat("glossiness", glossiness);
+            if (gpuCulling) {
+                sceneBatch.drawCulled(CAMERA_CULL_LIST);
+            }
+            else {
+                sceneBatch.draw();
+            }
+        }
+        else
+        {
+            for (int i = 0; i < sceneBatch.getObjectCount(); i++)
+            {
+                shaderGeometryPass.setUniformMat4(geometryModelLocation, sceneBatch.getTransform(i));
+                sceneBatch.drawObject(i, 0);
+            }
         }
         FrameBuffer::unbind();
+        gpuProfiler.endPass();
 
-        // 3. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content and shadow map
-        // -----------------------------------------------------------------------------------------------------------------------
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        if (gBufferMode == 0)
-        {
-            shaderLightingPass.use();
+        // shadowed lights look up their cube map slot in the scene light index table
+        int shadowedLightCount = (enableShadows && pointShadowCount > 0) ? pointShadows.getCount() : 0;
+
+        // G-Buffer, shadow textures and global light uniforms, shared by the fragment and the tiled path
+        auto bindGlobalLightInputs = [&](Shader& shader) {
             // bind all of our input textures
             gBuffer.bindInput();
 
             // bind depth texture
             glActiveTexture(GL_TEXTURE4);
             sBuffer.bindTex(0);
-
-            glm::vec3 lightPosition = arcballLight.eye();
-            shaderLightingPass.setUniformVec3f("gLight.Position", lightPosition);
-            shaderLightingPass.setUniformVec3f("gLight.Color", globalLight.color);
-            shaderLightingPass.setUniformFloat("gLight.Linear", gLinearAttenuation);
-            shaderLightingPass.setUniformFloat("gLight.Quadratic", gQuadraticAttenuation);
+            // and the moment summed-area table
+            glActiveTexture(GL_TEXTURE5);
+            satBuffer.bindTex(1);
+            // and the cascades
+            glActiveTexture(GL_TEXTURE6);
+            shadowCascades.bindTex();
 
             glm::vec3 camPosition = arcballCamera.eye();
-            shaderLightingPass.setUniformVec3f("viewPos", camPosition);
-            shaderLightingPass.setUniformMat4("lightSpaceMatrix", lightSpaceMatrix);
-            shaderLightingPass.setUniformFloat("glossiness", glossiness);
-            shaderLightingPass.setUniformInt("shadowMethod", ShadowMethod);
-        }
-        else // for G-Buffer debuging 
-        {
-            shaderGBufferDebug.use();
-            shaderGBufferDebug.setUniformInt("gBufferMode", gBufferMode);
-            // bind all of our input textures
-            gBuffer.bindInput();
+            shader.setUniformFloat("glossiness", glossiness);
+            shader.setUniformInt("shadowMethod", ShadowMethod);
+            // with shadows off only sBuffer is cleared, the summed-area table still holds the last map
+            shader.setUniformInt("shadowFilter", enableShadows ? ShadowFilter : 0);
+            shader.setUniformInt("satKernelSize", satKernelSize);
+            int activeCascades = (enableShadows && useCascades) ? shadowCascades.getCount() : 0;
+            shader.setUniformInt("cascadeCount", activeCascades);
+            if (activeCascades > 0) {
+                glm::vec3 cameraForward = glm::normalize(arcballCamera.center() - camPosition);
+                shader.setUniformVec3f("cameraForward", cameraForward);
+                shader.setUniformMat4v("cascadeMatrices", shadowCascades.getMatrices(), activeCascades);
+                shader.setUniformFloatv("cascadeSplits", shadowCascades.getSplits(), activeCascades);
+            }
+        };
+
+        if (gBufferMode == 0 && LightingPath == 1) {
+            // 3. tiled lighting pass: every workgroup culls the point lights against its tile, reads the G-Buffer
+            // once per pixel and evaluates the global light and the point lights of its list in a single dispatch
+            // -----------------------------------------------------------------------------------------------------
+            gpuProfiler.beginPass("Tiled lighting");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            computeTiledLightingShader.use();
+            bindGlobalLightInputs(computeTiledLightingShader);
+            glActiveTexture(GL_TEXTURE7);
+            pointShadows.bindTex();
+            computeTiledLightingShader.setUniformIntv("shadowedLights", pointShadows.getLightIndices(), PointShadows::MAX_SHADOWED_LIGHTS);
+            computeTiledLightingShader.setUniformInt("shadowedLightCount", shadowedLightCount);
+            computeTiledLightingShader.setUniformInt("pointLightCount", pointLightCount);
+            computeTiledLightingShader.setUniformFloat("lightIntensity", pointLightIntensity);
+            lightBuffer.bindImage(0, 0, GL_RGBA8, GL_WRITE_ONLY);
+            glDispatchCompute((SCR_WIDTH + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, (SCR_HEIGHT + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, 1);
+            // the result is read back through the framebuffer blit
+            glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+            lightBuffer.bindRead();
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            FrameBuffer::unbind();
+            gpuProfiler.endPass();
         }
+        else {
+            // 3. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content and shadow map
+            // -----------------------------------------------------------------------------------------------------------------------
+            gpuProfiler.beginPass("Deferred shading");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (gBufferMode == 0)
+            {
+                shaderLightingPass.use();
+                bindGlobalLightInputs(shaderLightingPass);
+            }
+            else // for G-Buffer debuging 
+            {
+                shaderGBufferDebug.use();
+                shaderGBufferDebug.setUniformInt("gBufferMode", gBufferMode);
+                // bind all of our input textures
+                gBuffer.bindInput();
+            }
         
-        // finally render quad
-        renderQuad();
-
-        static bool colorSizeBufferDirty = false;
+            // finally render quad
+            renderQuad();
+            gpuProfiler.endPass();
+        }
 
         // 3.5 lighting pass: render point lights on top of main scene with additive blending and utilizing G-Buffer for lighting.
         // -----------------------------------------------------------------------------------------------------------------------
-        if (gBufferMode == 0) {
+        if (gBufferMode == 0 && LightingPath == 0 && lightModel) {
+            gpuProfiler.beginPass("Point lights");
             shaderPointLightingPass.use();
             gBuffer.bindInput();
-            shaderPointLightingPass.setUniformMat4("projection", projection);
-            shaderPointLightingPass.setUniformMat4("view", view);
 
             glEnable(GL_CULL_FACE);
             // only render the back faces of the light volume spheres
@@ -673,27 +1475,24 @@ int main()
             // enable additive blending
             glEnable(GL_BLEND);
             glBlendFunc(GL_ONE, GL_ONE);
-            glm::vec3 camPosition = arcballCamera.eye();
-            shaderPointLightingPass.setUniformVec3f("viewPos", camPosition);
             shaderPointLightingPass.setUniformFloat("lightIntensity", pointLightIntensity);
             shaderPointLightingPass.setUniformFloat("glossiness", glossiness);
-            glBindVertexArray(lightModel.meshes[0].VAO);
-            // don't update the color and size buffer every frame
-            if (colorSizeBufferDirty) {
-                glBindBuffer(GL_ARRAY_BUFFER, colorSizeBuffer);
-                glBufferData(GL_ARRAY_BUFFER, LIGHT_GRID_WIDTH * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT * sizeof(glm::vec4), &modelColorSizes[0], GL_STATIC_DRAW);
-            }
-            glDrawElementsInstanced(GL_TRIANGLES, lightModel.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, totalLights);
-            glBindVertexArray(0);
+            glActiveTexture(GL_TEXTURE4);
+            pointShadows.bindTex();
+            shaderPointLightingPass.setUniformIntv("shadowedLights", pointShadows.getLightIndices(), PointShadows::MAX_SHADOWED_LIGHTS);
+            shaderPointLightingPass.setUniformInt("shadowedLightCount", shadowedLightCount);
+            lightModel->drawInstanced(pointLightCount);
 
             glDisable(GL_BLEND);
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             glFrontFace(GL_CCW);
             glDisable(GL_CULL_FACE);
+            gpuProfiler.endPass();
         }
 
         // render cubemap with depth testing enabled
-        if (gBufferMode == 0) { 
+        if (gBufferMode == 0) {
+            gpuProfiler.beginPass("Skybox");
             // copy content of geometry's depth buffer to default framebuffer's depth buffer
             // ----------------------------------------------------------------------------------
             gBuffer.bindRead();
@@ -704,40 +1503,36 @@ int main()
             FrameBuffer::unbind();
 
             glEnable(GL_DEPTH_TEST);
-            cubemapShader.use();
-            cubemapShader.setUniformMat4("view", view);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-            renderCube();
+            if (environmentReady) {
+                cubemapShader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+                renderCube();
+            }
+            gpuProfiler.endPass();
         }
 
         // strictly used for debugging point light volumes (sizes, positions, etc)
-        if (drawPointLights && gBufferMode == 0) {
+        if (drawPointLights && gBufferMode == 0 && lightModel) {
             // re-enable the depth testing 
             glEnable(GL_DEPTH_TEST);
 
             // render lights on top of scene with Z-testing
             // --------------------------------
             shaderLightSphere.use();
-            shaderLightSphere.setUniformMat4("projection", projection);
-            shaderLightSphere.setUniformMat4("view", view);
 
             glPolygonMode(GL_FRONT_AND_BACK, drawPointLightsWireframe ? GL_LINE : GL_FILL);
-            glBindVertexArray(lightModel.meshes[0].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, lightModel.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, totalLights);
-            glBindVertexArray(0);
+            lightModel->drawInstanced(pointLightCount);
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
             shaderGlobalLightSphere.use();
-            shaderGlobalLightSphere.setUniformMat4("projection", projection);
-            shaderGlobalLightSphere.setUniformMat4("view", view);
             // render the global light model
             model = glm::mat4(1.0f);
             model = glm::translate(model, arcballLight.eye());
             shaderGlobalLightSphere.setUniformMat4("model", model);
             shaderGlobalLightSphere.setUniformVec3f("lightColor", globalLight.color);
             shaderGlobalLightSphere.setUniformFloat("lightRadius", globalLight.radius);
-            lightModel.draw(shaderGlobalLightSphere);
+            lightModel->draw();
         }
 
         if (showDepthMap) {
@@ -755,14 +1550,12 @@ int main()
             renderQuad();
         }
 
-        // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
+        // Start the Dear ImGui frame (no UI is drawn offscreen)
+        if (!headless)
         {
-            static float f = 0.0f;
-            static int counter = 0;
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
 
             ImGui::Begin("Controls");                          // Create a window called "Controls" and append into it.
 
@@ -770,6 +1563,16 @@ int main()
                 ImGui::ColorEdit3("Diffuse (Kd)", (float*)&diffuseColor);   // Edit 3 floats representing Kd color (r, g, b)
                 ImGui::ColorEdit4("Specular (Ks)", (float*)&specularColor); // Edit 4 floats representing Ks color (r, g, b, alpha)
                 ImGui::SliderFloat("Glossiness", &glossiness, 8.0, 128.0f);
+                ImGui::SliderInt("Objects", &sceneObjectCount, 1, MAX_SCENE_OBJECTS);
+                ImGui::Checkbox("Batched Draws (multi-draw indirect)", &batchedDraws);
+                if (batchedDraws)
+                {
+                    ImGui::Checkbox("GPU Culling", &gpuCulling);
+                    if (gpuCulling) {
+                        ImGui::Text("Visible objects: %i camera / %i shadow of %i", sceneBatch.getCulledObjects(CAMERA_CULL_LIST),
+                            sceneBatch.getCulledObjects(useCascades ? CASCADE_CULL_LIST : SHADOW_CULL_LIST), sceneBatch.getObjectCount());
+                    }
+                }
             }
             if (ImGui::CollapsingHeader("Lighting Config")) {
                 if (ImGui::CollapsingHeader("Global Light")) {
@@ -780,18 +1583,22 @@ int main()
 
                 if (ImGui::CollapsingHeader("Point Lights")) {
                     ImGui::SliderFloat("Intensity", &pointLightIntensity, 0.0f, 3.0f, "%.3f");
-                    if (ImGui::SliderFloat("Radius", &pointLightRadius, 0.3f, 2.5f, "%.3f")) {
-                        updatePointLights(modelMatrices, modelColorSizes, pointLightSeparation, pointLightVerticalOffset, pointLightRadius);
-                        colorSizeBufferDirty = true;
-                    }
-                    else {
-                        colorSizeBufferDirty = false;
-                    }
-                    if (ImGui::SliderFloat("Separation", &pointLightSeparation, 0.4f, 1.5f, "%.3f")) {
-                        updatePointLights(modelMatrices, modelColorSizes, pointLightSeparation, pointLightVerticalOffset, pointLightRadius);
+                    // +/- 100 per step, 10k with ctrl held
+                    if (ImGui::InputInt("Light Count", &pointLightCount, 100, 10000)) {
+                        pointLightCount = glm::clamp(pointLightCount, 1, MAX_POINT_LIGHT_COUNT);
+                        lightsDirty = true;
                     }
-                    if (ImGui::SliderFloat("Vertical Offset", &pointLightVerticalOffset, -2.0f, 3.0f)) {
-                        updatePointLights(modelMatrices, modelColorSizes, pointLightSeparation, pointLightVerticalOffset, pointLightRadius);
+                    lightsDirty |= ImGui::SliderFloat("Radius", &pointLightRadius, 0.3f, 2.5f, "%.3f");
+                    lightsDirty |= ImGui::SliderFloat("Separation", &pointLightSeparation, 0.4f, 1.5f, "%.3f");
+                    lightsDirty |= ImGui::SliderFloat("Vertical Offset", &pointLightVerticalOffset, -2.0f, 3.0f);
+                    const char* lightUpdate[] = { "CPU upload", "GPU compute" };
+                    // the other path's buffers get bound (and filled) on the next frame
+                    lightsDirty |= ImGui::Combo("Light Update", &LightUpdate, lightUpdate, IM_ARRAYSIZE(lightUpdate));
+                    ImGui::Checkbox("Animate", &animateLights);
+                    ImGui::SliderFloat("Animation Speed", &lightAnimationSpeed, 0.0f, 4.0f, "%.2f");
+                    ImGui::SliderInt("Shadowed Lights", &pointShadowCount, 0, PointShadows::MAX_SHADOWED_LIGHTS);
+                    if (pointShadowCount > 0) {
+                        ImGui::Text("Point shadow memory: %.0f MB", pointShadows.sizeInBytes() / (1024.0 * 1024.0));
                     }
                 }
 
@@ -800,15 +1607,42 @@ int main()
                     ImGui::Checkbox("Enabled", &enableShadows);
                     const char* shadowMethod[] = { "Standard", "Moment Shadow Map"};
                     ImGui::Combo("Shadow Method", &ShadowMethod, shadowMethod, IM_ARRAYSIZE(shadowMethod));
-                    // 7, 15, 23, 35, 63, 127
-                    const char* kernelSize[] = { "7x7", "15x15", "23x23", "35x35", "63x63", "127x127" };
-                    ImGui::Combo("Blur Kernel", &KernelSizeOption, kernelSize, IM_ARRAYSIZE(kernelSize));
+                    const char* shadowFilter[] = { "Box blur", "Summed-area table" };
+                    ImGui::Combo("Moment Filter", &ShadowFilter, shadowFilter, IM_ARRAYSIZE(shadowFilter));
+                    if (ShadowFilter == 1) {
+                        ImGui::SliderInt("SAT Kernel", &satKernelSize, 1, SAT_MAX_KERNEL_SIZE);
+                    }
+                    else {
+                        // 7, 15, 23, 35, 63, 127
+                        const char* kernelSize[] = { "7x7", "15x15", "23x23", "35x35", "63x63", "127x127" };
+                        ImGui::Combo("Blur Kernel", &KernelSizeOption, kernelSize, IM_ARRAYSIZE(kernelSize));
+                        const char* blurBackend[] = { "Sliding window", "Tiled (shared memory)" };
+                        ImGui::Combo("Blur Backend", &BlurBackend, blurBackend, IM_ARRAYSIZE(blurBackend));
+                    }
+                    ImGui::Checkbox("Cascades", &useCascades);
+                    if (useCascades) {
+                        ImGui::SliderInt("Cascade Count", &cascadeCount, 1, ShadowCascades::MAX_CASCADES);
+                        ImGui::SliderFloat("Shadow Distance", &cascadeShadowDistance, 5.0f, MAX_CAMERA_DISTANCE);
+                        ImGui::SliderFloat("Split Lambda", &cascadeSplitLambda, 0.0f, 1.0f);
+                        ImGui::Text("Cascade memory: %.0f MB (box blur only)", shadowCascades.sizeInBytes() / (1024.0 * 1024.0));
+                    }
+                    ImGui::Checkbox("Reuse Unchanged Shadows", &reuseShadows);
+                    if (reuseShadows) {
+                        ImGui::Checkbox("Cache Static Shadows", &cacheStaticShadows);
+                    }
+                    if (reuseShadows && cacheStaticShadows) {
+                        ImGui::Text("%i loaded / %i baked maps", shadowCache.getLoadCount(), shadowCache.getStoreCount());
+                    }
+                    ImGui::Checkbox("Shadow Caster LODs", &shadowLods);
+                    ImGui::Text("Shadow caster triangles: %i", shadowCasterTriangles);
                 }
             }
             if (ImGui::CollapsingHeader("Debug")) {
                 const char* gBuffers[] = { "Final render", "Position (world)", "Normal (world)", "Diffuse", "Specular"};
                 ImGui::Combo("G-Buffer View", &gBufferMode, gBuffers, IM_ARRAYSIZE(gBuffers));
                 shaderLightingPass.setUniformInt("gBufferMode", gBufferMode);
+                const char* lightingPath[] = { "Fragment + light volumes", "Tiled compute" };
+                ImGui::Combo("Lighting Path", &LightingPath, lightingPath, IM_ARRAYSIZE(lightingPath));
                 ImGui::Checkbox("Point lights volumes", &drawPointLights);
                 ImGui::SameLine(); ImGui::Checkbox("Wireframe", &drawPointLightsWireframe);
                 ImGui::Checkbox("Show depth texture", &showDepthMap);
@@ -816,23 +1650,86 @@ int main()
                 ImGui::RadioButton("Camera", &mouseControl, 0); ImGui::SameLine();
                 ImGui::RadioButton("Light", &mouseControl, 1);
             }
+            if (ImGui::CollapsingHeader("GPU Timings")) {
+                const std::vector<std::string>& passNames = gpuProfiler.passNames();
+                const std::vector<double>& passTimes = gpuProfiler.smoothedTimes();
+                double passTotal = 0.0;
+                for (size_t i = 0; i < passNames.size(); i++) {
+                    ImGui::Text("%-18s %7.3f ms", passNames[i].c_str(), passTimes[i]);
+                    passTotal += passTimes[i];
+                }
+                ImGui::Separator();
+                ImGui::Text("%-18s %7.3f ms", "Passes total", passTotal);
+                ImGui::Text("%-18s %7.3f ms", "Frame (GPU)", frameTimer.elapsedMs());
+                if (ImGui::Button("Dump to gpu_timings.json")) {
+                    gpuProfiler.write("gpu_timings.json");
+                }
+            }
                                                                     
             //ImGui::ShowDemoWindow();
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-            ImGui::Text("Point lights in scene: %i", LIGHT_GRID_WIDTH * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT);
+            ImGui::Text("Moment storage: %s (%.0f MB)", momentStorage16 ? "RGBA16 optimized" : "RGBA32F",
+                2.0 * SHADOW_MAP_SIZE * SHADOW_MAP_SIZE * (momentStorage16 ? 8.0 : 16.0) / (1024.0 * 1024.0));
+            ImGui::Text("G-Buffer: %s (%i bytes/pixel, %.1f MB)", compactGBuffer ? "compact" : "full", gBufferBytesPerPixel,
+                double(gBufferBytesPerPixel) * SCR_WIDTH * SCR_HEIGHT / (1024.0 * 1024.0));
+            ImGui::Text("Shadow map rebuilds: %.1f/s (%i frames reused)", shadowRebuildsPerSecond, reusedShadowFrames);
+            ImGui::Text("Point lights in scene: %i (%.2f MB light data)", pointLightCount, pointLightCount * 2.0 * sizeof(glm::vec4) / (1024.0 * 1024.0));
+            // cost of the point lights on the GPU, shows where the lighting path stops scaling
+            const std::vector<std::string>& timedPasses = gpuProfiler.passNames();
+            for (size_t i = 0; i < timedPasses.size(); i++) {
+                if (timedPasses[i] == (LightingPath == 1 ? "Tiled lighting" : "Point lights")) {
+                    double lightingMs = gpuProfiler.smoothedTimes()[i];
+                    ImGui::Text("%s: %.3f ms (%.1f ns per light)", timedPasses[i].c_str(), lightingMs, lightingMs * 1.0e6 / pointLightCount);
+                }
+            }
             ImGui::End();
 
+            // Rendering
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         }
 
-        // Rendering
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // GL steps of the assets that finished loading, after the frame so it went out with the placeholders
+        if (!assetsLoaded && assetLoader.update() == 0) {
+            const std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - startupStart;
+            std::cout << "Assets loaded: " << loadTime.count() << " ms after start" << std::endl;
+            assetsLoaded = true;
+        }
+
+        // frame timing, GPU results arrive with one frame of latency
+        frameTimer.end();
+        gpuProfiler.endFrame();
+        std::chrono::duration<double, std::milli> cpuFrameTime = std::chrono::high_resolution_clock::now() - cpuFrameStart;
+        if (headless && frameIndex >= benchSettings.warmupFrames) {
+            benchLog.addFrame(cpuFrameTime.count());
+            if (frameTimer.valid()) {
+                int previousFrame = frameIndex - 1 - benchSettings.warmupFrames;
+                benchLog.setGpuTime(previousFrame, frameTimer.elapsedMs());
+                benchLog.setPassTimes(previousFrame, gpuProfiler.passNames(), gpuProfiler.passTimes());
+            }
+        }
+        frameIndex++;
+    }
+
+    if (headless) {
+        frameTimer.flush();
+        gpuProfiler.flush();
+        benchLog.setGpuTime(benchLog.frameCount() - 1, frameTimer.elapsedMs());
+        benchLog.setPassTimes(benchLog.frameCount() - 1, gpuProfiler.passNames(), gpuProfiler.passTimes());
+        benchLog.printSummary();
+        std::cout << "Shadow map rebuilds: " << shadowRebuilds << " in " << frameIndex << " frames" << std::endl;
+        if (!benchSettings.outputPath.empty()) {
+            benchLog.write(benchSettings.outputPath, benchSettings);
+        }
+    }
+    else if (!benchSettings.recordPath.empty()) {
+        recordedPath.save(benchSettings.recordPath);
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -845,75 +1742,29 @@ int main()
 
 }
 
-// Node: separation < 1.0 will cause lights to penetrate each other, and > 1.0 they will separate (1.0 is just touching)
-void configurePointLights(std::vector<glm::mat4>& modelMatrices, std::vector<glm::vec4>& modelColorSizes, float radius, float separation, float yOffset)
+// write the light data into the next ring regions and bind them (the light count may have changed)
+void uploadPointLights(StreamBuffer& positionBuffer, StreamBuffer& colorBuffer, const std::vector<glm::vec4>& lightPositions, const std::vector<glm::vec4>& lightColors)
 {
-    srand(glfwGetTime());
-    // add some uniformly spaced point lights
-    for (unsigned int lightIndexX = 0; lightIndexX < LIGHT_GRID_WIDTH; lightIndexX++)
-    {
-        for (unsigned int lightIndexZ = 0; lightIndexZ < LIGHT_GRID_WIDTH; lightIndexZ++)
-        {
-            for (unsigned int lightIndexY = 0; lightIndexY < LIGHT_GRID_HEIGHT; lightIndexY++)
-            {
-                float diameter = 2.0f * radius;
-                float xPos = (lightIndexX - (LIGHT_GRID_WIDTH - 1.0f) / 2.0f) * (diameter * separation);
-                float zPos = (lightIndexZ - (LIGHT_GRID_WIDTH - 1.0f) / 2.0f) * (diameter * separation);
-                float yPos = (lightIndexY - (LIGHT_GRID_HEIGHT - 1.0f) / 2.0f) * (diameter * separation) + yOffset;
-                double angle = double(rand()) * 2.0 * glm::pi<float>() / (double(RAND_MAX));
-                double length = double(rand()) * 0.5 / (double(RAND_MAX));
-                float xOffset = cos(angle) * length;
-                float zOffset = sin(angle) * length;
-                xPos += xOffset;
-                zPos += zOffset;
-                // also calculate random color
-                float rColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-                float gColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-                float bColor = ((rand() % 100) / 200.0f) + 0.5; // between 0.5 and 1.0
-
-                int curLight = lightIndexX * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT + lightIndexZ * LIGHT_GRID_HEIGHT + lightIndexY;
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, glm::vec3(xPos, yPos, zPos));
-                // now add to list of matrices
-                modelMatrices.emplace_back(model);
-                modelColorSizes.emplace_back(glm::vec4(rColor, gColor, bColor, radius));
-            }
-        }
-    }
+    GLsizeiptr size = lightPositions.size() * sizeof(glm::vec4);
+    positionBuffer.write(&lightPositions[0], size);
+    positionBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_POSITION_BINDING, size);
+    colorBuffer.write(&lightColors[0], size);
+    colorBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_COLOR_BINDING, size);
 }
 
-void updatePointLights(std::vector<glm::mat4>& modelMatrices, std::vector<glm::vec4>& modelColorSizes, float separation, float yOffset, float radius)
-{
-    if (separation < 0.0f) {
-        return;
-    }
-    // add some uniformly spaced point lights
-    for (unsigned int lightIndexX = 0; lightIndexX < LIGHT_GRID_WIDTH; lightIndexX++)
-    {
-        for (unsigned int lightIndexZ = 0; lightIndexZ < LIGHT_GRID_WIDTH; lightIndexZ++)
-        {
-            for (unsigned int lightIndexY = 0; lightIndexY < LIGHT_GRID_HEIGHT; lightIndexY++)
-            {
-                int curLight = lightIndexX * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT + lightIndexZ * LIGHT_GRID_HEIGHT + lightIndexY;
-                float diameter = 2.0f * INITIAL_POINT_LIGHT_RADIUS;
-                float xPos = (lightIndexX - (LIGHT_GRID_WIDTH - 1.0f) / 2.0f) * (diameter * separation);
-                float zPos = (lightIndexZ - (LIGHT_GRID_WIDTH - 1.0f) / 2.0f) * (diameter * separation);
-                float yPos = (lightIndexY - (LIGHT_GRID_HEIGHT - 1.0f) / 2.0f) * (diameter * separation);
-                
-                // modify matrix translation
-                modelMatrices[curLight][3] = glm::vec4(xPos, yPos + yOffset, zPos, 1.0);
-                modelColorSizes[curLight].w = radius;
-            }
-        }
-    }
 
-    // update the instance matrix buffer
-    glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer);
-    glBufferData(GL_ARRAY_BUFFER, LIGHT_GRID_WIDTH * LIGHT_GRID_WIDTH * LIGHT_GRID_HEIGHT * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+// cameraKey() captures the eye/center/up of an arcball camera for path recording
+// ------------------------------------------------------------------------------
+CameraKey cameraKey(ArcballCamera& camera)
+{
+    CameraKey key;
+    key.eye = camera.eye();
+    key.center = camera.center();
+    // the camera's up vector is the second column of the inverse view matrix
+    key.up = glm::vec3(glm::inverse(camera.transform())[1]);
+    return key;
 }
 
-
 // renderQuad() renders a 1x1 XY quad in NDC
 // -----------------------------------------
 unsigned int quadVAO = 0;
@@ -1114,50 +1965,32 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     }
 }
 
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const * path, bool gammaCorrection)
+// utility function for uploading a decoded 2D image into a texture
+// ------------------------------------------------------------------
+void uploadTexture(unsigned int textureID, const TextureImage& image, bool gammaCorrection)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    GLenum internalFormat = GL_RED;
+    GLenum dataFormat = GL_RED;
+    if (image.components == 3)
     {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, internalFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, internalFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
+        dataFormat = GL_RGB;
     }
-    else
+    else if (image.components == 4)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
+        dataFormat = GL_RGBA;
     }
 
-    return textureID;
-}
\ No newline at end of file
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    // rows of 3 byte texels aren't 4 byte aligned in general
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, internalFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, internalFormat == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
@@ -0,0 +1,74 @@
+#include "assetloader.h"
+
+#include <algorithm>
+
+AssetLoader::AssetLoader(int threads)
+    :
+    pool(std::max(2, threads > 0 ? threads + 1 : int(std::thread::hardware_concurrency()))),
+    running(0)
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this] { return running == 0; });
+}
+
+void AssetLoader::run(std::function<void()> work, std::function<void()> upload)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running++;
+    }
+    pool.submit([this, work, upload] {
+        work();
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.push_back(upload);
+        running--;
+        workDone.notify_all();
+    });
+}
+
+void AssetLoader::runOnContext(std::function<void()> step)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    contextSteps.push_back(step);
+}
+
+int AssetLoader::update()
+{
+    std::deque<std::function<void()>> ready;
+    std::function<void()> step;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(uploads);
+        if (!contextSteps.empty()) {
+            step = contextSteps.front();
+            contextSteps.pop_front();
+        }
+    }
+    // outside the lock, the GL steps may queue more work
+    for (std::function<void()>& upload : ready) {
+        upload();
+    }
+    if (step) {
+        step();
+    }
+    return getPendingCount();
+}
+
+void AssetLoader::finish()
+{
+    while (update() > 0)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this] { return !uploads.empty() || !contextSteps.empty() || running == 0; });
+    }
+}
+
+int AssetLoader::getPendingCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return running + int(uploads.size() + contextSteps.size());
+}
@@ -0,0 +1,44 @@
+#ifndef _ASSET_LOADER_H_
+#define _ASSET_LOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "threadpool.h"
+
+// Startup task graph: file decoding and parsing run on worker threads, everything touching GL
+// is funneled back to the context thread through update(), which the render loop calls once per
+// frame. Until a job's GL step has run, the renderer keeps drawing whatever placeholder it has.
+class AssetLoader
+{
+public:
+    // number of worker threads, 0 - one per hardware thread besides the caller (always at least one)
+    explicit AssetLoader(int threads = 0);
+    // waits for the worker jobs still running (their GL steps are dropped), they report back into
+    // the members below
+    ~AssetLoader();
+    // run work() on a worker, then upload() on the context thread in the first update() after it
+    void run(std::function<void()> work, std::function<void()> upload);
+    // run step() on the context thread in a later update(), one such step per update() so that
+    // several heavy GL-only loads don't stall the same frame
+    void runOnContext(std::function<void()> step);
+    // context thread, once per frame: run the GL steps that are ready, returns the jobs still pending
+    int update();
+    // context thread: block until every job and GL step is done (headless runs measure a loaded scene)
+    void finish();
+    int getPendingCount();
+
+private:
+    ThreadPool pool;
+    std::mutex mutex;
+    std::condition_variable workDone;
+    std::deque<std::function<void()>> uploads;        // worker jobs done, GL step left
+    std::deque<std::function<void()>> contextSteps;   // GL-only jobs
+    int running;                                      // worker jobs not finished yet
+
+};
+
+
+#endif
@@ -0,0 +1,467 @@
+#include "benchmark.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using std::cout;
+using std::endl;
+
+BenchmarkSettings::BenchmarkSettings()
+    :
+    headless(false),
+    cpuMomentBenchmark(false),
+    cpuFilterBenchmark(false),
+    meshBenchmark(false),
+    contextApi("native"),
+    frames(600),
+    warmupFrames(30),
+    shadowMethod(1),
+    kernelSize(7),
+    blurBackend(0),
+    shadowFilter(0),
+    momentBits(32),
+    gBufferLayout(1),
+    cascades(0),
+    pointShadows(0),
+    lightingPath(0),
+    pointLights(100),
+    lightUpdate(0),
+    sceneObjects(1),
+    drawPath(1),
+    culling(1),
+    animateLights(false),
+    shadowCache(false),
+    forceShadowRebuild(false),
+    programCache(true)
+{
+}
+
+bool BenchmarkSettings::parse(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg == "--cpu-msm-bench") {
+            cpuMomentBenchmark = true;
+        }
+        else if (arg == "--cpu-blur-bench") {
+            cpuFilterBenchmark = true;
+        }
+        else if (arg == "--mesh-bench") {
+            meshBenchmark = true;
+            // the OBJ is optional
+            if (hasValue && std::string(argv[i + 1]).compare(0, 2, "--") != 0) {
+                meshBenchmarkPath = argv[++i];
+            }
+        }
+        else if (arg == "--context" && hasValue) {
+            contextApi = argv[++i];
+            if (contextApi != "native" && contextApi != "egl" && contextApi != "osmesa") {
+                cout << "Unknown context API: " << contextApi << endl;
+                return false;
+            }
+        }
+        else if (arg == "--frames" && hasValue) {
+            frames = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--warmup" && hasValue) {
+            warmupFrames = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--shadow-method" && hasValue) {
+            shadowMethod = atoi(argv[++i]);
+            if (shadowMethod != 0 && shadowMethod != 1) {
+                cout << "Unknown shadow method: " << shadowMethod << endl;
+                return false;
+            }
+        }
+        else if (arg == "--kernel" && hasValue) {
+            kernelSize = atoi(argv[++i]);
+        }
+        else if (arg == "--blur-backend" && hasValue) {
+            blurBackend = atoi(argv[++i]);
+        }
+        else if (arg == "--moment-storage" && hasValue) {
+            momentBits = atoi(argv[++i]);
+            if (momentBits != 16 && momentBits != 32) {
+                cout << "Moment storage must be 16 or 32 bits" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--filter" && hasValue) {
+            shadowFilter = atoi(argv[++i]);
+            if (shadowFilter != 0 && shadowFilter != 1) {
+                cout << "Unknown shadow filter: " << shadowFilter << endl;
+                return false;
+            }
+        }
+        else if (arg == "--gbuffer" && hasValue) {
+            gBufferLayout = atoi(argv[++i]);
+            if (gBufferLayout != 0 && gBufferLayout != 1) {
+                cout << "G-buffer layout must be 0 (full) or 1 (compact)" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--cascades" && hasValue) {
+            cascades = atoi(argv[++i]);
+            if (cascades < 0 || cascades > 4) {
+                cout << "Cascade count must be between 0 and 4" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--point-shadows" && hasValue) {
+            pointShadows = atoi(argv[++i]);
+            if (pointShadows < 0 || pointShadows > 8) {
+                cout << "Shadowed point light count must be between 0 and 8" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--lighting" && hasValue) {
+            lightingPath = atoi(argv[++i]);
+        }
+        else if (arg == "--point-lights" && hasValue) {
+            pointLights = atoi(argv[++i]);
+            if (pointLights < 1) {
+                cout << "Point light count must be at least 1" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--light-update" && hasValue) {
+            lightUpdate = atoi(argv[++i]);
+        }
+        else if (arg == "--objects" && hasValue) {
+            sceneObjects = atoi(argv[++i]);
+            if (sceneObjects < 1) {
+                cout << "Object count must be at least 1" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--draw-path" && hasValue) {
+            drawPath = atoi(argv[++i]);
+        }
+        else if (arg == "--culling" && hasValue) {
+            culling = atoi(argv[++i]);
+        }
+        else if (arg == "--animate-lights") {
+            animateLights = true;
+        }
+        else if (arg == "--shadow-cache") {
+            shadowCache = true;
+        }
+        else if (arg == "--force-shadow-rebuild") {
+            forceShadowRebuild = true;
+        }
+        else if (arg == "--no-program-cache") {
+            programCache = false;
+        }
+        else if (arg == "--camera-path" && hasValue) {
+            cameraPath = argv[++i];
+        }
+        else if (arg == "--record-path" && hasValue) {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else {
+            cout << "Unknown or incomplete argument: " << arg << endl;
+            return false;
+        }
+    }
+    // checked once all arguments are in, the valid sizes depend on the filter: the blur chain only
+    // has the sizes of the UI (cascades always blur), the summed-area table takes any box size
+    const int blurKernels[] = { 7, 15, 23, 35, 63, 127 };
+    if (shadowFilter == 1 && cascades == 0) {
+        if (kernelSize < 1 || kernelSize > 127) {
+            cout << "Unknown kernel size for the summed-area table: " << kernelSize << " (1-127)" << endl;
+            return false;
+        }
+    }
+    else if (std::find(blurKernels, blurKernels + sizeof(blurKernels) / sizeof(blurKernels[0]), kernelSize) == blurKernels + sizeof(blurKernels) / sizeof(blurKernels[0])) {
+        cout << "Unknown blur kernel size: " << kernelSize << " (7, 15, 23, 35, 63 or 127)" << endl;
+        return false;
+    }
+    return true;
+}
+
+void BenchmarkSettings::printUsage(const char* program)
+{
+    cout << "Usage: " << program << " [options]\n"
+        << "  --headless                 render offscreen and run the benchmark\n"
+        << "  --context native|egl|osmesa context creation API (headless only)\n"
+        << "  --cpu-msm-bench            check and time the CPU 4MSM evaluator, no rendering\n"
+        << "  --cpu-blur-bench           check and time the CPU moment box filter, no rendering\n"
+        << "  --mesh-bench [FILE.obj]    text OBJ import vs the mapped binary mesh cache, no rendering\n"
+        << "  --frames N                 number of measured frames (default 600)\n"
+        << "  --warmup N                 frames rendered before measuring (default 30)\n"
+        << "  --shadow-method 0|1        0 - Standard, 1 - Moment Shadow Map\n"
+        << "  --kernel 7|15|23|35|63|127 MSM blur kernel size (1-127 with the SAT filter)\n"
+        << "  --blur-backend 0|1         0 - Sliding window, 1 - Tiled (shared memory)\n"
+        << "  --filter 0|1               0 - Box blur chain, 1 - Summed-area table\n"
+        << "  --moment-storage 32|16     bits per moment, 16 uses the optimized quantization\n"
+        << "  --gbuffer 0|1              0 - full (position + normal), 1 - compact (depth reconstruction)\n"
+        << "  --cascades 0-4             cascaded shadow maps, 0 keeps the single map\n"
+        << "  --point-shadows 0-8        point lights casting moment shadows\n"
+        << "  --lighting 0|1             0 - Fragment + light volumes, 1 - Tiled compute\n"
+        << "  --point-lights N           number of point lights (default 100, up to 131072)\n"
+        << "  --light-update 0|1         0 - CPU generation + upload, 1 - GPU compute\n"
+        << "  --objects N                copies of the model on the floor grid (default 1, up to 16384)\n"
+        << "  --draw-path 0|1            0 - one draw per object, 1 - one multi-draw indirect per pass\n"
+        << "  --culling 0|1              GPU frustum culling of the multi-draw commands (default 1)\n"
+        << "  --animate-lights           animate the point lights every frame\n"
+        << "  --shadow-cache             bake the shadow map of a static light once and reuse it\n"
+        << "  --force-shadow-rebuild     render the shadow map every frame, even when nothing changed\n"
+        << "  --no-program-cache         compile every shader program instead of loading cached binaries\n"
+        << "  --camera-path FILE         replay a recorded camera/light path\n"
+        << "  --record-path FILE         record the camera/light path (interactive)\n"
+        << "  --output FILE              per-frame timings, .csv or .json\n";
+}
+
+static void writeKey(std::ostream& out, const CameraKey& key)
+{
+    out << key.eye.x << " " << key.eye.y << " " << key.eye.z << " "
+        << key.center.x << " " << key.center.y << " " << key.center.z << " "
+        << key.up.x << " " << key.up.y << " " << key.up.z;
+}
+
+static bool readKey(std::istream& in, CameraKey& key)
+{
+    in >> key.eye.x >> key.eye.y >> key.eye.z
+        >> key.center.x >> key.center.y >> key.center.z
+        >> key.up.x >> key.up.y >> key.up.z;
+    return !in.fail();
+}
+
+bool CameraPath::load(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+    {
+        cout << "Failed to open camera path: " << fileName << endl;
+        return false;
+    }
+
+    frames.clear();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream lineStream(line);
+        PathFrame frame;
+        if (!readKey(lineStream, frame.camera) || !readKey(lineStream, frame.light))
+        {
+            cout << "Malformed camera path line: " << line << endl;
+            return false;
+        }
+        frames.push_back(frame);
+    }
+    return !frames.empty();
+}
+
+bool CameraPath::save(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        cout << "Failed to write camera path: " << fileName << endl;
+        return false;
+    }
+
+    file << "# camera eye/center/up, light eye/center/up\n";
+    for (const PathFrame& frame : frames)
+    {
+        writeKey(file, frame.camera);
+        file << " ";
+        writeKey(file, frame.light);
+        file << "\n";
+    }
+    return true;
+}
+
+void CameraPath::generateOrbit(const PathFrame& start, int frameCount)
+{
+    frames.clear();
+    glm::vec3 offset = start.camera.eye - start.camera.center;
+    for (int i = 0; i < frameCount; i++)
+    {
+        float angle = 2.0f * glm::pi<float>() * float(i) / float(frameCount);
+        float c = cos(angle);
+        float s = sin(angle);
+        PathFrame frame = start;
+        frame.camera.eye = start.camera.center + glm::vec3(c * offset.x + s * offset.z, offset.y, -s * offset.x + c * offset.z);
+        frame.camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+        frames.push_back(frame);
+    }
+}
+
+void BenchmarkLog::addFrame(double cpuMs)
+{
+    FrameSample sample;
+    sample.cpuMs = cpuMs;
+    sample.gpuMs = -1.0;
+    samples.push_back(sample);
+}
+
+void BenchmarkLog::setGpuTime(int frameIndex, double gpuMs)
+{
+    if (frameIndex >= 0 && frameIndex < int(samples.size())) {
+        samples[frameIndex].gpuMs = gpuMs;
+    }
+}
+
+void BenchmarkLog::setPassTimes(int frameIndex, const std::vector<std::string>& names, const std::vector<double>& times)
+{
+    if (frameIndex < 0 || frameIndex >= int(samples.size())) {
+        return;
+    }
+
+    FrameSample& sample = samples[frameIndex];
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        // passes become columns in the order they are first reported
+        size_t column = std::find(passNames.begin(), passNames.end(), names[i]) - passNames.begin();
+        if (column == passNames.size()) {
+            passNames.push_back(names[i]);
+        }
+        if (sample.passMs.size() <= column) {
+            sample.passMs.resize(column + 1, -1.0);
+        }
+        sample.passMs[column] = times[i];
+    }
+}
+
+static double passTime(const std::vector<double>& passMs, size_t column)
+{
+    return column < passMs.size() ? passMs[column] : -1.0;
+}
+
+static bool endsWith(const std::string& value, const std::string& suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool BenchmarkLog::write(const std::string& fileName, const BenchmarkSettings& settings) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        cout << "Failed to write benchmark results: " << fileName << endl;
+        return false;
+    }
+
+    if (endsWith(fileName, ".json"))
+    {
+        file << "{\n";
+        file << "  \"settings\": { \"shadowMethod\": " << settings.shadowMethod
+            << ", \"kernelSize\": " << settings.kernelSize
+            << ", \"blurBackend\": " << settings.blurBackend
+            << ", \"shadowFilter\": " << settings.shadowFilter
+            << ", \"momentBits\": " << settings.momentBits
+            << ", \"gBufferLayout\": " << settings.gBufferLayout
+            << ", \"cascades\": " << settings.cascades
+            << ", \"pointShadows\": " << settings.pointShadows
+            << ", \"lightingPath\": " << settings.lightingPath
+            << ", \"pointLights\": " << settings.pointLights
+            << ", \"lightUpdate\": " << settings.lightUpdate
+            << ", \"sceneObjects\": " << settings.sceneObjects
+            << ", \"drawPath\": " << settings.drawPath
+            << ", \"culling\": " << settings.culling
+            << ", \"animateLights\": " << (settings.animateLights ? "true" : "false")
+            << ", \"shadowCache\": " << (settings.shadowCache ? "true" : "false")
+            << ", \"forceShadowRebuild\": " << (settings.forceShadowRebuild ? "true" : "false")
+            << ", \"frames\": " << settings.frames
+            << ", \"warmupFrames\": " << settings.warmupFrames
+            << ", \"context\": \"" << settings.contextApi << "\" },\n";
+        file << "  \"frames\": [\n";
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            file << "    { \"frame\": " << i << ", \"cpuMs\": " << samples[i].cpuMs << ", \"gpuMs\": " << samples[i].gpuMs << ", \"passes\": {";
+            for (size_t p = 0; p < passNames.size(); p++)
+            {
+                file << (p > 0 ? ", " : " ") << "\"" << passNames[p] << "\": " << passTime(samples[i].passMs, p);
+            }
+            file << " } }";
+            file << (i + 1 < samples.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+    }
+    else
+    {
+        file << "frame,cpu_ms,gpu_ms";
+        for (size_t p = 0; p < passNames.size(); p++)
+        {
+            file << "," << passNames[p];
+        }
+        file << "\n";
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            file << i << "," << samples[i].cpuMs << "," << samples[i].gpuMs;
+            for (size_t p = 0; p < passNames.size(); p++)
+            {
+                file << "," << passTime(samples[i].passMs, p);
+            }
+            file << "\n";
+        }
+    }
+    return true;
+}
+
+void BenchmarkLog::printSummary() const
+{
+    if (samples.empty()) {
+        return;
+    }
+
+    double cpuSum = 0.0, gpuSum = 0.0;
+    double cpuMin = samples[0].cpuMs, cpuMax = samples[0].cpuMs;
+    double gpuMin = 1e30, gpuMax = 0.0;
+    int gpuCount = 0;
+    for (const FrameSample& sample : samples)
+    {
+        cpuSum += sample.cpuMs;
+        cpuMin = std::min(cpuMin, sample.cpuMs);
+        cpuMax = std::max(cpuMax, sample.cpuMs);
+        if (sample.gpuMs >= 0.0)
+        {
+            gpuSum += sample.gpuMs;
+            gpuMin = std::min(gpuMin, sample.gpuMs);
+            gpuMax = std::max(gpuMax, sample.gpuMs);
+            gpuCount++;
+        }
+    }
+
+    cout << "Frames: " << samples.size() << endl;
+    cout << "CPU ms/frame avg " << cpuSum / samples.size() << " min " << cpuMin << " max " << cpuMax << endl;
+    if (gpuCount > 0) {
+        cout << "GPU ms/frame avg " << gpuSum / gpuCount << " min " << gpuMin << " max " << gpuMax << endl;
+    }
+    for (size_t p = 0; p < passNames.size(); p++)
+    {
+        double passSum = 0.0;
+        int passCount = 0;
+        for (const FrameSample& sample : samples)
+        {
+            double ms = passTime(sample.passMs, p);
+            if (ms >= 0.0)
+            {
+                passSum += ms;
+                passCount++;
+            }
+        }
+        if (passCount > 0) {
+            cout << "  " << passNames[p] << ": " << passSum / passCount << " ms" << endl;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Command line driven settings for the headless benchmark / path recording
+struct BenchmarkSettings
+{
+    BenchmarkSettings();
+    // parse settings from the command line, returns false on malformed arguments
+    bool parse(int argc, char** argv);
+    // print the supported command line options
+    static void printUsage(const char* program);
+
+    bool headless;            // render offscreen with a hidden window and no UI
+    bool cpuMomentBenchmark;  // check and time the CPU 4MSM evaluator instead of rendering
+    bool cpuFilterBenchmark;  // check and time the CPU moment box filter instead of rendering
+    bool meshBenchmark;       // check and time the binary mesh cache instead of rendering
+    std::string meshBenchmarkPath; // OBJ loaded by the mesh benchmark, a generated one when empty
+    std::string contextApi;   // "native", "egl" or "osmesa"
+    int frames;               // number of frames to measure
+    int warmupFrames;         // frames rendered before measurement starts
+    int shadowMethod;         // 0 - Standard, 1 - MSM
+    int kernelSize;           // blur kernel size, must be one of computeShaderKernel[]
+    int blurBackend;          // 0 - Sliding window, 1 - Tiled (shared memory)
+    int shadowFilter;         // 0 - Box blur chain, 1 - Summed-area table (any kernel size)
+    int momentBits;           // 32 - RGBA32F moments, 16 - RGBA16 optimized moments
+    int gBufferLayout;        // 0 - full (RGB16F position + normal), 1 - compact (depth + octahedral normal)
+    int cascades;             // 0 - single shadow map, 1-4 - cascaded shadow maps
+    int pointShadows;         // number of point lights casting moment shadows (0-8)
+    int lightingPath;         // 0 - fragment quad + light volumes, 1 - tiled compute
+    int pointLights;          // number of point lights in the scene
+    int lightUpdate;          // 0 - CPU generation + upload, 1 - GPU compute
+    int sceneObjects;         // copies of the model on the floor grid
+    int drawPath;             // 0 - one draw per object, 1 - one multi-draw indirect per pass
+    int culling;              // 0 - draw every object, 1 - GPU frustum culling of the multi-draw commands
+    bool animateLights;       // animate the point lights every frame
+    bool shadowCache;         // bake the shadow maps of a static light to disk and reuse them
+    bool forceShadowRebuild;  // render and filter the shadow map every frame, even when nothing changed
+    bool programCache;        // link the shader programs from binaries of earlier runs when possible
+    std::string cameraPath;   // path file to replay, an orbit is generated when empty
+    std::string recordPath;   // path file to record into while running interactively
+    std::string outputPath;   // .csv or .json per-frame timings
+};
+
+// camera placement for a single frame
+struct CameraKey
+{
+    glm::vec3 eye;
+    glm::vec3 center;
+    glm::vec3 up;
+};
+
+// per-frame camera and global light placement
+struct PathFrame
+{
+    CameraKey camera;
+    CameraKey light;
+};
+
+// Recorded camera/light path: one frame per line of plain text
+// (camera eye, center, up followed by light eye, center, up)
+class CameraPath
+{
+public:
+    bool load(const std::string& fileName);
+    bool save(const std::string& fileName) const;
+    void append(const PathFrame& frame) { frames.push_back(frame); }
+    // generate a full orbit of the camera around its center while the light stays put
+    void generateOrbit(const PathFrame& start, int frameCount);
+    // frame lookup wraps around so a short path can drive a long benchmark
+    const PathFrame& frame(int index) const { return frames[index % frames.size()]; }
+    bool empty() const { return frames.empty(); }
+    int size() const { return int(frames.size()); }
+
+private:
+    std::vector<PathFrame> frames;
+};
+
+// Per-frame CPU/GPU timing log written out as CSV or JSON
+class BenchmarkLog
+{
+public:
+    // add a new frame sample, GPU time is filled in once its query resolves
+    void addFrame(double cpuMs);
+    // set the GPU time of an already added frame
+    void setGpuTime(int frameIndex, double gpuMs);
+    // set the per-pass GPU times of an already added frame
+    void setPassTimes(int frameIndex, const std::vector<std::string>& names, const std::vector<double>& times);
+    int frameCount() const { return int(samples.size()); }
+    // writes JSON when the file name ends with ".json", CSV otherwise
+    bool write(const std::string& fileName, const BenchmarkSettings& settings) const;
+    // print average/min/max summary to stdout
+    void printSummary() const;
+
+private:
+    struct FrameSample
+    {
+        double cpuMs;
+        double gpuMs;
+        std::vector<double> passMs; // indexed like passNames, -1 when unknown
+    };
+    std::vector<FrameSample> samples;
+    std::vector<std::string> passNames;
+};
+
+
+#endif
@@ -0,0 +1,139 @@
+#include "cascades.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+ShadowCascades::ShadowCascades(int size, GLenum format, const float borderColor[4])
+    :
+    size(size),
+    format(format),
+    count(MAX_CASCADES),
+    splitLambda(0.75f),
+    casterMargin(10.0f),
+    tex_id(0)
+{
+    for (int i = 0; i < 4; i++) {
+        border[i] = borderColor[i];
+    }
+    for (int i = 0; i < MAX_CASCADES; i++)
+    {
+        matrices[i] = glm::mat4(1.0f);
+        splits[i] = 0.0f;
+    }
+}
+
+ShadowCascades::~ShadowCascades()
+{
+    if (tex_id != 0) {
+        glDeleteTextures(1, &tex_id);
+    }
+}
+
+void ShadowCascades::allocate()
+{
+    if (tex_id != 0) {
+        return;
+    }
+
+    // memory is fixed: all layers are allocated up front no matter how many are in use
+    glGenTextures(1, &tex_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex_id);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, size, size, MAX_CASCADES);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Remove artefacts on the edges of the shadowmap
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void ShadowCascades::setCount(int count_)
+{
+    count = std::max(1, std::min(count_, int(MAX_CASCADES)));
+}
+
+void ShadowCascades::update(const glm::mat4& cameraView, float fovy, float aspect, float zNear, float shadowDistance, const glm::vec3& lightDir)
+{
+    // practical split scheme: blend of logarithmic and uniform splits
+    for (int i = 0; i < count; i++)
+    {
+        float p = float(i + 1) / float(count);
+        float logSplit = zNear * pow(shadowDistance / zNear, p);
+        float uniformSplit = zNear + (shadowDistance - zNear) * p;
+        splits[i] = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+    }
+
+    glm::mat4 inverseView = glm::inverse(cameraView);
+    float tanHalfY = tan(fovy * 0.5f);
+    float tanHalfX = tanHalfY * aspect;
+    // avoid a degenerate basis when the light looks straight down
+    glm::vec3 up = fabs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+    for (int i = 0; i < count; i++)
+    {
+        float sliceNear = i == 0 ? zNear : splits[i - 1];
+        float sliceFar = splits[i];
+
+        // corners of the frustum slice in world space
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int c = 0; c < 8; c++)
+        {
+            float depth = (c & 4) ? sliceFar : sliceNear;
+            float x = ((c & 1) ? 1.0f : -1.0f) * tanHalfX * depth;
+            float y = ((c & 2) ? 1.0f : -1.0f) * tanHalfY * depth;
+            corners[c] = glm::vec3(inverseView * glm::vec4(x, y, -depth, 1.0f));
+            center += corners[c];
+        }
+        center /= 8.0f;
+
+        // a bounding sphere keeps the cascade size constant under camera rotation
+        float radius = 0.0f;
+        for (int c = 0; c < 8; c++) {
+            radius = std::max(radius, glm::length(corners[c] - center));
+        }
+        radius = ceil(radius * 16.0f) / 16.0f;
+
+        float depthRange = 2.0f * radius + casterMargin;
+        glm::vec3 eye = center - lightDir * (radius + casterMargin);
+        glm::mat4 lightView = glm::lookAt(eye, center, up);
+        glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, depthRange);
+
+        // snap the projection to whole texels so the shadow edges stay put while the camera moves
+        glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        float halfSize = float(size) * 0.5f;
+        glm::vec2 texelOrigin = glm::vec2(origin) * halfSize;
+        glm::vec2 offset = (glm::vec2(round(texelOrigin.x), round(texelOrigin.y)) - texelOrigin) / halfSize;
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        matrices[i] = lightProjection * lightView;
+    }
+}
+
+void ShadowCascades::bindImage(unsigned unit, int cascade, GLenum access)
+{
+    // a single layer of the array is seen as a plain image2D by the blur shaders
+    glBindImageTexture(unit, tex_id, 0, GL_FALSE, cascade, access, format);
+}
+
+void ShadowCascades::bindTex()
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex_id);
+}
+
+void ShadowCascades::copyFrom(GLuint texture, int cascade)
+{
+    glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+                       tex_id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade,
+                       size, size, 1);
+}
+
+double ShadowCascades::sizeInBytes() const
+{
+    double texelBytes = (format == GL_RGBA16) ? 8.0 : 16.0;
+    return double(size) * double(size) * texelBytes * MAX_CASCADES;
+}
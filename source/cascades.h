@@ -0,0 +1,58 @@
+#ifndef _CASCADES_H_
+#define _CASCADES_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+// Cascaded shadow maps for the global (directional) light.
+// The camera frustum is cut into slices along the view direction and every slice gets
+// its own orthographic light projection, stored as one layer of a 2D texture array.
+// Each cascade is fitted to the bounding sphere of its slice and snapped to whole shadow
+// map texels, so the shadows don't shimmer while the camera rotates or moves.
+class ShadowCascades
+{
+public:
+    static const int MAX_CASCADES = 4;
+
+    ShadowCascades(int size, GLenum format, const float borderColor[4]);
+    ~ShadowCascades();
+    // Create the texture array (done on first use, nothing is allocated while cascades are off)
+    void allocate();
+    // Fit the cascades to the camera frustum between zNear and shadowDistance
+    void update(const glm::mat4& cameraView, float fovy, float aspect, float zNear, float shadowDistance, const glm::vec3& lightDir);
+    // Bind a single cascade layer as an image for compute writes
+    void bindImage(unsigned unit, int cascade, GLenum access = GL_WRITE_ONLY);
+    // Bind the whole texture array for sampling in the lighting pass
+    void bindTex();
+    // Copy a 2D texture of the cascade size into a cascade layer
+    void copyFrom(GLuint texture, int cascade);
+
+    // number of cascades in use (1 - MAX_CASCADES)
+    void setCount(int count_);
+    int getCount() const { return count; }
+    // blend between logarithmic (1) and uniform (0) split distribution
+    void setSplitLambda(float lambda) { splitLambda = lambda; }
+    // extra depth in front of each cascade so casters outside the view still throw shadows
+    void setCasterMargin(float margin) { casterMargin = margin; }
+    const glm::mat4& getMatrix(int cascade) const { return matrices[cascade]; }
+    const glm::mat4* getMatrices() const { return matrices; }
+    // view depth at which each cascade ends
+    const float* getSplits() const { return splits; }
+    // memory used by the texture array
+    double sizeInBytes() const;
+
+private:
+    int size;                           // width and height of every cascade
+    GLenum format;                      // moment storage format
+    float border[4];                    // moments of the far plane
+    int count;                          // cascades in use
+    float splitLambda;
+    float casterMargin;
+    GLuint tex_id;                      // GL_TEXTURE_2D_ARRAY, 0 until allocated
+    glm::mat4 matrices[MAX_CASCADES];   // world to light clip space per cascade
+    float splits[MAX_CASCADES];         // far view depth per cascade
+
+};
+
+
+#endif
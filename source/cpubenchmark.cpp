@@ -0,0 +1,604 @@
+#include "cpubenchmark.h"
+#include "momentevaluator.h"
+#include "momentfilter.h"
+#include "meshcache.h"
+#include "meshsimplify.h"
+#include "objloader.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+// moments of a single depth
+static glm::vec4 depthMoments(float depth)
+{
+    float squared = depth * depth;
+    return glm::vec4(depth, squared, depth * squared, squared * squared);
+}
+
+// filtered moments of up to 3 depths, the kind of data the blurred shadow map holds
+static void generateFilteredCases(std::mt19937& rng, size_t count, std::vector<glm::vec4>& moments, std::vector<float>& depths)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < count; i++)
+    {
+        int layers = 1 + int(rng() % 3);
+        glm::vec4 sum(0.0f);
+        float weightSum = 0.0f;
+        for (int layer = 0; layer < layers; layer++)
+        {
+            float weight = unit(rng) + 0.01f;
+            sum += weight * depthMoments(unit(rng));
+            weightSum += weight;
+        }
+        moments.push_back(sum / weightSum);
+        depths.push_back(unit(rng));
+    }
+}
+
+// inputs that stress the numerics: a single depth (D22 is only the bias), receivers at the
+// occluder depth, and arbitrary vectors that aren't valid moments (negative discriminant)
+static void generateDegenerateCases(std::mt19937& rng, size_t count, std::vector<glm::vec4>& moments, std::vector<float>& depths)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < count; i++)
+    {
+        float depth = unit(rng);
+        switch (i % 4)
+        {
+        case 0:
+            moments.push_back(depthMoments(depth));
+            depths.push_back(unit(rng));
+            break;
+        case 1:
+            moments.push_back(depthMoments(depth));
+            depths.push_back(depth);
+            break;
+        case 2:
+            moments.push_back(0.5f * (depthMoments(depth) + depthMoments(std::nextafter(depth, 1.0f))));
+            depths.push_back(unit(rng));
+            break;
+        default:
+            moments.push_back(glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng)));
+            depths.push_back(depth);
+            break;
+        }
+    }
+}
+
+// compare every SIMD kernel with the scalar reference, returns false on any difference
+static bool checkKernels(const char* caseName, const std::vector<glm::vec4>& moments, const std::vector<float>& depths, float momentBias)
+{
+    MomentEvaluator reference(0.0f, momentBias);
+    reference.setKernel(MomentEvaluator::SCALAR);
+    std::vector<float> expected(moments.size());
+    reference.evaluate(&moments[0], &depths[0], &expected[0], moments.size());
+
+    bool agree = true;
+    for (int kernel = MomentEvaluator::SSE; kernel <= MomentEvaluator::AVX2; kernel++)
+    {
+        if (!MomentEvaluator::isSupported(MomentEvaluator::Kernel(kernel))) {
+            continue;
+        }
+        MomentEvaluator evaluator(0.0f, momentBias);
+        evaluator.setKernel(MomentEvaluator::Kernel(kernel));
+        std::vector<float> result(moments.size());
+        evaluator.evaluate(&moments[0], &depths[0], &result[0], moments.size());
+
+        size_t mismatches = 0;
+        float maxError = 0.0f;
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            if (std::memcmp(&result[i], &expected[i], sizeof(float)) != 0) {
+                mismatches++;
+                maxError = std::max(maxError, std::fabs(result[i] - expected[i]));
+            }
+        }
+        cout << "  " << caseName << " (moment bias " << momentBias << "), " << MomentEvaluator::kernelName(MomentEvaluator::Kernel(kernel))
+            << ": " << mismatches << " of " << result.size() << " differ from scalar";
+        if (mismatches > 0) {
+            cout << ", max error " << maxError;
+        }
+        cout << endl;
+        agree = agree && mismatches == 0;
+    }
+    return agree;
+}
+
+// GL_RGBA16 round trip of a vector in [0, 1]
+static glm::vec4 quantize16(const glm::vec4& value)
+{
+    glm::vec4 result;
+    for (int i = 0; i < 4; i++) {
+        result[i] = std::floor(std::min(std::max(value[i], 0.0f), 1.0f) * 65535.0f + 0.5f) / 65535.0f;
+    }
+    return result;
+}
+
+// column major like the GLSL mat4 constructor
+static glm::vec4 transformMoments(const float (&matrix)[16], const glm::vec4& moments)
+{
+    glm::vec4 result(0.0f);
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            result[row] += matrix[column * 4 + row] * moments[column];
+        }
+    }
+    return result;
+}
+
+// the rotation into the 16 bit basis of momentShadowMap.glsl and its inverse in
+// convertOptimizedMoments() of deferredShading.glsl (Peters & Klein 2015)
+static glm::vec4 optimizeMoments(const glm::vec4& moments)
+{
+    static const float toOptimized[16] = {
+        -2.07224649f, 13.7948857237f, 0.105877704f, 9.7924062118f,
+        32.23703778f, -59.4683975703f, -1.9077466311f, -33.7652110555f,
+        -68.571074599f, 82.0359750338f, 9.3496555107f, 47.9456096605f,
+        39.3703274134f, -35.364903257f, -6.6543490743f, -23.9728048165f };
+    glm::vec4 result = transformMoments(toOptimized, moments);
+    result[0] += 0.035955884801f;
+    return result;
+}
+
+static glm::vec4 canonicalMoments(glm::vec4 optimized)
+{
+    static const float toCanonical[16] = {
+        0.2227744146f, 0.1549679261f, 0.1451988946f, 0.163127443f,
+        0.0771972861f, 0.1394629426f, 0.2120202157f, 0.2591432266f,
+        0.7926986636f, 0.7963415838f, 0.7258694464f, 0.6539092497f,
+        0.0319417555f, -0.1722823173f, -0.2758014811f, -0.3376131734f };
+    optimized[0] -= 0.035955884801f;
+    return transformMoments(toCanonical, optimized);
+}
+
+// print the mean, 99th and 99.9th percentile of the absolute shadow differences, returns the mean
+static double printErrorStats(const char* name, std::vector<float>& errors)
+{
+    double sum = 0.0;
+    for (float error : errors) {
+        sum += error;
+    }
+    std::sort(errors.begin(), errors.end());
+    cout << "  " << name << ": mean " << sum / errors.size() << ", 99th percentile " << errors[errors.size() * 99 / 100]
+        << ", 99.9th percentile " << errors[errors.size() * 999 / 1000] << endl;
+    return sum / errors.size();
+}
+
+// shadow intensity of 16 bit moments against 32 bit ones on two-depth mixtures (an occluder
+// edge under the filter), canonical and optimized basis; the optimized one has to be the closer
+static bool check16BitStorage(std::mt19937& rng, size_t count, float momentBias)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> canonicalErrors, optimizedErrors;
+    canonicalErrors.reserve(count);
+    optimizedErrors.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float weight = unit(rng);
+        glm::vec4 moments = weight * depthMoments(unit(rng)) + (1.0f - weight) * depthMoments(unit(rng));
+        float depth = unit(rng);
+        float reference = MomentEvaluator::evaluate(moments, depth, 0.0f, momentBias);
+        float canonical = MomentEvaluator::evaluate(quantize16(moments), depth, 0.0f, momentBias);
+        float optimized = MomentEvaluator::evaluate(canonicalMoments(quantize16(optimizeMoments(moments))), depth, 0.0f, momentBias);
+        canonicalErrors.push_back(std::fabs(canonical - reference));
+        optimizedErrors.push_back(std::fabs(optimized - reference));
+    }
+    cout << "16 bit moment storage against 32 bit (" << count << " two-depth mixtures, moment bias " << momentBias << "):" << endl;
+    double canonicalMean = printErrorStats("canonical moments", canonicalErrors);
+    double optimizedMean = printErrorStats("optimized moments", optimizedErrors);
+    return optimizedMean < canonicalMean;
+}
+
+int runMomentEvaluatorBenchmark()
+{
+    const size_t caseCount = 1 << 20;
+    std::mt19937 rng(1234);
+    std::vector<glm::vec4> filteredMoments, degenerateMoments;
+    std::vector<float> filteredDepths, degenerateDepths;
+    generateFilteredCases(rng, caseCount, filteredMoments, filteredDepths);
+    generateDegenerateCases(rng, caseCount, degenerateMoments, degenerateDepths);
+
+    cout << "4MSM evaluator, best kernel: " << MomentEvaluator::kernelName(MomentEvaluator::bestKernel()) << endl;
+    cout << "Agreement with the scalar reference:" << endl;
+    bool agree = checkKernels("filtered mixtures", filteredMoments, filteredDepths, 0.0003f);
+    agree = checkKernels("degenerate inputs", degenerateMoments, degenerateDepths, 0.0003f) && agree;
+    agree = checkKernels("degenerate inputs", degenerateMoments, degenerateDepths, 0.0f) && agree;
+    agree = check16BitStorage(rng, 1 << 18, 0.0003f) && agree;
+
+    // throughput on one thread, the batch is reused until enough time has passed
+    cout << "Throughput (single core):" << endl;
+    std::vector<float> result(caseCount);
+    for (int kernel = MomentEvaluator::SCALAR; kernel <= MomentEvaluator::AVX2; kernel++)
+    {
+        if (!MomentEvaluator::isSupported(MomentEvaluator::Kernel(kernel))) {
+            continue;
+        }
+        MomentEvaluator evaluator;
+        evaluator.setKernel(MomentEvaluator::Kernel(kernel));
+        size_t evaluations = 0;
+        double seconds = 0.0;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (seconds < 0.5)
+        {
+            evaluator.evaluate(&filteredMoments[0], &filteredDepths[0], &result[0], caseCount);
+            evaluations += caseCount;
+            seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        cout << "  " << MomentEvaluator::kernelName(MomentEvaluator::Kernel(kernel)) << ": "
+            << evaluations / seconds / 1.0e6 << " M evaluations/s" << endl;
+    }
+    return agree ? 0 : 1;
+}
+
+// same sizes as computeShaderKernel[] in MomentShadows.cpp
+static const int blurKernelSizes[] = { 7, 15, 23, 35, 63, 127 };
+
+// shadow map like moments: depth steps between a few occluders plus some noise
+static void generateShadowMap(std::mt19937& rng, int width, int height, std::vector<glm::vec4>& moments)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    moments.resize(size_t(width) * height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float depth = ((x / 37 + y / 23) % 3) * 0.3f + 0.05f * unit(rng);
+            moments[size_t(y) * width + x] = depthMoments(depth);
+        }
+    }
+}
+
+// blur a copy with the reference and with the filter for every kernel size, returns false on any difference
+static bool checkFilter(MomentFilter& filter, int width, int height)
+{
+    std::mt19937 rng(width * 31 + height);
+    std::vector<glm::vec4> source;
+    generateShadowMap(rng, width, height, source);
+
+    bool agree = true;
+    for (int kernelSize : blurKernelSizes)
+    {
+        std::vector<glm::vec4> expected = source;
+        MomentFilter::blurReference(&expected[0], width, height, kernelSize);
+        std::vector<glm::vec4> result = source;
+        filter.blur(&result[0], width, height, kernelSize);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            if (std::memcmp(&result[i], &expected[i], sizeof(glm::vec4)) != 0) {
+                mismatches++;
+            }
+        }
+        cout << "  " << width << "x" << height << ", kernel " << kernelSize << ": "
+            << mismatches << " of " << result.size() << " texels differ from the reference" << endl;
+        agree = agree && mismatches == 0;
+    }
+    return agree;
+}
+
+// average milliseconds of a blur over at least a second
+template <typename Blur>
+static double timeBlur(std::vector<glm::vec4>& moments, Blur blur)
+{
+    int runs = 0;
+    double seconds = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    while (seconds < 1.0 || runs < 2)
+    {
+        blur(&moments[0]);
+        runs++;
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return seconds * 1000.0 / runs;
+}
+
+int runMomentFilterBenchmark()
+{
+    MomentFilter filter;
+    cout << "Moment box filter, " << filter.getThreadCount() << " threads" << endl;
+    cout << "Agreement with the scalar reference:" << endl;
+    bool agree = checkFilter(filter, 256, 192);
+    // smaller than the widest kernels, the windows reach past both borders
+    agree = checkFilter(filter, 40, 30) && agree;
+
+    const int blurKernelSize = 35;
+    cout << "Blur time (" << blurKernelSize << "x" << blurKernelSize << " kernel):" << endl;
+    const int mapSizes[] = { 2048, 4096 };
+    for (int size : mapSizes)
+    {
+        std::mt19937 rng(size);
+        std::vector<glm::vec4> moments;
+        generateShadowMap(rng, size, size, moments);
+        double texels = double(size) * size;
+
+        double filterMs = timeBlur(moments, [&](glm::vec4* image) { filter.blur(image, size, size, blurKernelSize); });
+        cout << "  " << size << "x" << size << ": " << filterMs << " ms, " << texels / filterMs / 1.0e3 << " M texels/s";
+        if (size == 2048)
+        {
+            double referenceMs = timeBlur(moments, [&](glm::vec4* image) { MomentFilter::blurReference(image, size, size, blurKernelSize); });
+            cout << " (scalar reference " << referenceMs << " ms, " << referenceMs / filterMs << "x)";
+        }
+        cout << endl;
+    }
+    return agree ? 0 : 1;
+}
+
+// torus of rings x segments quads with texcoords and normals, written like a scanned model export
+static bool writeTorusObj(const std::string& fileName, int rings, int segments)
+{
+    std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    const float pi = 3.14159265f;
+    const float majorRadius = 1.0f;
+    const float minorRadius = 0.35f;
+    char line[128];
+    file << "# generated by --mesh-bench\n";
+    for (int ring = 0; ring <= rings; ring++)
+    {
+        float u = float(ring) / rings;
+        for (int segment = 0; segment <= segments; segment++)
+        {
+            float v = float(segment) / segments;
+            glm::vec3 normal(std::cos(2.0f * pi * u) * std::cos(2.0f * pi * v), std::sin(2.0f * pi * v), std::sin(2.0f * pi * u) * std::cos(2.0f * pi * v));
+            glm::vec3 center(std::cos(2.0f * pi * u) * majorRadius, 0.0f, std::sin(2.0f * pi * u) * majorRadius);
+            glm::vec3 position = center + normal * minorRadius;
+            std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                position.x, position.y, position.z, u, v, normal.x, normal.y, normal.z);
+            file << line;
+        }
+    }
+    for (int ring = 0; ring < rings; ring++)
+    {
+        for (int segment = 0; segment < segments; segment++)
+        {
+            int a = ring * (segments + 1) + segment + 1;
+            int b = a + segments + 1;
+            std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, a + 1, a + 1, a + 1, b + 1, b + 1, b + 1, b, b, b);
+            file << line;
+        }
+    }
+    return bool(file);
+}
+
+template <typename Load>
+static double timeLoad(Load load)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    load();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// read every byte of the mesh the way the buffer upload does, so the mapping is really paged in
+static unsigned int touchMesh(const MeshCache& mesh)
+{
+    unsigned int sum = 0;
+    const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(mesh.getVertices());
+    for (size_t i = 0; i < mesh.getVertexCount() * sizeof(MeshVertex); i += 64) {
+        sum += vertexBytes[i];
+    }
+    for (size_t i = 0; i < mesh.getIndexCount(); i += 16) {
+        sum += mesh.getIndices()[i];
+    }
+    return sum;
+}
+
+// cached arrays identical to a fresh import (the full mesh, the levels after it come from buildShadowLods())
+static bool sameMesh(const MeshCache& mesh, const MeshData& parsed)
+{
+    return mesh.getVertexCount() == parsed.vertices.size() && mesh.getLodCount() > 0 && mesh.getLod(0).indexCount == parsed.indices.size() &&
+        std::memcmp(mesh.getVertices(), &parsed.vertices[0], parsed.vertices.size() * sizeof(MeshVertex)) == 0 &&
+        std::memcmp(mesh.getIndices(), &parsed.indices[0], parsed.indices.size() * sizeof(unsigned int)) == 0;
+}
+
+// every level a smaller, valid triangle list with a growing error
+static bool validLods(const MeshData& mesh)
+{
+    bool valid = !mesh.lods.empty();
+    for (size_t i = 0; i < mesh.lods.size() && valid; i++)
+    {
+        const MeshLod& lod = mesh.lods[i];
+        valid = lod.indexCount % 3 == 0 && size_t(lod.firstIndex) + lod.indexCount <= mesh.indices.size() &&
+            (i == 0 || (lod.indexCount < mesh.lods[i - 1].indexCount && lod.error >= mesh.lods[i - 1].error));
+        for (unsigned int j = lod.firstIndex; j < lod.firstIndex + lod.indexCount && valid; j++) {
+            valid = mesh.indices[j] < mesh.vertices.size();
+        }
+    }
+    return valid;
+}
+
+// bitwise equal imports
+static bool sameMeshData(const MeshData& a, const MeshData& b)
+{
+    return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+        std::memcmp(&a.boundsMin, &b.boundsMin, sizeof(glm::vec3)) == 0 && std::memcmp(&a.boundsMax, &b.boundsMax, sizeof(glm::vec3)) == 0 &&
+        (a.vertices.empty() || std::memcmp(&a.vertices[0], &b.vertices[0], a.vertices.size() * sizeof(MeshVertex)) == 0) &&
+        (a.indices.empty() || std::memcmp(&a.indices[0], &b.indices[0], a.indices.size() * sizeof(unsigned int)) == 0);
+}
+
+static std::string temporaryFileName(const char* name)
+{
+    const char* directory = std::getenv("TMPDIR");
+#ifdef _WIN32
+    directory = directory != NULL ? directory : std::getenv("TEMP");
+#endif
+    return std::string(directory != NULL ? directory : "/tmp") + "/" + name;
+}
+
+// numbers the fast float parser has to hand to strtof, relative indices, polygons, broken faces,
+// corners without normals; the parallel importer has to agree with loadObj() on all of them
+static bool checkImporterEdgeCases(ObjImporter& importer)
+{
+    std::string fileName = temporaryFileName("msm_mesh_edges.obj");
+    {
+        std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+        file << "# edge cases\n"
+            << "v 1.5e-3 -2.0E+2 .5\n"
+            << "  v 123456789.123 0.1234567891 -0\n"
+            << "v +1 1e-12 3.4028235e38\r\n"
+            << "v 0.000001 1e10 -7 1.0\n"
+            << "v 0x1p-3 16777217 -16777216\n"
+            << "vt 0.25 0.75\n"
+            << "vt 1\n"
+            << "vn 0 0 1\n"
+            << "o part\n"
+            << "f 1 2 3 4\n"
+            << "f -5/1 -4/2 -3/1 -2/2 -1/1\n"
+            << "f 1//1 2//1 3//1\r\n"
+            << "f 2/1/1 3/2/1\n"
+            << "f 1 2 99\n"
+            << "g group\n"
+            << "f\t1/1/1 2/2/1 5/1/1";
+    }
+    MeshData reference;
+    MeshData parallel;
+    bool referenceOk = loadObj(fileName, reference);
+    bool parallelOk = importer.load(fileName, parallel);
+    std::remove(fileName.c_str());
+    bool agree = referenceOk && parallelOk && sameMeshData(reference, parallel);
+    cout << "  edge cases: " << reference.vertices.size() << " vertices, " << reference.indices.size() / 3 << " triangles, "
+        << (agree ? "identical" : "different") << endl;
+    return agree;
+}
+
+static const char* sourceName(MeshCache::Source source)
+{
+    switch (source)
+    {
+    case MeshCache::MAPPED: return "mapped";
+    case MeshCache::REVALIDATED: return "revalidated";
+    case MeshCache::IMPORTED: return "imported";
+    default: return "failed";
+    }
+}
+
+int runMeshLoadBenchmark(const std::string& objFileName)
+{
+    std::string fileName = objFileName;
+    bool generated = fileName.empty();
+    if (generated)
+    {
+        fileName = temporaryFileName("msm_mesh_bench.obj");
+        const int rings = 1024;
+        const int segments = 1024;
+        cout << "Writing a " << 2 * rings * segments << " triangle torus to " << fileName << endl;
+        if (!writeTorusObj(fileName, rings, segments)) {
+            cout << "Failed to write " << fileName << endl;
+            return 1;
+        }
+    }
+    std::string cacheName = MeshCache::cacheFileName(fileName);
+    std::remove(cacheName.c_str());
+
+    MeshData parsed;
+    bool parsedOk = false;
+    double parseMs = timeLoad([&] { parsedOk = loadObj(fileName, parsed); });
+    if (!parsedOk) {
+        cout << "Failed to import " << fileName << endl;
+        return 1;
+    }
+    cout << "Mesh load of " << fileName << ": " << parsed.vertices.size() << " vertices, " << parsed.indices.size() / 3 << " triangles" << endl;
+    cout << "  text parse (reference): " << parseMs << " ms" << endl;
+
+    // the parallel importer on one thread, on every hardware thread, and oversubscribed so the
+    // corner map sees concurrent inserts even on a single core
+    ObjImporter importer;
+    bool agree = true;
+    const int threadCounts[] = { 1, importer.getThreadCount(), 8 };
+    for (int i = 0; i < 3; i++)
+    {
+        int threads = threadCounts[i];
+        if (i > 0 && threads <= threadCounts[i - 1]) {
+            continue;
+        }
+        ObjImporter counted(threads);
+        MeshData imported;
+        bool importedOk = false;
+        double importMs = timeLoad([&] { importedOk = counted.load(fileName, imported); });
+        bool same = importedOk && sameMeshData(parsed, imported);
+        cout << "  parallel import, " << threads << (threads == 1 ? " thread:  " : " threads: ") << importMs << " ms, "
+            << parseMs / importMs << "x, " << (same ? "identical" : "different") << endl;
+        agree = agree && same;
+    }
+    agree = checkImporterEdgeCases(importer) && agree;
+
+    // shadow caster levels, built once per import
+    MeshData simplified = parsed;
+    double simplifyMs = timeLoad([&] { buildShadowLods(simplified); });
+    bool lodsValid = validLods(simplified);
+    cout << "  shadow LODs:            " << simplifyMs << " ms," << (lodsValid ? "" : " invalid,");
+    for (size_t i = 0; i < simplified.lods.size(); i++) {
+        cout << (i > 0 ? ", " : " ") << simplified.lods[i].indexCount / 3 << " (" << simplified.lods[i].error << ")";
+    }
+    cout << " triangles (error)" << endl;
+    agree = agree && lodsValid;
+
+    MeshCache mesh;
+    double importMs = timeLoad([&] { mesh.open(fileName, &importer); });
+    agree = agree && mesh.getSource() == MeshCache::IMPORTED && sameMesh(mesh, parsed);
+    cout << "  import + cache write:   " << importMs << " ms (" << sourceName(mesh.getSource()) << ")" << endl;
+    unsigned long long geometryHash = mesh.getGeometryHash();
+    mesh.close();
+
+    // best of a few, the first one may still read the cache from disk
+    double mapMs = 0.0;
+    unsigned int checksum = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        double ms = timeLoad([&] { mesh.open(fileName); checksum += touchMesh(mesh); });
+        mapMs = run == 0 ? ms : std::min(mapMs, ms);
+        agree = agree && mesh.getSource() == MeshCache::MAPPED && mesh.getGeometryHash() == geometryHash && sameMesh(mesh, parsed);
+        mesh.close();
+    }
+    cout << "  mapped cache:           " << mapMs << " ms, " << parseMs / mapMs << "x faster than the text parse (checksum " << checksum << ")" << endl;
+
+    // same contents under a new time: hashed once, then mapped again
+    struct utimbuf times;
+    times.actime = std::time(NULL);
+    times.modtime = times.actime + 60;
+    if (utime(fileName.c_str(), &times) == 0)
+    {
+        double revalidateMs = timeLoad([&] { mesh.open(fileName); touchMesh(mesh); });
+        cout << "  touched OBJ:            " << revalidateMs << " ms (" << sourceName(mesh.getSource()) << ")" << endl;
+        agree = agree && mesh.getSource() == MeshCache::REVALIDATED && sameMesh(mesh, parsed);
+        mesh.close();
+        mesh.open(fileName);
+        agree = agree && mesh.getSource() == MeshCache::MAPPED;
+        mesh.close();
+    }
+    if (generated)
+    {
+        // an edit the geometry doesn't see still has to import it again
+        {
+            std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::app);
+            file << "# edited\n";
+        }
+        mesh.open(fileName, &importer);
+        cout << "  edited OBJ:             " << sourceName(mesh.getSource()) << endl;
+        agree = agree && mesh.getSource() == MeshCache::IMPORTED && mesh.getGeometryHash() == geometryHash;
+        mesh.close();
+        std::remove(fileName.c_str());
+        std::remove(cacheName.c_str());
+    }
+    cout << (agree ? "Cached mesh matches the import" : "Cached mesh differs from the import") << endl;
+    return agree ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#ifndef _CPU_BENCHMARK_H_
+#define _CPU_BENCHMARK_H_
+
+#include <string>
+
+// Benchmarks of the CPU-side shadow libraries, run from the command line without a GL context.
+// Each one first checks its kernels against the scalar reference, then measures them,
+// and returns the process exit code (non-zero when a kernel disagrees).
+
+// Hamburger 4MSM evaluator: bitwise agreement of the SIMD kernels on filtered moment mixtures
+// and degenerate inputs, the shadow error of 16 bit moment storage (canonical and optimized basis),
+// then evaluations per second on a single core
+int runMomentEvaluatorBenchmark();
+
+// moment box filter: bitwise agreement of the threaded SIMD filter with the scalar reference
+// for every blur kernel size, then milliseconds per blur of 2048^2 and 4096^2 shadow maps
+int runMomentFilterBenchmark();
+
+// OBJ import and binary mesh cache: the parallel importer has to give exactly the mesh of the
+// reference parser, the mapped cache has to hold it and be found stale or revalidated after edits;
+// milliseconds of the reference parse, the parallel import on 1..n threads and the mapped cache
+// for objFileName (a generated torus of 2M triangles when empty)
+int runMeshLoadBenchmark(const std::string& objFileName);
+
+
+#endif
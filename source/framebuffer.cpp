@@ -137,10 +137,30 @@ void FrameBuffer::attachTexture(GLenum iformat, GLint filter) throw(domain_error
         format = GL_RGBA;
         type = GL_FLOAT;
     }
+    else if (iformat == GL_RGBA16) {
+        // 16 bit unsigned normalized
+        format = GL_RGBA;
+        type = GL_UNSIGNED_SHORT;
+    }
+    else if (iformat == GL_RGBA32UI) {
+        // integer textures can't be filtered
+        format = GL_RGBA_INTEGER;
+        type = GL_UNSIGNED_INT;
+        filter = GL_NEAREST;
+    }
     else if (iformat == GL_RGB16F || iformat == GL_RGB32F) {
         format = GL_RGB;
         type = GL_FLOAT;
     }
+    else if (iformat == GL_RG16_SNORM) {
+        // 16 bit signed normalized pair (octahedral normals)
+        format = GL_RG;
+        type = GL_SHORT;
+    }
+    else if (iformat == GL_RG8) {
+        format = GL_RG;
+        type = GL_UNSIGNED_BYTE;
+    }
     else if (iformat == GL_LUMINANCE16_ALPHA16) {
         format = GL_LUMINANCE_ALPHA;
         type = GL_FLOAT;
@@ -226,7 +246,10 @@ void FrameBuffer::attachTexture(GLenum iformat, GLint filter) throw(domain_error
     }
 
     tex_ids.push_back(tex_id);
-    buffers[tex_ids.size() - 1] = attachment;
+    // depth/stencil textures keep their slot (fragment output locations still match the texture
+    // index) but are never a draw buffer
+    bool colorAttachment = attachment != GL_DEPTH_ATTACHMENT && attachment != GL_STENCIL_ATTACHMENT && attachment != GL_DEPTH_STENCIL_ATTACHMENT;
+    buffers[tex_ids.size() - 1] = colorAttachment ? attachment : GL_NONE;
 }
 
 void FrameBuffer::bindInput()
@@ -294,6 +317,7 @@ void FrameBuffer::bindImage(unsigned unit, int num, GLenum format, GLenum access
     // Supported Formats:
     // GL_RGBA32F
     // GL_RGBA16F
+    // GL_RGBA16
     // GL_RGBA8
     // GL_RGBA8UI
     // GL_RGBA32I
@@ -302,6 +326,15 @@ void FrameBuffer::bindImage(unsigned unit, int num, GLenum format, GLenum access
     glBindImageTexture(unit, tex_ids[num], 0, GL_FALSE, 0, access, format);
 }
 
+GLuint FrameBuffer::getTexture(int num) const throw(std::out_of_range)
+{
+    if (num + 1 > int(tex_ids.size()))
+    {
+        throw out_of_range("FrameBuffer::getTexture - texture vector size exceeded");
+    }
+    return tex_ids[num];
+}
+
 // Bind the FBO for reading using GL_READ_FRAMEBUFFER
 void FrameBuffer::bindRead()
 {
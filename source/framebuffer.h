@@ -33,6 +33,8 @@ public:
     void bindTex(int num = 0) throw(std::out_of_range);
     // Bind image texture for compute read/writing
     void bindImage(unsigned unit, int num, GLenum format, GLenum access = GL_READ_WRITE) throw(std::out_of_range);
+    // Get the GL id of the nth texture (for copies between textures)
+    GLuint getTexture(int num) const throw(std::out_of_range);
     // Bind the FBO for reading using GL_READ_FRAMEBUFFER
     void bindRead();
     // Bind the FBO for reading using GL_DRAW_FRAMEBUFFER
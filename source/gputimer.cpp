@@ -0,0 +1,193 @@
+#include "gputimer.h"
+
+#include <fstream>
+#include <iostream>
+
+GpuTimer::GpuTimer()
+    :
+    current(0),
+    elapsed_ms(0.0),
+    resolved(false)
+{
+    for (int i = 0; i < QUERY_BUFFERS; i++)
+    {
+        glGenQueries(2, queries[i]);
+        issued[i] = false;
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (int i = 0; i < QUERY_BUFFERS; i++)
+    {
+        glDeleteQueries(2, queries[i]);
+    }
+}
+
+void GpuTimer::begin()
+{
+    glQueryCounter(queries[current][0], GL_TIMESTAMP);
+}
+
+void GpuTimer::end()
+{
+    glQueryCounter(queries[current][1], GL_TIMESTAMP);
+    issued[current] = true;
+
+    // the other buffer holds last frame's queries which are (almost always) done by now
+    current = (current + 1) % QUERY_BUFFERS;
+    if (issued[current])
+    {
+        resolve(current);
+    }
+}
+
+void GpuTimer::flush()
+{
+    // the most recently issued pair lives in the buffer before the current one
+    int last = (current + QUERY_BUFFERS - 1) % QUERY_BUFFERS;
+    if (issued[last])
+    {
+        resolve(last);
+    }
+}
+
+void GpuTimer::resolve(int index)
+{
+    GLuint64 startTime = 0;
+    GLuint64 endTime = 0;
+    glGetQueryObjectui64v(queries[index][0], GL_QUERY_RESULT, &startTime);
+    glGetQueryObjectui64v(queries[index][1], GL_QUERY_RESULT, &endTime);
+    elapsed_ms = double(endTime - startTime) / 1000000.0;
+    issued[index] = false;
+    resolved = true;
+}
+
+GpuProfiler::GpuProfiler()
+    :
+    current(0),
+    active(-1)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        glDeleteQueries(QUERY_BUFFERS, passes[i].queries);
+    }
+}
+
+void GpuProfiler::beginPass(const char* name)
+{
+    int index = -1;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        if (names[i] == name)
+        {
+            index = int(i);
+            break;
+        }
+    }
+
+    if (index < 0)
+    {
+        // first time we see this pass: register it
+        PassQueries pass;
+        glGenQueries(QUERY_BUFFERS, pass.queries);
+        for (int i = 0; i < QUERY_BUFFERS; i++) {
+            pass.issued[i] = false;
+        }
+        names.push_back(name);
+        passes.push_back(pass);
+        times_ms.push_back(0.0);
+        smoothed_ms.push_back(0.0);
+        index = int(passes.size()) - 1;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, passes[index].queries[current]);
+    active = index;
+}
+
+void GpuProfiler::endPass()
+{
+    if (active < 0) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    passes[active].issued[current] = true;
+    active = -1;
+}
+
+void GpuProfiler::endFrame()
+{
+    current = (current + 1) % QUERY_BUFFERS;
+    resolve(current);
+}
+
+void GpuProfiler::flush()
+{
+    resolve((current + QUERY_BUFFERS - 1) % QUERY_BUFFERS);
+}
+
+void GpuProfiler::resolve(int buffer)
+{
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        PassQueries& pass = passes[i];
+        if (pass.issued[buffer])
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(pass.queries[buffer], GL_QUERY_RESULT, &elapsed);
+            times_ms[i] = double(elapsed) / 1000000.0;
+            pass.issued[buffer] = false;
+        }
+        else
+        {
+            // pass was skipped that frame
+            times_ms[i] = 0.0;
+        }
+        smoothed_ms[i] += (times_ms[i] - smoothed_ms[i]) * 0.05;
+    }
+}
+
+double GpuProfiler::totalMs() const
+{
+    double total = 0.0;
+    for (size_t i = 0; i < times_ms.size(); i++)
+    {
+        total += times_ms[i];
+    }
+    return total;
+}
+
+bool GpuProfiler::write(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to write GPU timings: " << fileName << std::endl;
+        return false;
+    }
+
+    bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+    if (json)
+    {
+        file << "{\n  \"passes\": [\n";
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            file << "    { \"name\": \"" << names[i] << "\", \"gpuMs\": " << smoothed_ms[i] << " }";
+            file << (i + 1 < names.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+    }
+    else
+    {
+        file << "pass,gpu_ms\n";
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            file << names[i] << "," << smoothed_ms[i] << "\n";
+        }
+    }
+    return true;
+}
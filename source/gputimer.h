@@ -0,0 +1,88 @@
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <string>
+#include <vector>
+
+// GPU timer built on a pair of GL_TIMESTAMP queries.
+// Timestamps (unlike GL_TIME_ELAPSED) can be nested inside other timer queries, so this
+// one is used to measure the whole frame. Queries are double-buffered: the result read
+// back in end() belongs to the previous frame, which avoids stalling on the GPU.
+class GpuTimer
+{
+public:
+    GpuTimer();
+    ~GpuTimer();
+    // Record the start timestamp for the current frame
+    void begin();
+    // Record the end timestamp and resolve the previous frame's measurement
+    void end();
+    // Block until the last issued measurement is available (used at shutdown)
+    void flush();
+    // Elapsed GPU time in milliseconds of the most recently resolved measurement
+    double elapsedMs() const { return elapsed_ms; }
+    // True once at least one measurement has been resolved
+    bool valid() const { return resolved; }
+
+private:
+    void resolve(int index);
+
+    static const int QUERY_BUFFERS = 2;
+    GLuint queries[QUERY_BUFFERS][2]; // start/end timestamp per buffered frame
+    bool issued[QUERY_BUFFERS];       // whether the buffered pair holds pending results
+    int current;                      // buffer being written this frame
+    double elapsed_ms;                // last resolved GPU time
+    bool resolved;
+
+};
+
+// Per-pass GPU profiler built on GL_TIME_ELAPSED queries.
+// Passes are registered by name the first time they are seen and must not overlap
+// (elapsed-time queries cannot be nested). Like GpuTimer the queries are double-buffered
+// and the values reported belong to the previous frame.
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+    // Start timing the named pass
+    void beginPass(const char* name);
+    // Stop timing the pass started by the last beginPass()
+    void endPass();
+    // Flip query buffers and resolve the previous frame's results
+    void endFrame();
+    // Block until the last frame's queries are available (used at shutdown)
+    void flush();
+    // Names of all passes seen so far, in registration order
+    const std::vector<std::string>& passNames() const { return names; }
+    // Last resolved GPU time per pass in milliseconds (0 when the pass did not run)
+    const std::vector<double>& passTimes() const { return times_ms; }
+    // Exponentially smoothed per-pass times for display
+    const std::vector<double>& smoothedTimes() const { return smoothed_ms; }
+    // Sum of the last resolved pass times
+    double totalMs() const;
+    // Write the smoothed breakdown to a .json or .csv file
+    bool write(const std::string& fileName) const;
+
+private:
+    void resolve(int buffer);
+
+    static const int QUERY_BUFFERS = 2;
+    struct PassQueries
+    {
+        GLuint queries[QUERY_BUFFERS];
+        bool issued[QUERY_BUFFERS];
+    };
+
+    std::vector<std::string> names;
+    std::vector<PassQueries> passes;
+    std::vector<double> times_ms;
+    std::vector<double> smoothed_ms;
+    int current;      // buffer being written this frame
+    int active;       // pass currently being timed, -1 if none
+
+};
+
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _HASH_KEY_H_
+#define _HASH_KEY_H_
+
+#include <cstddef>
+
+// 64 bit FNV-1a hash for cache keys of derived data (baked shadow maps, program binaries).
+// Not meant to resist collisions on purpose, only to tell different inputs apart.
+class HashKey
+{
+public:
+    HashKey() : value(14695981039346656037ULL) {}
+    void add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            value ^= bytes[i];
+            value *= 1099511628211ULL;
+        }
+    }
+    template <typename T>
+    void add(const T& item) { add(&item, sizeof(T)); }
+    unsigned long long get() const { return value; }
+
+private:
+    unsigned long long value;
+
+};
+
+
+#endif
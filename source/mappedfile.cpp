@@ -0,0 +1,73 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& fileName)
+    :
+    data(NULL),
+    size(0)
+{
+#ifdef _WIN32
+    file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    mapping = NULL;
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        return;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = data != NULL ? size_t(fileSize.QuadPart) : 0;
+    }
+#else
+    int file = open(fileName.c_str(), O_RDONLY);
+    struct stat status;
+    if (file < 0) {
+        return;
+    }
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        void* mapped = mmap(NULL, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped != MAP_FAILED) {
+            data = mapped;
+            size = size_t(status.st_size);
+            // every user reads the file once front to back
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+    }
+    // the mapping stays valid without the descriptor
+    close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data != NULL) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+#else
+    if (data != NULL) {
+        munmap(data, size);
+    }
+#endif
+}
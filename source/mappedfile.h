@@ -0,0 +1,33 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// Read-only mapping of a whole file (mmap / MapViewOfFile), empty when the file can't be opened.
+// The pages are only read in when touched, so handing bytes() to GL or a parser costs no copy.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& fileName);
+    ~MappedFile();
+
+    const char* bytes() const { return static_cast<const char*>(data); }
+    size_t length() const { return size; }
+    bool isOpen() const { return data != NULL; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    void* data;
+    size_t size;
+#ifdef _WIN32
+    void* file;               // HANDLE
+    void* mapping;            // HANDLE
+#endif
+
+};
+
+
+#endif
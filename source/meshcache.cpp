@@ -0,0 +1,258 @@
+#include "meshcache.h"
+#include "mappedfile.h"
+#include "hashkey.h"
+#include "meshsimplify.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+    // bump when the layout of the file or the import (e.g. normal generation) changes
+    const unsigned int CACHE_VERSION = 3;
+    // start of the vertex and index arrays, a cache line so the copy into the buffer never straddles one
+    const size_t DATA_ALIGNMENT = 64;
+
+    // 128 bytes in front of the vertices
+    struct CacheHeader
+    {
+        char magic[4];                // "MSHC"
+        unsigned int version;
+        unsigned long long sourceSize;
+        long long sourceTime;         // modification time in seconds
+        unsigned long long sourceHash;
+        unsigned long long geometryHash;
+        unsigned int vertexStride;    // sizeof(MeshVertex)
+        unsigned int vertexCount;
+        unsigned int indexCount;      // all levels of detail
+        unsigned int lodCount;
+        unsigned long long vertexOffset;
+        unsigned long long indexOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        unsigned int lodIndexCounts[MAX_MESH_LODS];   // the levels follow each other in the index array
+        float lodErrors[MAX_MESH_LODS];
+    };
+    static_assert(sizeof(CacheHeader) == 128, "mesh cache header is expected to be 128 bytes");
+
+    size_t alignUp(size_t offset)
+    {
+        return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    }
+
+    // size and modification time of a file, false when it doesn't exist
+    bool fileStatus(const std::string& fileName, unsigned long long& size, long long& time)
+    {
+#ifdef _WIN32
+        struct _stat64 status;
+        if (_stat64(fileName.c_str(), &status) != 0) {
+            return false;
+        }
+#else
+        struct stat status;
+        if (stat(fileName.c_str(), &status) != 0) {
+            return false;
+        }
+#endif
+        size = (unsigned long long)status.st_size;
+        time = (long long)status.st_mtime;
+        return true;
+    }
+
+    unsigned long long hashFile(const std::string& fileName)
+    {
+        MappedFile file(fileName);
+        HashKey hash;
+        hash.add(file.bytes(), file.length());
+        return hash.get();
+    }
+}
+
+MeshCache::MeshCache()
+{
+    close();
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+std::string MeshCache::cacheFileName(const std::string& objFileName)
+{
+    return objFileName + ".msh";
+}
+
+void MeshCache::close()
+{
+    mapping.reset();
+    imported = MeshData();
+    vertices = NULL;
+    indices = NULL;
+    vertexCount = 0;
+    indexCount = 0;
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+    geometryHash = 0;
+    lods.clear();
+    source = NONE;
+}
+
+bool MeshCache::open(const std::string& objFileName, ObjImporter* importer)
+{
+    close();
+    return openCache(objFileName) || import(objFileName, importer);
+}
+
+bool MeshCache::openCache(const std::string& objFileName)
+{
+    std::string fileName = cacheFileName(objFileName);
+    std::unique_ptr<MappedFile> file(new MappedFile(fileName));
+    CacheHeader header;
+    if (file->length() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file->bytes(), sizeof(header));
+    if (std::memcmp(header.magic, "MSHC", 4) != 0 || header.version != CACHE_VERSION || header.vertexStride != sizeof(MeshVertex) ||
+        header.vertexCount == 0 || header.indexCount == 0 || header.vertexOffset % DATA_ALIGNMENT != 0 || header.indexOffset % DATA_ALIGNMENT != 0 ||
+        header.vertexOffset + (unsigned long long)header.vertexCount * sizeof(MeshVertex) > header.indexOffset ||
+        header.indexOffset + (unsigned long long)header.indexCount * sizeof(unsigned int) > file->length() ||
+        header.lodCount == 0 || header.lodCount > unsigned(MAX_MESH_LODS)) {
+        return false;
+    }
+    unsigned long long lodIndices = 0;
+    for (unsigned int i = 0; i < header.lodCount; i++)
+    {
+        if (header.lodIndexCounts[i] == 0 || header.lodIndexCounts[i] % 3 != 0) {
+            return false;
+        }
+        lodIndices += header.lodIndexCounts[i];
+    }
+    if (lodIndices != header.indexCount) {
+        return false;
+    }
+
+    unsigned long long sourceSize = 0;
+    long long sourceTime = 0;
+    source = MAPPED;
+    if (fileStatus(objFileName, sourceSize, sourceTime) && (sourceSize != header.sourceSize || sourceTime != header.sourceTime))
+    {
+        // only the time moved: the OBJ may have been copied or checked out again with the same contents
+        if (sourceSize != header.sourceSize || hashFile(objFileName) != header.sourceHash) {
+            source = NONE;
+            return false;
+        }
+        header.sourceTime = sourceTime;
+        // Windows doesn't let a mapped file be opened for writing, map it again afterwards
+        const size_t length = file->length();
+        file.reset();
+        {
+            std::fstream update(fileName.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+            update.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            update.flush();
+            // a header that wasn't written stays MAPPED, the next start hashes the OBJ again
+            if (update) {
+                source = REVALIDATED;
+            }
+        }
+        file.reset(new MappedFile(fileName));
+        if (file->length() != length) {
+            source = NONE;
+            return false;
+        }
+    }
+
+    mapping = std::move(file);
+    vertices = reinterpret_cast<const MeshVertex*>(mapping->bytes() + header.vertexOffset);
+    indices = reinterpret_cast<const unsigned int*>(mapping->bytes() + header.indexOffset);
+    vertexCount = header.vertexCount;
+    indexCount = header.indexCount;
+    boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    geometryHash = header.geometryHash;
+    unsigned int firstIndex = 0;
+    for (unsigned int i = 0; i < header.lodCount; i++)
+    {
+        MeshLod lod = { firstIndex, header.lodIndexCounts[i], header.lodErrors[i] };
+        lods.push_back(lod);
+        firstIndex += lod.indexCount;
+    }
+    return true;
+}
+
+bool MeshCache::import(const std::string& objFileName, ObjImporter* importer)
+{
+    // taken before parsing, an OBJ written meanwhile is imported again next time
+    unsigned long long sourceSize = 0;
+    long long sourceTime = 0;
+    if (!fileStatus(objFileName, sourceSize, sourceTime) ||
+        !(importer != NULL ? importer->load(objFileName, imported) : loadObj(objFileName, imported))) {
+        imported = MeshData();
+        return false;
+    }
+    buildShadowLods(imported);
+    lods = imported.lods;
+    vertices = &imported.vertices[0];
+    indices = &imported.indices[0];
+    vertexCount = unsigned(imported.vertices.size());
+    indexCount = unsigned(imported.indices.size());
+    boundsMin = imported.boundsMin;
+    boundsMax = imported.boundsMax;
+    HashKey geometry;
+    geometry.add(vertices, vertexCount * sizeof(MeshVertex));
+    geometry.add(indices, indexCount * sizeof(unsigned int));
+    geometryHash = geometry.get();
+    source = IMPORTED;
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MSHC", 4);
+    header.version = CACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.sourceHash = hashFile(objFileName);
+    header.geometryHash = geometryHash;
+    header.vertexStride = sizeof(MeshVertex);
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.lodCount = unsigned(lods.size());
+    for (size_t i = 0; i < lods.size(); i++) {
+        header.lodIndexCounts[i] = lods[i].indexCount;
+        header.lodErrors[i] = lods[i].error;
+    }
+    header.vertexOffset = alignUp(sizeof(header));
+    header.indexOffset = alignUp(size_t(header.vertexOffset) + vertexCount * sizeof(MeshVertex));
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+    }
+
+    // a crash halfway through never leaves a truncated cache under the real name
+    std::string target = cacheFileName(objFileName);
+    std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return true;
+        }
+        const char zeros[DATA_ALIGNMENT] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(zeros, std::streamsize(header.vertexOffset - sizeof(header)));
+        file.write(reinterpret_cast<const char*>(vertices), std::streamsize(vertexCount * sizeof(MeshVertex)));
+        file.write(zeros, std::streamsize(header.indexOffset - header.vertexOffset - vertexCount * sizeof(MeshVertex)));
+        file.write(reinterpret_cast<const char*>(indices), std::streamsize(indexCount * sizeof(unsigned int)));
+        if (!file) {
+            file.close();
+            std::remove(temporary.c_str());
+            return true;
+        }
+    }
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+        std::remove(temporary.c_str());
+    }
+    return true;
+}
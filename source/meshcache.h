@@ -0,0 +1,81 @@
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include "objloader.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Binary cache of an imported OBJ, stored next to it as "<file>.obj.msh": a header followed by
+// the interleaved MeshVertex array and the 32 bit indices, each starting on a 64 byte boundary.
+// The indices hold the full mesh followed by its shadow caster levels of detail (buildShadowLods()),
+// simplified once at import time and loaded with the rest.
+// open() maps the cache so the vertex and index pointers point straight into the page cache and
+// can be handed to glBufferStorage/glBufferData as they are. The header records the size,
+// modification time and content hash of the OBJ it was made from: a different size or hash makes
+// open() import the OBJ again and rewrite the cache, a new time with the same contents (a fresh
+// checkout) only updates the recorded time.
+class MeshCache
+{
+public:
+    // where the data came from in open()
+    enum Source
+    {
+        NONE,           // not open
+        MAPPED,         // up to date cache file
+        REVALIDATED,    // cache file, OBJ touched but unchanged
+        IMPORTED        // parsed from the OBJ (the cache was missing or stale)
+    };
+
+    MeshCache();
+    ~MeshCache();
+    // Open the mesh of objFileName from its cache, importing the OBJ when needed (a cache that can't
+    // be written only costs the next start the import again). A cache without its OBJ is used as it
+    // is. The import runs on importer, or single threaded through loadObj() when it is null.
+    // Returns false when neither holds a mesh.
+    bool open(const std::string& objFileName, ObjImporter* importer = NULL);
+    // release the mapping or the imported arrays, e.g. once the GPU has its copy
+    void close();
+    // cache file of an OBJ
+    static std::string cacheFileName(const std::string& objFileName);
+
+    const MeshVertex* getVertices() const { return vertices; }
+    unsigned int getVertexCount() const { return vertexCount; }
+    const unsigned int* getIndices() const { return indices; }
+    unsigned int getIndexCount() const { return indexCount; }
+    // level 0 is the full mesh, the following ones get coarser
+    int getLodCount() const { return int(lods.size()); }
+    const MeshLod& getLod(int level) const { return lods[level]; }
+    const glm::vec3& getBoundsMin() const { return boundsMin; }
+    const glm::vec3& getBoundsMax() const { return boundsMax; }
+    // HashKey of the vertex and index arrays, identical for the mapped and the imported mesh
+    unsigned long long getGeometryHash() const { return geometryHash; }
+    Source getSource() const { return source; }
+
+private:
+    MeshCache(const MeshCache&);
+    MeshCache& operator=(const MeshCache&);
+
+    bool openCache(const std::string& objFileName);
+    bool import(const std::string& objFileName, ObjImporter* importer);
+
+    std::unique_ptr<MappedFile> mapping;  // cache file
+    MeshData imported;                    // OBJ parsed by this open()
+    const MeshVertex* vertices;
+    const unsigned int* indices;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    unsigned long long geometryHash;
+    std::vector<MeshLod> lods;
+    Source source;
+
+};
+
+
+#endif
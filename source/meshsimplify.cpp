@@ -0,0 +1,594 @@
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // no level below this, the shadow pass doesn't notice the difference any more
+    const size_t MIN_LOD_TRIANGLES = 64;
+    // end of a vertex's plane list
+    const unsigned int NO_PLANE = 0xFFFFFFFFu;
+    // end of a vertex's corner list
+    const unsigned int NO_CORNER = 0xFFFFFFFFu;
+    // empty slot of the welding table, and the vertices of a removed triangle
+    const unsigned int NO_VERTEX = 0xFFFFFFFFu;
+    // heap position of a vertex that isn't in the collapse queue
+    const unsigned int NOT_QUEUED = 0xFFFFFFFFu;
+
+    // symmetric 4x4 matrix summing the squared distances to a set of planes, and their total area
+    struct Quadric
+    {
+        double a00, a01, a02, a03;
+        double a11, a12, a13;
+        double a22, a23;
+        double a33;
+        double weight;
+    };
+
+    void addPlane(Quadric& q, double nx, double ny, double nz, double d, double weight)
+    {
+        q.a00 += weight * nx * nx; q.a01 += weight * nx * ny; q.a02 += weight * nx * nz; q.a03 += weight * nx * d;
+        q.a11 += weight * ny * ny; q.a12 += weight * ny * nz; q.a13 += weight * ny * d;
+        q.a22 += weight * nz * nz; q.a23 += weight * nz * d;
+        q.a33 += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric& q, const Quadric& other)
+    {
+        q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+        q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+        q.a22 += other.a22; q.a23 += other.a23;
+        q.a33 += other.a33;
+        q.weight += other.weight;
+    }
+
+    // area weighted mean squared distance of p to the planes of q
+    float quadricError(const Quadric& q, const glm::vec3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+            + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+            + q.a22 * z * z + 2.0 * q.a23 * z
+            + q.a33;
+        return q.weight > 0.0 ? float(std::max(error, 0.0) / q.weight) : 0.0f;
+    }
+
+    // errors within a quarter octave (the exponent and two mantissa bits) of a non-negative float
+    unsigned int errorBucket(float error)
+    {
+        unsigned int bits;
+        std::memcpy(&bits, &error, sizeof(bits));
+        return bits >> 21;
+    }
+
+    // 4-ary min-heap of the vertices by the error of their cheapest collapse, each vertex at most once.
+    // The errors sit in the heap next to the vertices, sifting doesn't look them up per vertex
+    class CollapseQueue
+    {
+    public:
+        explicit CollapseQueue(size_t vertexCount) : position(vertexCount, NOT_QUEUED) {}
+        bool empty() const { return heap.empty(); }
+        unsigned int top() const { return heap[0].vertex; }
+        bool contains(unsigned int vertex) const { return position[vertex] != NOT_QUEUED; }
+        float error(unsigned int vertex) const { return heap[position[vertex]].error; }
+
+        // add the vertex or move it to its new error
+        void update(unsigned int vertex, float error)
+        {
+            Entry entry = { error, vertex };
+            unsigned int i = position[vertex];
+            if (i == NOT_QUEUED)
+            {
+                i = unsigned(heap.size());
+                heap.push_back(entry);
+            }
+            if (i > 0 && entry.before(heap[(i - 1) / 4])) {
+                siftUp(i, entry);
+            }
+            else {
+                siftDown(i, entry);
+            }
+        }
+
+        void remove(unsigned int vertex)
+        {
+            unsigned int i = position[vertex];
+            if (i == NOT_QUEUED) {
+                return;
+            }
+            position[vertex] = NOT_QUEUED;
+            Entry last = heap.back();
+            heap.pop_back();
+            if (last.vertex == vertex) {
+                return;
+            }
+            if (i > 0 && last.before(heap[(i - 1) / 4])) {
+                siftUp(i, last);
+            }
+            else {
+                siftDown(i, last);
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            float error;
+            unsigned int vertex;
+            // errors in the same bucket go by vertex index, close collapses then walk the mesh in file
+            // order and find its data in cache
+            bool before(const Entry& other) const
+            {
+                unsigned int bucket = errorBucket(error);
+                unsigned int otherBucket = errorBucket(other.error);
+                return bucket != otherBucket ? bucket < otherBucket : vertex < other.vertex;
+            }
+        };
+
+        void place(unsigned int i, const Entry& entry)
+        {
+            heap[i] = entry;
+            position[entry.vertex] = i;
+        }
+
+        void siftUp(unsigned int i, const Entry& entry)
+        {
+            while (i > 0 && entry.before(heap[(i - 1) / 4]))
+            {
+                place(i, heap[(i - 1) / 4]);
+                i = (i - 1) / 4;
+            }
+            place(i, entry);
+        }
+
+        void siftDown(unsigned int i, const Entry& entry)
+        {
+            size_t count = heap.size();
+            for (;;)
+            {
+                size_t first = size_t(i) * 4 + 1;
+                if (first >= count) {
+                    break;
+                }
+                size_t best = first;
+                for (size_t child = first + 1; child < std::min(first + 4, count); child++) {
+                    if (heap[child].before(heap[best])) {
+                        best = child;
+                    }
+                }
+                if (!heap[best].before(entry)) {
+                    break;
+                }
+                place(i, heap[best]);
+                i = unsigned(best);
+            }
+            place(i, entry);
+        }
+
+        std::vector<Entry> heap;
+        std::vector<unsigned int> position;    // index into heap of every vertex, NOT_QUEUED when it isn't
+    };
+
+    // a triangle while collapsing, with the links of its corners into the corner lists of their vertices
+    struct LinkedTriangle
+    {
+        unsigned int vertices[3];    // all NO_VERTEX once a collapse removed the triangle
+        unsigned int next[3];        // next corner around the same vertex, NO_CORNER at the end
+    };
+
+    // hash of the bits of a position, only identical positions weld
+    size_t positionHash(const glm::vec3& position)
+    {
+        unsigned int bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+        unsigned long long hash = bits[0] * 0x9E3779B97F4A7C15ULL;
+        hash ^= (bits[1] + (hash >> 17)) * 0xC2B2AE3D27D4EB4FULL;
+        hash ^= (bits[2] + (hash >> 23)) * 0x165667B19E3779F9ULL;
+        return size_t(hash ^ (hash >> 31));
+    }
+
+    glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+
+    // drop the triangles the welding made degenerate
+    void removeDegenerate(std::vector<unsigned int>& triangles)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            unsigned int a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+            if (a != b && b != c && a != c)
+            {
+                triangles[kept++] = a;
+                triangles[kept++] = b;
+                triangles[kept++] = c;
+            }
+        }
+        triangles.resize(kept);
+    }
+}
+
+void buildShadowLods(MeshData& mesh, int maxLods)
+{
+    mesh.lods.clear();
+    MeshLod full = { 0, unsigned(mesh.indices.size()), 0.0f };
+    mesh.lods.push_back(full);
+    const size_t vertexCount = mesh.vertices.size();
+    if (maxLods <= 1 || mesh.indices.size() / 3 < MIN_LOD_TRIANGLES * 4) {
+        return;
+    }
+
+    // the positions apart from the other attributes, the collapses look up little else
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        positions[i] = mesh.vertices[i].position;
+    }
+
+    // 1. weld the vertices of equal position, the first one of every position stands for all. The
+    // open addressing table holds vertex indices, at most half full
+    std::vector<unsigned int> welded(vertexCount);
+    {
+        size_t tableSize = 1;
+        while (tableSize < vertexCount * 2) {
+            tableSize *= 2;
+        }
+        std::vector<unsigned int> firstOfPosition(tableSize, NO_VERTEX);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            size_t slot = positionHash(positions[i]) & (tableSize - 1);
+            while (firstOfPosition[slot] != NO_VERTEX && std::memcmp(&positions[firstOfPosition[slot]], &positions[i], sizeof(glm::vec3)) != 0) {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (firstOfPosition[slot] == NO_VERTEX) {
+                firstOfPosition[slot] = unsigned(i);
+            }
+            welded[i] = firstOfPosition[slot];
+        }
+    }
+    std::vector<unsigned int> triangles(mesh.indices.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        triangles[i] = welded[mesh.indices[i]];
+    }
+    removeDegenerate(triangles);
+
+    // 2. quadric of the planes around every vertex, weighted by triangle area; the planes themselves
+    // are kept in a list per vertex too, a collapse measures its largest distance to them
+    std::vector<Quadric> quadrics(vertexCount);
+    std::memset(&quadrics[0], 0, quadrics.size() * sizeof(Quadric));
+    std::vector<glm::vec4> planes;
+    planes.reserve(triangles.size() / 3);
+    std::vector<unsigned int> planeHead(vertexCount, NO_PLANE);
+    std::vector<unsigned int> planeTail(vertexCount, NO_PLANE);
+    std::vector<unsigned int> planeOfEntry;
+    std::vector<unsigned int> nextEntry;
+    planeOfEntry.reserve(triangles.size());
+    nextEntry.reserve(triangles.size());
+    // largest distance of every vertex to the planes of its list
+    std::vector<float> vertexError(vertexCount, 0.0f);
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const glm::vec3& a = positions[triangles[i]];
+        glm::vec3 normal = triangleNormal(a, positions[triangles[i + 1]], positions[triangles[i + 2]]);
+        double length = std::sqrt(double(normal.x) * normal.x + double(normal.y) * normal.y + double(normal.z) * normal.z);
+        if (length <= 0.0) {
+            continue;
+        }
+        double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+        double d = -(nx * a.x + ny * a.y + nz * a.z);
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int vertex = triangles[i + corner];
+            addPlane(quadrics[vertex], nx, ny, nz, d, 0.5 * length);
+            unsigned int entry = unsigned(planeOfEntry.size());
+            planeOfEntry.push_back(unsigned(planes.size()));
+            nextEntry.push_back(planeHead[vertex]);
+            planeHead[vertex] = entry;
+            if (planeTail[vertex] == NO_PLANE) {
+                planeTail[vertex] = entry;
+            }
+        }
+        planes.push_back(glm::vec4(float(nx), float(ny), float(nz), float(d)));
+    }
+
+    // 3. vertices on edges not shared by exactly two triangles (open borders, non-manifold edges) are
+    // locked; the link condition keeps the surface manifold, so that doesn't change while collapsing
+    std::vector<unsigned long long> edges;
+    edges.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned long long a = triangles[i + corner];
+            unsigned long long b = triangles[i + (corner + 1) % 3];
+            edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::vector<unsigned char> locked(vertexCount);
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t next = i + 1;
+        while (next < edges.size() && edges[next] == edges[i]) {
+            next++;
+        }
+        if (next - i != 2) {
+            locked[edges[i] >> 32] = locked[edges[i] & 0xFFFFFFFFu] = 1;
+        }
+        i = next;
+    }
+    std::vector<unsigned long long>().swap(edges);
+
+    // 4. the corners of the triangles around every vertex as linked lists, corner c of triangle t is
+    // entry 3 * t + c. A collapse moves the removed vertex's list over to the survivor; the triangles
+    // that degenerate are flagged and unlinked lazily
+    std::vector<unsigned int> cornerHead(vertexCount, NO_CORNER);
+    std::vector<LinkedTriangle> linked(triangles.size() / 3);
+    for (size_t i = triangles.size(); i-- > 0;)
+    {
+        linked[i / 3].vertices[i % 3] = triangles[i];
+        linked[i / 3].next[i % 3] = cornerHead[triangles[i]];
+        cornerHead[triangles[i]] = unsigned(i);
+    }
+    std::vector<unsigned int>().swap(triangles);
+    size_t liveTriangles = linked.size();
+
+    // 5. every vertex is queued with its cheapest collapse onto a neighbour. A collapse only changes the
+    // quadric of the survivor, so only the survivor and the collapses onto it are evaluated again
+    std::vector<unsigned int> collapseTarget(vertexCount);
+    CollapseQueue queue(vertexCount);
+    // the vertex goes where its neighbour is
+    auto collapseError = [&](unsigned int vertex, unsigned int neighbour)
+    {
+        Quadric sum = quadrics[vertex];
+        addQuadric(sum, quadrics[neighbour]);
+        return quadricError(sum, positions[neighbour]);
+    };
+    // the neighbours of a vertex in ascending order, the removed triangles are unlinked on the way
+    auto gatherNeighbours = [&](unsigned int vertex, std::vector<unsigned int>& ring)
+    {
+        ring.clear();
+        for (unsigned int* link = &cornerHead[vertex]; *link != NO_CORNER;)
+        {
+            unsigned int entry = *link;
+            const unsigned int* triangle = linked[entry / 3].vertices;
+            if (triangle[0] == NO_VERTEX) {
+                *link = linked[entry / 3].next[entry % 3];
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                if (triangle[corner] != vertex) {
+                    ring.push_back(triangle[corner]);
+                }
+            }
+            link = &linked[entry / 3].next[entry % 3];
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    };
+    // queue the cheapest collapse of a vertex onto one of its neighbours, locked vertices stay
+    auto evaluate = [&](unsigned int vertex, const std::vector<unsigned int>& ring)
+    {
+        float best = -1.0f;
+        if (!locked[vertex])
+        {
+            for (unsigned int neighbour : ring)
+            {
+                float error = collapseError(vertex, neighbour);
+                if (best < 0.0f || error < best) {
+                    best = error;
+                    collapseTarget[vertex] = neighbour;
+                }
+            }
+        }
+        if (best < 0.0f) {
+            queue.remove(vertex);
+        }
+        else {
+            queue.update(vertex, best);
+        }
+    };
+    std::vector<unsigned int> neighbours;
+    std::vector<unsigned int> ring;
+    std::vector<std::pair<float, unsigned int>> alternatives;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        gatherNeighbours(unsigned(i), ring);
+        evaluate(unsigned(i), ring);
+    }
+
+    // the collapse neither turns a triangle over nor pinches the surface
+    auto canCollapse = [&](unsigned int from, unsigned int to)
+    {
+        const glm::vec3& destination = positions[to];
+        neighbours.clear();
+        for (unsigned int entry = cornerHead[from]; entry != NO_CORNER; entry = linked[entry / 3].next[entry % 3])
+        {
+            const unsigned int* triangle = linked[entry / 3].vertices;
+            if (triangle[0] == NO_VERTEX) {
+                continue;
+            }
+            bool shared = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+            for (int corner = 0; corner < 3; corner++) {
+                if (triangle[corner] != from && triangle[corner] != to) {
+                    neighbours.push_back(triangle[corner]);
+                }
+            }
+            if (shared) {
+                continue;
+            }
+            // the triangles that stay must not turn over
+            glm::vec3 corners[3];
+            for (int corner = 0; corner < 3; corner++) {
+                corners[corner] = positions[triangle[corner]];
+            }
+            glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+            corners[entry % 3] = destination;
+            glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+            if (glm::dot(before, after) <= 0.0f) {
+                return false;
+            }
+        }
+        // link condition: an interior edge has exactly two common neighbours, more would pinch the surface
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        int common = 0;
+        for (unsigned int entry = cornerHead[to]; entry != NO_CORNER; entry = linked[entry / 3].next[entry % 3])
+        {
+            const unsigned int* triangle = linked[entry / 3].vertices;
+            if (triangle[0] == NO_VERTEX) {
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                if (triangle[corner] != to && std::binary_search(neighbours.begin(), neighbours.end(), triangle[corner])) {
+                    common++;
+                }
+            }
+        }
+        // every common neighbour is seen from the two triangles it shares with the edge's end
+        return common <= 4;
+    };
+
+    float maxError = 0.0f;
+    size_t previousCount = liveTriangles;
+    size_t target = previousCount / 4;
+
+    while (int(mesh.lods.size()) < maxLods)
+    {
+        while (liveTriangles > target && !queue.empty())
+        {
+            unsigned int from = queue.top();
+            unsigned int to = collapseTarget[from];
+            float queuedError = queue.error(from);
+            queue.remove(from);
+            if (!canCollapse(from, to))
+            {
+                // the other neighbours, cheapest first; one that costs more than the queued error goes back
+                // into the queue. A vertex without any waits until a collapse next to it changes its surroundings
+                gatherNeighbours(from, ring);
+                alternatives.clear();
+                for (unsigned int neighbour : ring) {
+                    if (neighbour != to) {
+                        alternatives.push_back(std::make_pair(collapseError(from, neighbour), neighbour));
+                    }
+                }
+                std::sort(alternatives.begin(), alternatives.end());
+                bool found = false;
+                for (const std::pair<float, unsigned int>& alternative : alternatives)
+                {
+                    if (!canCollapse(from, alternative.second)) {
+                        continue;
+                    }
+                    collapseTarget[from] = alternative.second;
+                    if (errorBucket(alternative.first) > errorBucket(queuedError)) {
+                        queue.update(from, alternative.first);
+                    }
+                    else {
+                        to = alternative.second;
+                        found = true;
+                    }
+                    break;
+                }
+                if (!found) {
+                    continue;
+                }
+            }
+            const glm::vec3& destination = positions[to];
+
+            // the removed vertex's triangles go over to the survivor, the ones on the edge disappear
+            for (unsigned int entry = cornerHead[from], next; entry != NO_CORNER; entry = next)
+            {
+                unsigned int* triangle = linked[entry / 3].vertices;
+                next = linked[entry / 3].next[entry % 3];
+                if (triangle[0] == NO_VERTEX) {
+                    continue;
+                }
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                {
+                    std::fill(triangle, triangle + 3, NO_VERTEX);
+                    liveTriangles--;
+                    continue;
+                }
+                triangle[entry % 3] = to;
+                linked[entry / 3].next[entry % 3] = cornerHead[to];
+                cornerHead[to] = entry;
+            }
+            cornerHead[from] = NO_CORNER;
+            addQuadric(quadrics[to], quadrics[from]);
+            // the planes around the survivor were measured when it took them over, only the
+            // removed vertex's ones are new to its position
+            float error = vertexError[to];
+            for (unsigned int entry = planeHead[from]; entry != NO_PLANE; entry = nextEntry[entry])
+            {
+                const glm::vec4& plane = planes[planeOfEntry[entry]];
+                error = std::max(error, std::fabs(plane.x * destination.x + plane.y * destination.y + plane.z * destination.z + plane.w));
+            }
+            if (planeHead[from] != NO_PLANE)
+            {
+                nextEntry[planeTail[from]] = planeHead[to];
+                if (planeHead[to] == NO_PLANE) {
+                    planeTail[to] = planeTail[from];
+                }
+                planeHead[to] = planeHead[from];
+                planeHead[from] = planeTail[from] = NO_PLANE;
+            }
+            vertexError[to] = error;
+            maxError = std::max(maxError, error);
+
+            // evaluate the survivor and the collapses onto it again
+            gatherNeighbours(to, neighbours);
+            evaluate(to, neighbours);
+            for (unsigned int neighbour : neighbours)
+            {
+                // only the collapse onto the survivor changed, unless the best one went to the edge
+                if (locked[neighbour]) {
+                    continue;
+                }
+                if (!queue.contains(neighbour) || collapseTarget[neighbour] == from || collapseTarget[neighbour] == to) {
+                    gatherNeighbours(neighbour, ring);
+                    evaluate(neighbour, ring);
+                    continue;
+                }
+                float ontoSurvivor = collapseError(neighbour, to);
+                float best = queue.error(neighbour);
+                if (ontoSurvivor < best || (ontoSurvivor == best && to < collapseTarget[neighbour])) {
+                    collapseTarget[neighbour] = to;
+                    queue.update(neighbour, ontoSurvivor);
+                }
+            }
+        }
+        bool stalled = liveTriangles > target;
+
+        // a level is worth its memory only when it still takes off a good part of the triangles
+        if (liveTriangles < MIN_LOD_TRIANGLES || liveTriangles * 4 > previousCount * 3) {
+            break;
+        }
+        MeshLod lod = { unsigned(mesh.indices.size()), unsigned(liveTriangles * 3), maxError };
+        for (const LinkedTriangle& triangle : linked)
+        {
+            if (triangle.vertices[0] != NO_VERTEX) {
+                mesh.indices.insert(mesh.indices.end(), triangle.vertices, triangle.vertices + 3);
+            }
+        }
+        mesh.lods.push_back(lod);
+        previousCount = liveTriangles;
+        target = liveTriangles / 4;
+        if (stalled) {
+            break;
+        }
+    }
+}
+
+int selectLod(const std::vector<MeshLod>& lods, float maxError)
+{
+    int level = 0;
+    // the errors grow with the level
+    while (level + 1 < int(lods.size()) && lods[level + 1].error <= maxError) {
+        level++;
+    }
+    return level;
+}
@@ -0,0 +1,32 @@
+#ifndef _MESH_SIMPLIFY_H_
+#define _MESH_SIMPLIFY_H_
+
+#include "objloader.h"
+
+// Shadow caster proxies by edge collapse with quadric error metrics (Garland and Heckbert).
+// Only the depth of the casters ends up in the shadow map, so vertices sharing a position are
+// welded first and texture or normal seams don't hold the simplification back. A vertex always
+// collapses onto a neighbour, so every level is just another index list into the same vertices.
+// Open borders and non-manifold edges are kept, and a collapse that flips a triangle is skipped.
+// The levels come from one run that snapshots the triangles each time a quarter of the previous
+// level is reached. Every vertex is queued with its cheapest collapse and only the entries around
+// a collapse are evaluated again; errors within a quarter octave go in vertex order, which keeps
+// the collapses close in memory. The quadrics only order the collapses. The error of a level is
+// the largest distance of any vertex so far to the plane of an original triangle around a vertex
+// it replaced, in object space units; distances to planes, not to the triangles, so it doesn't
+// strictly bound the deviation of the surface, but no single vertex moved further off its
+// original surface.
+
+// maximal number of levels buildShadowLods() creates, the full mesh included
+static const int MAX_MESH_LODS = 4;
+
+// Fill mesh.lods with the full index list as level 0 and append up to maxLods - 1 simplified
+// index lists to mesh.indices. A level is only added while it still removes a good part of the
+// triangles of the previous one, small meshes get fewer levels.
+void buildShadowLods(MeshData& mesh, int maxLods = MAX_MESH_LODS);
+
+// coarsest of the levels whose error stays within maxError (object space units), 0 when none does
+int selectLod(const std::vector<MeshLod>& lods, float maxError);
+
+
+#endif
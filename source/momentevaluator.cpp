@@ -0,0 +1,323 @@
+#include "momentevaluator.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MSM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// the kernels only agree bit for bit if no multiply + add gets fused, even when the
+// file is built for an FMA capable target (-march=native, /arch:AVX2)
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+// GCC/Clang compile the AVX2 kernel for AVX2 only, the rest of the file keeps the build's target
+#if defined(MSM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MSM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MSM_TARGET_AVX2
+#endif
+
+namespace
+{
+    // clamp that maps NaN to 0, matching max(x, 0) then min(x, 1) of the SIMD kernels
+    inline float clampIntensity(float value)
+    {
+        return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    }
+
+#if defined(MSM_X86)
+    void evaluateSSE(const glm::vec4* moments, const float* depths, float* result, size_t count, float depthBias, float momentBias)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const __m128 keep = _mm_set1_ps(1.0f - momentBias);
+        const __m128 biasHalf = _mm_set1_ps(0.5f * momentBias);
+        const __m128 zBias = _mm_set1_ps(depthBias);
+        for (size_t i = 0; i < count; i += 4)
+        {
+            // 4 texels of xyzw moments -> one register per moment
+            __m128 b0 = _mm_loadu_ps(&moments[i][0]);
+            __m128 b1 = _mm_loadu_ps(&moments[i + 1][0]);
+            __m128 b2 = _mm_loadu_ps(&moments[i + 2][0]);
+            __m128 b3 = _mm_loadu_ps(&moments[i + 3][0]);
+            _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+            b0 = _mm_add_ps(_mm_mul_ps(b0, keep), biasHalf);
+            b1 = _mm_add_ps(_mm_mul_ps(b1, keep), biasHalf);
+            b2 = _mm_add_ps(_mm_mul_ps(b2, keep), biasHalf);
+            b3 = _mm_add_ps(_mm_mul_ps(b3, keep), biasHalf);
+            __m128 z0 = _mm_sub_ps(_mm_loadu_ps(depths + i), zBias);
+
+            // Cholesky factorization of the Hankel matrix
+            __m128 L32D22 = _mm_sub_ps(b2, _mm_mul_ps(b0, b1));
+            __m128 D22 = _mm_sub_ps(b1, _mm_mul_ps(b0, b0));
+            __m128 squaredDepthVariance = _mm_sub_ps(b3, _mm_mul_ps(b1, b1));
+            __m128 D33D22 = _mm_sub_ps(_mm_mul_ps(squaredDepthVariance, D22), _mm_mul_ps(L32D22, L32D22));
+            __m128 InvD22 = _mm_div_ps(one, D22);
+            __m128 L32 = _mm_mul_ps(L32D22, InvD22);
+
+            // solve for the quadratic's coefficients
+            __m128 c0 = one;
+            __m128 c1 = _mm_sub_ps(z0, b0);
+            __m128 c2 = _mm_sub_ps(_mm_mul_ps(z0, z0), _mm_add_ps(b1, _mm_mul_ps(L32, c1)));
+            c1 = _mm_mul_ps(c1, InvD22);
+            c2 = _mm_mul_ps(c2, _mm_div_ps(D22, D33D22));
+            c1 = _mm_sub_ps(c1, _mm_mul_ps(L32, c2));
+            c0 = _mm_sub_ps(c0, _mm_add_ps(_mm_mul_ps(c1, b0), _mm_mul_ps(c2, b1)));
+
+            // roots z1 <= z2
+            __m128 p = _mm_div_ps(c1, c2);
+            __m128 q = _mm_div_ps(c0, c2);
+            __m128 D = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(p, p), quarter), q);
+            __m128 r = _mm_sqrt_ps(D);
+            __m128 halfP = _mm_mul_ps(_mm_sub_ps(zero, p), half);
+            __m128 z1 = _mm_sub_ps(halfP, r);
+            __m128 z2 = _mm_add_ps(halfP, r);
+
+            // switchVal without branches
+            __m128 farMask = _mm_cmplt_ps(z2, z0);
+            __m128 nearMask = _mm_andnot_ps(farMask, _mm_cmplt_ps(z1, z0));
+            __m128 s0 = _mm_or_ps(_mm_and_ps(farMask, z1), _mm_and_ps(nearMask, z0));
+            __m128 s1 = _mm_or_ps(_mm_and_ps(farMask, z0), _mm_and_ps(nearMask, z1));
+            __m128 s2 = _mm_and_ps(farMask, one);
+            __m128 s3 = _mm_and_ps(_mm_or_ps(farMask, nearMask), one);
+            __m128 numerator = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(s0, z2), _mm_mul_ps(b0, _mm_add_ps(s0, z2))), b1);
+            __m128 quotient = _mm_div_ps(numerator, _mm_mul_ps(_mm_sub_ps(z2, s1), _mm_sub_ps(z0, z1)));
+            __m128 shadowIntensity = _mm_add_ps(s2, _mm_mul_ps(s3, quotient));
+            shadowIntensity = _mm_min_ps(_mm_max_ps(shadowIntensity, zero), one);
+            _mm_storeu_ps(result + i, _mm_sub_ps(one, shadowIntensity));
+        }
+    }
+
+    MSM_TARGET_AVX2
+    void evaluateAVX2(const glm::vec4* moments, const float* depths, float* result, size_t count, float depthBias, float momentBias)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 keep = _mm256_set1_ps(1.0f - momentBias);
+        const __m256 biasHalf = _mm256_set1_ps(0.5f * momentBias);
+        const __m256 zBias = _mm256_set1_ps(depthBias);
+        for (size_t i = 0; i < count; i += 8)
+        {
+            // texels i..i+3 in the low and i+4..i+7 in the high lane, transposed per lane
+            __m256 t0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&moments[i][0])), _mm_loadu_ps(&moments[i + 4][0]), 1);
+            __m256 t1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&moments[i + 1][0])), _mm_loadu_ps(&moments[i + 5][0]), 1);
+            __m256 t2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&moments[i + 2][0])), _mm_loadu_ps(&moments[i + 6][0]), 1);
+            __m256 t3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&moments[i + 3][0])), _mm_loadu_ps(&moments[i + 7][0]), 1);
+            __m256 u0 = _mm256_unpacklo_ps(t0, t1);
+            __m256 u1 = _mm256_unpackhi_ps(t0, t1);
+            __m256 u2 = _mm256_unpacklo_ps(t2, t3);
+            __m256 u3 = _mm256_unpackhi_ps(t2, t3);
+            __m256 b0 = _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 b1 = _mm256_shuffle_ps(u0, u2, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 b2 = _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 b3 = _mm256_shuffle_ps(u1, u3, _MM_SHUFFLE(3, 2, 3, 2));
+            b0 = _mm256_add_ps(_mm256_mul_ps(b0, keep), biasHalf);
+            b1 = _mm256_add_ps(_mm256_mul_ps(b1, keep), biasHalf);
+            b2 = _mm256_add_ps(_mm256_mul_ps(b2, keep), biasHalf);
+            b3 = _mm256_add_ps(_mm256_mul_ps(b3, keep), biasHalf);
+            __m256 z0 = _mm256_sub_ps(_mm256_loadu_ps(depths + i), zBias);
+
+            // Cholesky factorization of the Hankel matrix
+            __m256 L32D22 = _mm256_sub_ps(b2, _mm256_mul_ps(b0, b1));
+            __m256 D22 = _mm256_sub_ps(b1, _mm256_mul_ps(b0, b0));
+            __m256 squaredDepthVariance = _mm256_sub_ps(b3, _mm256_mul_ps(b1, b1));
+            __m256 D33D22 = _mm256_sub_ps(_mm256_mul_ps(squaredDepthVariance, D22), _mm256_mul_ps(L32D22, L32D22));
+            __m256 InvD22 = _mm256_div_ps(one, D22);
+            __m256 L32 = _mm256_mul_ps(L32D22, InvD22);
+
+            // solve for the quadratic's coefficients
+            __m256 c0 = one;
+            __m256 c1 = _mm256_sub_ps(z0, b0);
+            __m256 c2 = _mm256_sub_ps(_mm256_mul_ps(z0, z0), _mm256_add_ps(b1, _mm256_mul_ps(L32, c1)));
+            c1 = _mm256_mul_ps(c1, InvD22);
+            c2 = _mm256_mul_ps(c2, _mm256_div_ps(D22, D33D22));
+            c1 = _mm256_sub_ps(c1, _mm256_mul_ps(L32, c2));
+            c0 = _mm256_sub_ps(c0, _mm256_add_ps(_mm256_mul_ps(c1, b0), _mm256_mul_ps(c2, b1)));
+
+            // roots z1 <= z2
+            __m256 p = _mm256_div_ps(c1, c2);
+            __m256 q = _mm256_div_ps(c0, c2);
+            __m256 D = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(p, p), quarter), q);
+            __m256 r = _mm256_sqrt_ps(D);
+            __m256 halfP = _mm256_mul_ps(_mm256_sub_ps(zero, p), half);
+            __m256 z1 = _mm256_sub_ps(halfP, r);
+            __m256 z2 = _mm256_add_ps(halfP, r);
+
+            // switchVal without branches
+            __m256 farMask = _mm256_cmp_ps(z2, z0, _CMP_LT_OQ);
+            __m256 nearMask = _mm256_andnot_ps(farMask, _mm256_cmp_ps(z1, z0, _CMP_LT_OQ));
+            __m256 s0 = _mm256_or_ps(_mm256_and_ps(farMask, z1), _mm256_and_ps(nearMask, z0));
+            __m256 s1 = _mm256_or_ps(_mm256_and_ps(farMask, z0), _mm256_and_ps(nearMask, z1));
+            __m256 s2 = _mm256_and_ps(farMask, one);
+            __m256 s3 = _mm256_and_ps(_mm256_or_ps(farMask, nearMask), one);
+            __m256 numerator = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(s0, z2), _mm256_mul_ps(b0, _mm256_add_ps(s0, z2))), b1);
+            __m256 quotient = _mm256_div_ps(numerator, _mm256_mul_ps(_mm256_sub_ps(z2, s1), _mm256_sub_ps(z0, z1)));
+            __m256 shadowIntensity = _mm256_add_ps(s2, _mm256_mul_ps(s3, quotient));
+            shadowIntensity = _mm256_min_ps(_mm256_max_ps(shadowIntensity, zero), one);
+            _mm256_storeu_ps(result + i, _mm256_sub_ps(one, shadowIntensity));
+        }
+    }
+
+    bool cpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        // the OS has to save the YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+#endif
+}
+
+MomentEvaluator::MomentEvaluator(float depthBias, float momentBias)
+    :
+    kernel(bestKernel()),
+    depthBias(depthBias),
+    momentBias(momentBias)
+{
+}
+
+float MomentEvaluator::evaluate(const glm::vec4& moments, float depth, float depthBias, float momentBias)
+{
+    // Bias input data to avoid artifacts
+    float keep = 1.0f - momentBias;
+    float biasHalf = 0.5f * momentBias;
+    float b[4];
+    for (int i = 0; i < 4; i++) {
+        b[i] = moments[i] * keep + biasHalf;
+    }
+    float z[3];
+    z[0] = depth - depthBias;
+
+    // Compute a Cholesky factorization of the Hankel matrix B storing only non-
+    // trivial entries or related products
+    float L32D22 = b[2] - b[0] * b[1];
+    float D22 = b[1] - b[0] * b[0];
+    float squaredDepthVariance = b[3] - b[1] * b[1];
+    float D33D22 = squaredDepthVariance * D22 - L32D22 * L32D22;
+    float InvD22 = 1.0f / D22;
+    float L32 = L32D22 * InvD22;
+
+    // Obtain a scaled inverse image of bz = (1,z[0],z[0]*z[0])^T
+    float c[3] = { 1.0f, z[0], z[0] * z[0] };
+
+    // Forward substitution to solve L*c1=bz
+    c[1] = c[1] - b[0];
+    c[2] = c[2] - (b[1] + L32 * c[1]);
+
+    // Scaling to solve D*c2=c1
+    c[1] = c[1] * InvD22;
+    c[2] = c[2] * (D22 / D33D22);
+
+    // Backward substitution to solve L^T*c3=c2
+    c[1] = c[1] - L32 * c[2];
+    c[0] = c[0] - (c[1] * b[0] + c[2] * b[1]);
+
+    // Solve the quadratic equation c[0]+c[1]*z+c[2]*z^2 to obtain solutions
+    // z[1] and z[2]
+    float p = c[1] / c[2];
+    float q = c[0] / c[2];
+    float D = (p * p * 0.25f) - q;
+    float r = std::sqrt(D);
+    z[1] = (0.0f - p) * 0.5f - r;
+    z[2] = (0.0f - p) * 0.5f + r;
+
+    // Compute the shadow intensity by summing the appropriate weights
+    // (all terms are evaluated like the SIMD kernels, NaNs included)
+    bool farRoot = z[2] < z[0];
+    bool nearRoot = !farRoot && z[1] < z[0];
+    float switchVal[4] = {
+        farRoot ? z[1] : (nearRoot ? z[0] : 0.0f),
+        farRoot ? z[0] : (nearRoot ? z[1] : 0.0f),
+        farRoot ? 1.0f : 0.0f,
+        (farRoot || nearRoot) ? 1.0f : 0.0f };
+    float quotient = (switchVal[0] * z[2] - b[0] * (switchVal[0] + z[2]) + b[1]) / ((z[2] - switchVal[1]) * (z[0] - z[1]));
+    float shadowIntensity = switchVal[2] + switchVal[3] * quotient;
+    return 1.0f - clampIntensity(shadowIntensity);
+}
+
+void MomentEvaluator::evaluate(const glm::vec4* moments, const float* depths, float* result, size_t count) const
+{
+    size_t done = 0;
+#if defined(MSM_X86)
+    if (kernel == AVX2) {
+        done = count & ~size_t(7);
+        evaluateAVX2(moments, depths, result, done, depthBias, momentBias);
+    }
+    else if (kernel == SSE) {
+        done = count & ~size_t(3);
+        evaluateSSE(moments, depths, result, done, depthBias, momentBias);
+    }
+#endif
+    for (size_t i = done; i < count; i++) {
+        result[i] = evaluate(moments[i], depths[i], depthBias, momentBias);
+    }
+}
+
+void MomentEvaluator::setKernel(Kernel kernel_)
+{
+    kernel = isSupported(kernel_) ? kernel_ : bestKernel();
+}
+
+bool MomentEvaluator::isSupported(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case SCALAR:
+        return true;
+#if defined(MSM_X86)
+    case SSE:
+        return true;  // baseline of every x86-64 CPU
+    case AVX2:
+        return cpuHasAVX2();
+#endif
+    default:
+        return false;
+    }
+}
+
+MomentEvaluator::Kernel MomentEvaluator::bestKernel()
+{
+    if (isSupported(AVX2)) {
+        return AVX2;
+    }
+    return isSupported(SSE) ? SSE : SCALAR;
+}
+
+const char* MomentEvaluator::kernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case AVX2:
+        return "AVX2";
+    case SSE:
+        return "SSE";
+    default:
+        return "scalar";
+    }
+}
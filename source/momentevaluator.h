@@ -0,0 +1,42 @@
+#ifndef _MOMENT_EVALUATOR_H_
+#define _MOMENT_EVALUATOR_H_
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// CPU version of calculateMSMHamburger() from deferredShading.glsl: the Hamburger 4MSM
+// shadow term of (moments, depth) pairs, for tools and for checking the shader math.
+// Batches are evaluated 8 (AVX2) or 4 (SSE) pairs at a time with a scalar loop for the rest.
+// All kernels perform the same IEEE operations in the same order (the shader's fma() is
+// evaluated as multiply + add), so they agree bit for bit with the scalar reference.
+// Degenerate moments that produce NaNs (no moment bias, negative discriminant) return 1.0.
+class MomentEvaluator
+{
+public:
+    enum Kernel { SCALAR = 0, SSE = 1, AVX2 = 2 };
+
+    // uses the widest kernel the CPU supports
+    MomentEvaluator(float depthBias = 0.0f, float momentBias = 0.0003f);
+
+    // scalar reference, returns 1.0 for lit and 0.0 for fully shadowed like the shader
+    static float evaluate(const glm::vec4& moments, float depth, float depthBias, float momentBias);
+    // evaluate count pairs into result (moments are canonical, see convertOptimizedMoments)
+    void evaluate(const glm::vec4* moments, const float* depths, float* result, size_t count) const;
+
+    // pick a kernel, falls back to the best supported one
+    void setKernel(Kernel kernel_);
+    Kernel getKernel() const { return kernel; }
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+    static const char* kernelName(Kernel kernel);
+
+private:
+    Kernel kernel;
+    float depthBias;
+    float momentBias;
+
+};
+
+
+#endif
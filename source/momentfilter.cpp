@@ -0,0 +1,157 @@
+#include "momentfilter.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MSM_X86 1
+#include <immintrin.h>
+#endif
+
+// the reference only matches bit for bit if no multiply + add gets fused
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace
+{
+    // transpose block edge in texels (2 x 4 KB of vec4s stay in L1)
+    const int TRANSPOSE_BLOCK = 16;
+
+    // all 4 moments of a texel in one register, float lanes otherwise
+#if defined(MSM_X86)
+    typedef __m128 Texel;
+    inline Texel loadTexel(const glm::vec4& value) { return _mm_loadu_ps(&value[0]); }
+    inline void storeTexel(glm::vec4& target, Texel value) { _mm_storeu_ps(&target[0], value); }
+    inline Texel addTexel(Texel a, Texel b) { return _mm_add_ps(a, b); }
+    inline Texel subTexel(Texel a, Texel b) { return _mm_sub_ps(a, b); }
+    inline Texel scaleTexel(Texel a, float scale) { return _mm_mul_ps(a, _mm_set1_ps(scale)); }
+#else
+    struct Texel { float v[4]; };
+    inline Texel loadTexel(const glm::vec4& value) { Texel t = { { value[0], value[1], value[2], value[3] } }; return t; }
+    inline void storeTexel(glm::vec4& target, Texel value) { for (int c = 0; c < 4; c++) target[c] = value.v[c]; }
+    inline Texel addTexel(Texel a, Texel b) { for (int c = 0; c < 4; c++) a.v[c] += b.v[c]; return a; }
+    inline Texel subTexel(Texel a, Texel b) { for (int c = 0; c < 4; c++) a.v[c] -= b.v[c]; return a; }
+    inline Texel scaleTexel(Texel a, float scale) { for (int c = 0; c < 4; c++) a.v[c] *= scale; return a; }
+#endif
+
+    // one moving average pass over a row of n texels, same window updates as ComputeH
+    void slideRow(const glm::vec4* src, glm::vec4* dst, int n, int kernelHalf, float recKernelSize)
+    {
+        Texel sum = scaleTexel(loadTexel(src[0]), float(kernelHalf));
+        // texels past the row end are image loads out of bounds on the GPU, they add zero
+        for (int x = 0; x <= kernelHalf && x < n; x++) {
+            sum = addTexel(sum, loadTexel(src[x]));
+        }
+        for (int x = 0; x < n; x++)
+        {
+            storeTexel(dst[x], scaleTexel(sum, recKernelSize));
+            sum = subTexel(sum, loadTexel(src[std::max(x - kernelHalf, 0)]));
+            sum = addTexel(sum, loadTexel(src[std::min(x + kernelHalf + 1, n - 1)]));
+        }
+    }
+
+    // scalar port of one ComputeH (stride 1) or ComputeV (stride width) dispatch
+    void referencePass(const glm::vec4* src, glm::vec4* dst, int lines, int n, int lineStride, int texelStride, int kernelSize)
+    {
+        int kernelHalf = kernelSize / 2;
+        float recKernelSize = 1.0f / float(kernelSize);
+        for (int line = 0; line < lines; line++)
+        {
+            const glm::vec4* in = src + line * lineStride;
+            glm::vec4* out = dst + line * lineStride;
+            float sum[4];
+            for (int c = 0; c < 4; c++) {
+                sum[c] = in[0][c] * float(kernelHalf);
+            }
+            for (int x = 0; x <= kernelHalf && x < n; x++) {
+                for (int c = 0; c < 4; c++) {
+                    sum[c] += in[x * texelStride][c];
+                }
+            }
+            for (int x = 0; x < n; x++)
+            {
+                const glm::vec4& leftBorder = in[std::max(x - kernelHalf, 0) * texelStride];
+                const glm::vec4& rightBorder = in[std::min(x + kernelHalf + 1, n - 1) * texelStride];
+                for (int c = 0; c < 4; c++)
+                {
+                    out[x * texelStride][c] = sum[c] * recKernelSize;
+                    sum[c] -= leftBorder[c];
+                    sum[c] += rightBorder[c];
+                }
+            }
+        }
+    }
+}
+
+MomentFilter::MomentFilter(int threads)
+    :
+    pool(threads)
+{
+}
+
+void MomentFilter::blurRows(glm::vec4* image, int rowLength, int begin, int end, int kernelSize) const
+{
+    std::vector<glm::vec4> scratch(rowLength);
+    int kernelHalf = kernelSize / 2;
+    float recKernelSize = 1.0f / float(kernelSize);
+    for (int row = begin; row < end; row++)
+    {
+        glm::vec4* line = image + size_t(row) * rowLength;
+        slideRow(line, &scratch[0], rowLength, kernelHalf, recKernelSize);
+        slideRow(&scratch[0], line, rowLength, kernelHalf, recKernelSize);
+    }
+}
+
+void MomentFilter::transpose(const glm::vec4* src, glm::vec4* dst, int width, int height)
+{
+    int blockRows = (height + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+    pool.parallelFor(blockRows, [&](int begin, int end) {
+        for (int blockY = begin * TRANSPOSE_BLOCK; blockY < std::min(end * TRANSPOSE_BLOCK, height); blockY += TRANSPOSE_BLOCK)
+        {
+            int yEnd = std::min(blockY + TRANSPOSE_BLOCK, height);
+            for (int blockX = 0; blockX < width; blockX += TRANSPOSE_BLOCK)
+            {
+                int xEnd = std::min(blockX + TRANSPOSE_BLOCK, width);
+                for (int y = blockY; y < yEnd; y++) {
+                    for (int x = blockX; x < xEnd; x++) {
+                        dst[size_t(x) * height + y] = src[size_t(y) * width + x];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void MomentFilter::blur(glm::vec4* moments, int width, int height, int kernelSize)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    // Horizontal
+    pool.parallelFor(height, [&](int begin, int end) {
+        blurRows(moments, width, begin, end, kernelSize);
+    });
+
+    // Vertical, columns become rows of the transposed image
+    transposed.resize(size_t(width) * height);
+    transpose(moments, &transposed[0], width, height);
+    pool.parallelFor(width, [&](int begin, int end) {
+        blurRows(&transposed[0], height, begin, end, kernelSize);
+    });
+    transpose(&transposed[0], moments, height, width);
+}
+
+void MomentFilter::blurReference(glm::vec4* moments, int width, int height, int kernelSize)
+{
+    std::vector<glm::vec4> other(size_t(width) * height);
+    // Horizontal: H1 into the second image and H2 back
+    referencePass(moments, &other[0], height, width, width, 1, kernelSize);
+    referencePass(&other[0], moments, height, width, width, 1, kernelSize);
+    // Vertical: V1 and V2 walk the columns
+    referencePass(moments, &other[0], width, height, 1, width, kernelSize);
+    referencePass(&other[0], moments, width, height, 1, width, kernelSize);
+}
@@ -0,0 +1,42 @@
+#ifndef _MOMENT_FILTER_H_
+#define _MOMENT_FILTER_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "threadpool.h"
+
+// CPU version of the blurCompute.glsl chain for baking and inspecting shadow maps offline:
+// two horizontal then two vertical moving average box filters over a width x height image of
+// 4 float moments, with the shader's edge clamping (sum over the clamped texel indices).
+// Rows are split across a thread pool and the 4 moments of a texel share one SSE register.
+// The vertical passes run as horizontal ones on a cache-blocked transpose of the image.
+// Every texel sees the same float operations in the same order as blurReference(), so the
+// results are bit-identical to it whatever the thread count.
+class MomentFilter
+{
+public:
+    // threads == 0 uses every hardware thread
+    explicit MomentFilter(int threads = 0);
+
+    // filter the moments in place with a kernelSize x kernelSize box (odd sizes like computeShaderKernel[])
+    void blur(glm::vec4* moments, int width, int height, int kernelSize);
+    // single threaded scalar reference, a literal port of the ComputeH/ComputeV sliding windows
+    static void blurReference(glm::vec4* moments, int width, int height, int kernelSize);
+
+    int getThreadCount() const { return pool.getThreadCount(); }
+
+private:
+    // both horizontal passes over rows [begin, end) of a rowLength wide image
+    void blurRows(glm::vec4* image, int rowLength, int begin, int end, int kernelSize) const;
+    // dst (height x width) = transpose of src (width x height), in parallel over texel blocks
+    void transpose(const glm::vec4* src, glm::vec4* dst, int width, int height);
+
+    ThreadPool pool;
+    std::vector<glm::vec4> transposed;   // scratch image of the vertical passes
+
+};
+
+
+#endif
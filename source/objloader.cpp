@@ -0,0 +1,699 @@
+#include "objloader.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    // 1-based OBJ indices of one face corner, 0 when the attribute is missing
+    struct Corner
+    {
+        int position;
+        int texCoords;
+        int normal;
+        bool operator==(const Corner& other) const
+        {
+            return position == other.position && texCoords == other.texCoords && normal == other.normal;
+        }
+    };
+
+    struct CornerHash
+    {
+        size_t operator()(const Corner& corner) const
+        {
+            unsigned long long hash = (unsigned long long)(unsigned)corner.position * 0x9E3779B97F4A7C15ULL;
+            hash ^= ((unsigned long long)(unsigned)corner.texCoords << 32 | (unsigned)corner.normal) * 0xC2B2AE3D27D4EB4FULL;
+            return size_t(hash ^ (hash >> 29));
+        }
+    };
+
+    enum LineType
+    {
+        LINE_OTHER,
+        LINE_POSITION,
+        LINE_TEXCOORDS,
+        LINE_NORMAL,
+        LINE_FACE
+    };
+
+    // the text is [cursor, end), a mapped file has no terminating zero
+    const char* skipSpaces(const char* cursor, const char* end)
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+            cursor++;
+        }
+        return cursor;
+    }
+
+    const char* nextLine(const char* cursor, const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', size_t(end - cursor)));
+        return newline != NULL ? newline + 1 : end;
+    }
+
+    bool atLineEnd(const char* cursor, const char* end)
+    {
+        return cursor == end || *cursor == '\0' || *cursor == '\r' || *cursor == '\n';
+    }
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    // kind of the line at cursor (spaces skipped), the data starts at the returned position
+    LineType lineType(const char*& cursor, const char* end)
+    {
+        cursor = skipSpaces(cursor, end);
+        if (end - cursor < 2) {
+            return LINE_OTHER;
+        }
+        if (cursor[0] == 'v')
+        {
+            if (isSpace(cursor[1])) {
+                cursor += 1;
+                return LINE_POSITION;
+            }
+            if (cursor[1] == 't') {
+                cursor += 2;
+                return LINE_TEXCOORDS;
+            }
+            if (cursor[1] == 'n') {
+                cursor += 2;
+                return LINE_NORMAL;
+            }
+        }
+        else if (cursor[0] == 'f' && isSpace(cursor[1])) {
+            cursor += 1;
+            return LINE_FACE;
+        }
+        return LINE_OTHER;
+    }
+
+    // reference number parsing: strtof on zero terminated text
+    struct ReferenceFloat
+    {
+        static const char* parse(const char* cursor, const char*, float& value)
+        {
+            char* end;
+            value = std::strtof(cursor, &end);
+            return end;
+        }
+    };
+
+    // A decimal number whose digits fit in 24 bits is exact as a float, and so are the powers of
+    // ten up to 1e10, so with a small exponent one float multiply or divide rounds it exactly like
+    // strtof does. Everything else (more digits, inf, hex, ...) goes to strtof.
+    struct FastFloat
+    {
+        static const char* parse(const char* cursor, const char* end, float& value)
+        {
+            static const float powersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+            const char* start = cursor;
+            bool negative = false;
+            if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                negative = *cursor == '-';
+                cursor++;
+            }
+            unsigned int mantissa = 0;
+            int exponent = 0;
+            bool digits = false;
+            bool exact = true;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9')
+            {
+                if (mantissa < 100000000u) {
+                    mantissa = mantissa * 10 + unsigned(*cursor - '0');
+                }
+                else {
+                    exact = false;
+                }
+                digits = true;
+                cursor++;
+            }
+            if (cursor < end && *cursor == '.')
+            {
+                cursor++;
+                while (cursor < end && *cursor >= '0' && *cursor <= '9')
+                {
+                    if (mantissa < 100000000u) {
+                        mantissa = mantissa * 10 + unsigned(*cursor - '0');
+                        exponent--;
+                    }
+                    else {
+                        exact = false;
+                    }
+                    digits = true;
+                    cursor++;
+                }
+            }
+            if (digits && cursor < end && (*cursor == 'e' || *cursor == 'E'))
+            {
+                const char* mark = cursor++;
+                bool negativeExponent = false;
+                if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                    negativeExponent = *cursor == '-';
+                    cursor++;
+                }
+                int written = 0;
+                bool exponentDigits = false;
+                while (cursor < end && *cursor >= '0' && *cursor <= '9')
+                {
+                    written = std::min(written * 10 + (*cursor - '0'), 10000);
+                    exponentDigits = true;
+                    cursor++;
+                }
+                if (exponentDigits) {
+                    exponent += negativeExponent ? -written : written;
+                }
+                else {
+                    cursor = mark;
+                }
+            }
+
+            bool delimited = cursor == end || isSpace(*cursor) || *cursor == '\r' || *cursor == '\n';
+            if (digits && exact && delimited && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+            {
+                float magnitude = float(mantissa);
+                magnitude = exponent < 0 ? magnitude / powersOfTen[-exponent] : magnitude * powersOfTen[exponent];
+                value = negative ? -magnitude : magnitude;
+                return cursor;
+            }
+
+            // zero terminated copy of the token for strtof
+            const char* tokenEnd = start;
+            while (tokenEnd < end && !isSpace(*tokenEnd) && *tokenEnd != '\r' && *tokenEnd != '\n') {
+                tokenEnd++;
+            }
+            std::string token(start, tokenEnd);
+            char* parsedEnd;
+            value = std::strtof(token.c_str(), &parsedEnd);
+            return start + (parsedEnd - token.c_str());
+        }
+    };
+
+    // up to count floats of this line, missing ones stay 0 (strtof alone would skip the newline)
+    template <typename FloatParser>
+    void parseFloats(const char* cursor, const char* end, float* values, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            cursor = skipSpaces(cursor, end);
+            if (atLineEnd(cursor, end)) {
+                break;
+            }
+            const char* parsed = FloatParser::parse(cursor, end, values[i]);
+            if (parsed == cursor) {
+                break;
+            }
+            cursor = parsed;
+        }
+    }
+
+    // decimal integer with an optional sign, saturated far beyond any valid index
+    bool parseInteger(const char*& cursor, const char* end, long long& value)
+    {
+        const char* start = cursor;
+        bool negative = false;
+        if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+            negative = *cursor == '-';
+            cursor++;
+        }
+        const char* digits = cursor;
+        value = 0;
+        while (cursor < end && *cursor >= '0' && *cursor <= '9')
+        {
+            value = std::min(value * 10 + (*cursor - '0'), (long long)INT_MAX * 4);
+            cursor++;
+        }
+        if (cursor == digits) {
+            cursor = start;
+            return false;
+        }
+        value = negative ? -value : value;
+        return true;
+    }
+
+    // relative (negative) indices count back from the last element read so far
+    int resolveIndex(long long index, size_t count)
+    {
+        if (index < 0) {
+            index += (long long)count + 1;
+        }
+        return index > 0 && (unsigned long long)index <= count ? int(index) : 0;
+    }
+
+    // one "v", "v/t", "v//n" or "v/t/n" token, false at the end of the face; the counts are the
+    // elements read before this line
+    bool parseCorner(const char*& cursor, const char* end, size_t positions, size_t texCoords, size_t normals, Corner& corner)
+    {
+        cursor = skipSpaces(cursor, end);
+        long long index;
+        if (atLineEnd(cursor, end) || !parseInteger(cursor, end, index)) {
+            return false;
+        }
+        corner.position = resolveIndex(index, positions);
+        corner.texCoords = 0;
+        corner.normal = 0;
+        if (cursor < end && *cursor == '/')
+        {
+            cursor++;
+            if (parseInteger(cursor, end, index)) {
+                corner.texCoords = resolveIndex(index, texCoords);
+            }
+            if (cursor < end && *cursor == '/') {
+                cursor++;
+                if (parseInteger(cursor, end, index)) {
+                    corner.normal = resolveIndex(index, normals);
+                }
+            }
+        }
+        // skip whatever malformed rest the token has
+        while (!atLineEnd(cursor, end) && !isSpace(*cursor)) {
+            cursor++;
+        }
+        return corner.position != 0;
+    }
+
+    MeshVertex makeVertex(const Corner& corner, const glm::vec3* positions, const glm::vec2* texCoords, const glm::vec3* normals)
+    {
+        MeshVertex vertex;
+        vertex.position = positions[corner.position - 1];
+        vertex.normal = corner.normal != 0 ? normals[corner.normal - 1] : glm::vec3(0.0f);
+        vertex.texCoords = corner.texCoords != 0 ? texCoords[corner.texCoords - 1] : glm::vec2(0.0f);
+        vertex.texCoords.y = 1.0f - vertex.texCoords.y;
+        return vertex;
+    }
+
+    // smooth over the position, not the vertex, so texture seams don't show up as creases;
+    // the sums run in index order, the same for both importers
+    void generateNormals(MeshData& mesh, size_t positionCount, const std::vector<int>& vertexPositions, const std::vector<unsigned char>& generatedNormals)
+    {
+        std::vector<glm::vec3> positionNormals(positionCount, glm::vec3(0.0f));
+        for (size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            const glm::vec3& a = mesh.vertices[mesh.indices[i]].position;
+            const glm::vec3& b = mesh.vertices[mesh.indices[i + 1]].position;
+            const glm::vec3& c = mesh.vertices[mesh.indices[i + 2]].position;
+            glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            for (int corner = 0; corner < 3; corner++) {
+                positionNormals[vertexPositions[mesh.indices[i + corner]]] += faceNormal;
+            }
+        }
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            glm::vec3 sum = positionNormals[vertexPositions[i]];
+            float length = glm::length(sum);
+            if (generatedNormals[i] && length > 0.0f) {
+                mesh.vertices[i].normal = sum / length;
+            }
+        }
+    }
+
+    void computeBounds(MeshData& mesh)
+    {
+        mesh.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        mesh.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            mesh.boundsMin = glm::min(mesh.boundsMin, mesh.vertices[i].position);
+            mesh.boundsMax = glm::max(mesh.boundsMax, mesh.vertices[i].position);
+        }
+    }
+}
+
+bool loadObj(const std::string& fileName, MeshData& mesh)
+{
+    std::string text;
+    {
+        std::ifstream file(fileName.c_str(), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        text = contents.str();
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<int> vertexPositions;              // OBJ position of every vertex, for generated normals
+    std::vector<unsigned char> generatedNormals;   // vertices whose corner had no normal
+    std::unordered_map<Corner, unsigned int, CornerHash> vertexOfCorner;
+    std::vector<unsigned int> polygon;
+    bool missingNormals = false;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    const char* cursor = text.c_str();
+    const char* end = cursor + text.size();
+    while (cursor < end)
+    {
+        const char* data = cursor;
+        switch (lineType(data, end))
+        {
+        case LINE_POSITION:
+            positions.push_back(glm::vec3(0.0f));
+            parseFloats<ReferenceFloat>(data, end, &positions.back()[0], 3);
+            break;
+        case LINE_TEXCOORDS:
+            texCoords.push_back(glm::vec2(0.0f));
+            parseFloats<ReferenceFloat>(data, end, &texCoords.back()[0], 2);
+            break;
+        case LINE_NORMAL:
+            normals.push_back(glm::vec3(0.0f));
+            parseFloats<ReferenceFloat>(data, end, &normals.back()[0], 3);
+            break;
+        case LINE_FACE:
+        {
+            polygon.clear();
+            Corner corner;
+            while (parseCorner(data, end, positions.size(), texCoords.size(), normals.size(), corner))
+            {
+                std::unordered_map<Corner, unsigned int, CornerHash>::iterator found = vertexOfCorner.find(corner);
+                if (found == vertexOfCorner.end())
+                {
+                    found = vertexOfCorner.insert(std::make_pair(corner, unsigned(mesh.vertices.size()))).first;
+                    mesh.vertices.push_back(makeVertex(corner, &positions[0], texCoords.empty() ? NULL : &texCoords[0], normals.empty() ? NULL : &normals[0]));
+                    vertexPositions.push_back(corner.position - 1);
+                    generatedNormals.push_back(corner.normal == 0);
+                    missingNormals |= corner.normal == 0;
+                }
+                polygon.push_back(found->second);
+            }
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        cursor = nextLine(cursor, end);
+    }
+    if (mesh.indices.empty()) {
+        mesh.vertices.clear();
+        return false;
+    }
+
+    if (missingNormals) {
+        generateNormals(mesh, positions.size(), vertexPositions, generatedNormals);
+    }
+    computeBounds(mesh);
+    return true;
+}
+
+namespace
+{
+    // a line aligned piece of the file and what parsing it produced
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+        // v, vt and vn lines of the chunk, then the ones of all chunks before it
+        size_t counts[3];
+        size_t bases[3];
+        std::vector<Corner> corners;            // face corners in file order
+        std::vector<unsigned int> polygonSizes; // corners of every face line
+        size_t triangleCount;
+        size_t cornerBase;                      // global number of the first corner
+        size_t vertexBase;                      // vertices created by the chunks before
+        size_t indexBase;
+    };
+
+    // slot of the lock-free corner map; position 0 marks a free slot, -1 one being filled
+    struct CornerSlot
+    {
+        std::atomic<int> position;
+        int texCoords;
+        int normal;
+        std::atomic<unsigned int> first;        // lowest corner number seen with this triple
+        unsigned int vertex;
+    };
+
+    // first slot of the triple, inserting it (the caller lowers first)
+    unsigned int findOrInsert(CornerSlot* slots, size_t mask, const Corner& corner)
+    {
+        size_t slot = CornerHash()(corner) & mask;
+        while (true)
+        {
+            CornerSlot& entry = slots[slot];
+            int position = entry.position.load(std::memory_order_acquire);
+            if (position == 0)
+            {
+                if (entry.position.compare_exchange_strong(position, -1, std::memory_order_acquire))
+                {
+                    entry.texCoords = corner.texCoords;
+                    entry.normal = corner.normal;
+                    entry.position.store(corner.position, std::memory_order_release);
+                    return unsigned(slot);
+                }
+            }
+            // another thread is writing the slot, its triple is needed to decide
+            while (position == -1)
+            {
+                std::this_thread::yield();
+                position = entry.position.load(std::memory_order_acquire);
+            }
+            if (position == corner.position && entry.texCoords == corner.texCoords && entry.normal == corner.normal) {
+                return unsigned(slot);
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    void lowerTo(std::atomic<unsigned int>& value, unsigned int candidate)
+    {
+        unsigned int current = value.load(std::memory_order_relaxed);
+        while (candidate < current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+        }
+    }
+
+    // chunks of at least this many bytes, smaller files are parsed by fewer threads
+    const size_t MIN_CHUNK_BYTES = 256 * 1024;
+}
+
+ObjImporter::ObjImporter(int threads)
+    :
+    pool(threads)
+{
+}
+
+bool ObjImporter::load(const std::string& fileName, MeshData& mesh)
+{
+    MappedFile file(fileName);
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    if (!file.isOpen()) {
+        return false;
+    }
+    const char* text = file.bytes();
+    const char* textEnd = text + file.length();
+
+    // cut on line boundaries, a few chunks per thread
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size_t(pool.getThreadCount()) * 8, file.length() / MIN_CHUNK_BYTES));
+    std::vector<ObjChunk> chunks;
+    const char* chunkBegin = text;
+    for (size_t i = 1; i <= chunkCount && chunkBegin < textEnd; i++)
+    {
+        const char* chunkEnd = i == chunkCount ? textEnd : nextLine(std::max(chunkBegin, text + file.length() * i / chunkCount), textEnd);
+        ObjChunk chunk = ObjChunk();
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.push_back(chunk);
+        chunkBegin = chunkEnd;
+    }
+    const int chunkTotal = int(chunks.size());
+
+    // 1. count the v, vt and vn lines so every chunk knows where its elements go
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            ObjChunk& chunk = chunks[c];
+            chunk.counts[0] = chunk.counts[1] = chunk.counts[2] = 0;
+            for (const char* cursor = chunk.begin; cursor < chunk.end; cursor = nextLine(cursor, chunk.end))
+            {
+                const char* data = cursor;
+                LineType type = lineType(data, chunk.end);
+                if (type >= LINE_POSITION && type <= LINE_NORMAL) {
+                    chunk.counts[type - LINE_POSITION]++;
+                }
+            }
+        }
+    });
+    size_t totals[3] = { 0, 0, 0 };
+    for (ObjChunk& chunk : chunks)
+    {
+        for (int i = 0; i < 3; i++) {
+            chunk.bases[i] = totals[i];
+            totals[i] += chunk.counts[i];
+        }
+    }
+    std::vector<glm::vec3> positions(totals[0]);
+    std::vector<glm::vec2> texCoords(totals[1]);
+    std::vector<glm::vec3> normals(totals[2]);
+
+    // 2. parse the elements into their global slots and collect the face corners,
+    //    indices are resolved against the elements read before the face like loadObj() does
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            ObjChunk& chunk = chunks[c];
+            size_t read[3] = { chunk.bases[0], chunk.bases[1], chunk.bases[2] };
+            chunk.triangleCount = 0;
+            for (const char* cursor = chunk.begin; cursor < chunk.end; cursor = nextLine(cursor, chunk.end))
+            {
+                const char* data = cursor;
+                switch (lineType(data, chunk.end))
+                {
+                case LINE_POSITION:
+                    parseFloats<FastFloat>(data, chunk.end, &positions[read[0]++][0], 3);
+                    break;
+                case LINE_TEXCOORDS:
+                    parseFloats<FastFloat>(data, chunk.end, &texCoords[read[1]++][0], 2);
+                    break;
+                case LINE_NORMAL:
+                    parseFloats<FastFloat>(data, chunk.end, &normals[read[2]++][0], 3);
+                    break;
+                case LINE_FACE:
+                {
+                    size_t first = chunk.corners.size();
+                    Corner corner;
+                    while (parseCorner(data, chunk.end, read[0], read[1], read[2], corner)) {
+                        chunk.corners.push_back(corner);
+                    }
+                    unsigned int size = unsigned(chunk.corners.size() - first);
+                    chunk.polygonSizes.push_back(size);
+                    chunk.triangleCount += size > 2 ? size - 2 : 0;
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+        }
+    });
+    size_t cornerTotal = 0;
+    size_t triangleTotal = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.cornerBase = cornerTotal;
+        chunk.indexBase = triangleTotal * 3;
+        cornerTotal += chunk.corners.size();
+        triangleTotal += chunk.triangleCount;
+    }
+    // slot and corner numbers are 32 bit, far more than any scan that fits in memory
+    if (triangleTotal == 0 || cornerTotal > UINT_MAX / 2) {
+        return false;
+    }
+
+    // 3. one slot per distinct corner triple, remembering the first corner that used it
+    size_t slotCount = 1024;
+    while (slotCount < cornerTotal + cornerTotal / 2) {
+        slotCount *= 2;
+    }
+    std::unique_ptr<CornerSlot[]> slots(new CornerSlot[slotCount]);
+    pool.parallelFor(int(slotCount / 1024), [&](int begin, int end) {
+        for (size_t i = size_t(begin) * 1024; i < size_t(end) * 1024; i++)
+        {
+            slots[i].position.store(0, std::memory_order_relaxed);
+            slots[i].first.store(UINT_MAX, std::memory_order_relaxed);
+        }
+    });
+    std::vector<unsigned int> cornerSlots(cornerTotal);
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            const ObjChunk& chunk = chunks[c];
+            for (size_t i = 0; i < chunk.corners.size(); i++)
+            {
+                unsigned int slot = findOrInsert(slots.get(), slotCount - 1, chunk.corners[i]);
+                cornerSlots[chunk.cornerBase + i] = slot;
+                lowerTo(slots[slot].first, unsigned(chunk.cornerBase + i));
+            }
+        }
+    });
+
+    // 4. the first corners of the triples become the vertices, numbered in file order
+    std::vector<size_t> chunkVertices(chunks.size());
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            const ObjChunk& chunk = chunks[c];
+            size_t count = 0;
+            for (size_t i = 0; i < chunk.corners.size(); i++) {
+                count += slots[cornerSlots[chunk.cornerBase + i]].first.load(std::memory_order_relaxed) == chunk.cornerBase + i;
+            }
+            chunkVertices[c] = count;
+        }
+    });
+    size_t vertexTotal = 0;
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        chunks[c].vertexBase = vertexTotal;
+        vertexTotal += chunkVertices[c];
+    }
+    mesh.vertices.resize(vertexTotal);
+    std::vector<int> vertexPositions(vertexTotal);
+    std::vector<unsigned char> generatedNormals(vertexTotal);
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            const ObjChunk& chunk = chunks[c];
+            size_t vertex = chunk.vertexBase;
+            for (size_t i = 0; i < chunk.corners.size(); i++)
+            {
+                CornerSlot& slot = slots[cornerSlots[chunk.cornerBase + i]];
+                if (slot.first.load(std::memory_order_relaxed) != chunk.cornerBase + i) {
+                    continue;
+                }
+                const Corner& corner = chunk.corners[i];
+                slot.vertex = unsigned(vertex);
+                mesh.vertices[vertex] = makeVertex(corner, &positions[0], texCoords.empty() ? NULL : &texCoords[0], normals.empty() ? NULL : &normals[0]);
+                vertexPositions[vertex] = corner.position - 1;
+                generatedNormals[vertex] = corner.normal == 0;
+                vertex++;
+            }
+        }
+    });
+
+    // 5. triangle fans of every face
+    mesh.indices.resize(triangleTotal * 3);
+    pool.parallelFor(chunkTotal, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+        {
+            const ObjChunk& chunk = chunks[c];
+            const unsigned int* cornerSlot = &cornerSlots[0] + chunk.cornerBase;
+            unsigned int* index = &mesh.indices[0] + chunk.indexBase;
+            for (unsigned int size : chunk.polygonSizes)
+            {
+                for (unsigned int i = 2; i < size; i++)
+                {
+                    *index++ = slots[cornerSlot[0]].vertex;
+                    *index++ = slots[cornerSlot[i - 1]].vertex;
+                    *index++ = slots[cornerSlot[i]].vertex;
+                }
+                cornerSlot += size;
+            }
+        }
+    });
+
+    if (std::find(generatedNormals.begin(), generatedNormals.end(), 1) != generatedNormals.end()) {
+        generateNormals(mesh, positions.size(), vertexPositions, generatedNormals);
+    }
+    computeBounds(mesh);
+    return true;
+}
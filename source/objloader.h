@@ -0,0 +1,67 @@
+#ifndef _OBJ_LOADER_H_
+#define _OBJ_LOADER_H_
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+
+// interleaved vertex of the scene meshes: attribute 0 position, 1 normal, 2 texcoords
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+// a range of MeshData::indices drawing the mesh at one level of detail
+struct MeshLod
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;              // largest vertex distance to the original planes (see buildShadowLods()), object space units
+};
+
+// one indexed triangle list, the whole OBJ file merged into it
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> lods;    // empty after an import, see buildShadowLods()
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+// Wavefront OBJ import of the geometry only (v, vt, vn and f, groups and materials are ignored).
+// Polygons are split into triangle fans and every distinct position/texcoord/normal triple
+// becomes one vertex. Like the importer flags Model used, the v texcoord is flipped and
+// vertices without a normal get the area weighted normal of the faces sharing their position.
+// Returns false when the file can't be read or holds no triangles.
+// Single threaded reference with strtof, ObjImporter gives the same mesh faster.
+bool loadObj(const std::string& fileName, MeshData& mesh);
+
+// Parallel version of loadObj() for large scans. The mapped file is cut into chunks on line
+// boundaries: one pass counts the v/vt/vn lines of every chunk so each chunk knows the global
+// numbering, a second pass parses them with a float parser that only falls back to strtof for
+// numbers it can't round exactly. The face corners go through a lock-free hash map that keeps
+// the first occurrence of every position/texcoord/normal triple, which numbers the vertices in
+// the order loadObj() creates them, so the mesh is identical to it whatever the thread count.
+class ObjImporter
+{
+public:
+    // threads == 0 uses every hardware thread
+    explicit ObjImporter(int threads = 0);
+    // same contract as loadObj(), can be called from several threads at once
+    bool load(const std::string& fileName, MeshData& mesh);
+
+    int getThreadCount() const { return pool.getThreadCount(); }
+
+private:
+    ThreadPool pool;
+
+};
+
+
+#endif
@@ -0,0 +1,112 @@
+#include "pointlights.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// integer hash, bit-identical to lightHash() in pointLights.glsl
+static unsigned int lightHash(unsigned int value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+// 16 bits of the hash as a value in [0, 1]
+static float hashUnit(unsigned int value, int shift)
+{
+    return float((value >> shift) & 0xFFFFU) / 65535.0f;
+}
+
+PointLightGrid::PointLightGrid()
+    :
+    count(100),
+    spacing(1.0f),
+    yOffset(0.0f),
+    radius(1.0f),
+    time(0.0f),
+    amplitude(0.25f)
+{
+}
+
+int PointLightGrid::width() const
+{
+    return std::max(1, int(std::ceil(std::sqrt(float(count) / HEIGHT))));
+}
+
+glm::vec4 PointLightGrid::position(int light) const
+{
+    int gridWidth = width();
+    int lightIndexX = light / (gridWidth * HEIGHT);
+    int lightIndexZ = (light / HEIGHT) % gridWidth;
+    int lightIndexY = light % HEIGHT;
+    glm::vec3 position((lightIndexX - (gridWidth - 1.0f) / 2.0f) * spacing,
+                       (lightIndexY - (HEIGHT - 1.0f) / 2.0f) * spacing + yOffset,
+                       (lightIndexZ - (gridWidth - 1.0f) / 2.0f) * spacing);
+
+    // fixed random offset in the xz plane (up to half a unit)
+    unsigned int hash = lightHash(unsigned(light) * 2U);
+    float angle = hashUnit(hash, 0) * 2.0f * glm::pi<float>();
+    float length = hashUnit(hash, 16) * 0.5f;
+    position.x += std::cos(angle) * length;
+    position.z += std::sin(angle) * length;
+
+    // every light orbits its cell with its own phase
+    float phase = angle + time;
+    float orbit = amplitude * spacing;
+    position.x += std::cos(phase) * orbit;
+    position.y += std::sin(2.0f * phase) * orbit * 0.5f;
+    position.z += std::sin(phase) * orbit;
+    return glm::vec4(position, radius);
+}
+
+glm::vec4 PointLightGrid::color(int light) const
+{
+    unsigned int hash = lightHash(unsigned(light) * 2U + 1U);
+    // every channel between 0.5 and 1.0
+    return glm::vec4(0.5f + 0.5f * float(hash & 0x3FFU) / 1023.0f,
+                     0.5f + 0.5f * float((hash >> 10) & 0x3FFU) / 1023.0f,
+                     0.5f + 0.5f * float((hash >> 20) & 0x3FFU) / 1023.0f,
+                     1.0f);
+}
+
+void PointLightGrid::generate(std::vector<glm::vec4>& positions, std::vector<glm::vec4>& colors) const
+{
+    positions.resize(count);
+    colors.resize(count);
+    for (int light = 0; light < count; light++)
+    {
+        positions[light] = position(light);
+        colors[light] = color(light);
+    }
+}
+
+void PointLightGrid::nearbyLights(const glm::vec3& viewPos, std::vector<glm::vec4>& positions, std::vector<int>& indices) const
+{
+    positions.clear();
+    indices.clear();
+    int gridWidth = width();
+    // grid cell under the viewer, clamped so a viewer outside still finds the closest edge
+    int cellX = glm::clamp(int(std::floor(viewPos.x / spacing + (gridWidth - 1.0f) / 2.0f + 0.5f)), 0, gridWidth - 1);
+    int cellZ = glm::clamp(int(std::floor(viewPos.z / spacing + (gridWidth - 1.0f) / 2.0f + 0.5f)), 0, gridWidth - 1);
+    const int reach = 2;
+    for (int x = std::max(0, cellX - reach); x <= std::min(gridWidth - 1, cellX + reach); x++)
+    {
+        for (int z = std::max(0, cellZ - reach); z <= std::min(gridWidth - 1, cellZ + reach); z++)
+        {
+            for (int y = 0; y < HEIGHT; y++)
+            {
+                int light = x * gridWidth * HEIGHT + z * HEIGHT + y;
+                if (light < count)
+                {
+                    positions.push_back(position(light));
+                    indices.push_back(light);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef _POINT_LIGHTS_H_
+#define _POINT_LIGHTS_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Procedural layout of the scene's point lights.
+// The lights fill HEIGHT layers of a square grid that grows with the light count. Every
+// light gets a fixed jitter, color and animation phase from an integer hash of its index,
+// so the CPU (upload path, shadow selection) and the pointLights.Update compute shader
+// evaluate exactly the same light from the same few parameters.
+struct PointLightGrid
+{
+    static const int HEIGHT = 4;
+
+    PointLightGrid();
+    // lights per grid row, the grid is width x width x HEIGHT
+    int width() const;
+    // world position (xyz) and radius (w) of a light at the grid's animation time
+    glm::vec4 position(int light) const;
+    // color (rgb) of a light
+    glm::vec4 color(int light) const;
+    // fill the CPU copies of the light data
+    void generate(std::vector<glm::vec4>& positions, std::vector<glm::vec4>& colors) const;
+    // lights of the grid cells around viewPos (the only ones that can be the closest)
+    void nearbyLights(const glm::vec3& viewPos, std::vector<glm::vec4>& positions, std::vector<int>& indices) const;
+
+    int count;                    // number of lights
+    float spacing;                // distance between neighbouring grid cells
+    float yOffset;                // vertical offset of the whole grid
+    float radius;                 // radius of every light
+    float time;                   // animation time in seconds (the orbit phase)
+    float amplitude;              // animation orbit radius as a fraction of the spacing, 0 keeps the lights at their grid positions
+};
+
+
+#endif
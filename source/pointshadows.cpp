@@ -0,0 +1,134 @@
+#include "pointshadows.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+PointShadows::PointShadows(int size, GLenum format, const float borderColor[4])
+    :
+    size(size),
+    format(format),
+    count(0),
+    maxRadius(1.0f),
+    frame_id(0),
+    depth_id(0)
+{
+    for (int i = 0; i < 4; i++) {
+        border[i] = borderColor[i];
+    }
+    tex_ids[0] = tex_ids[1] = 0;
+
+    // same face orientation as the environment cubemap capture
+    faceViews[0] = glm::lookAt(glm::vec3(0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    faceViews[1] = glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    faceViews[2] = glm::lookAt(glm::vec3(0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f));
+    faceViews[3] = glm::lookAt(glm::vec3(0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f));
+    faceViews[4] = glm::lookAt(glm::vec3(0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    faceViews[5] = glm::lookAt(glm::vec3(0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+        lightPositions[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        lightIndices[i] = -1;
+    }
+}
+
+PointShadows::~PointShadows()
+{
+    if (frame_id != 0)
+    {
+        glDeleteFramebuffers(1, &frame_id);
+        glDeleteTextures(1, &depth_id);
+        glDeleteTextures(2, tex_ids);
+    }
+}
+
+void PointShadows::allocate()
+{
+    if (frame_id != 0) {
+        return;
+    }
+
+    const int layerFaces = 6 * MAX_SHADOWED_LIGHTS;
+    glGenTextures(2, tex_ids);
+    for (int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, tex_ids[i]);
+        glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, format, size, size, layerFaces);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    glGenTextures(1, &depth_id);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, depth_id);
+    glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT24, size, size, layerFaces);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+    // attaching whole arrays makes the FBO layered, gl_Layer then selects light * 6 + face
+    glGenFramebuffers(1, &frame_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_id);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex_ids[0], 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_id, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Point shadow FBO status error: " << status << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PointShadows::selectLights(const std::vector<glm::vec4>& sceneLights, const glm::vec3& viewPos, int maxLights, const std::vector<int>* sceneIndices)
+{
+    // the closest lights are the ones whose shadows are noticed the most
+    std::vector<std::pair<float, int>> byDistance;
+    byDistance.reserve(sceneLights.size());
+    for (size_t i = 0; i < sceneLights.size(); i++)
+    {
+        glm::vec3 offset = glm::vec3(sceneLights[i]) - viewPos;
+        byDistance.push_back(std::make_pair(glm::dot(offset, offset), int(i)));
+    }
+    count = std::max(0, std::min(std::min(maxLights, int(MAX_SHADOWED_LIGHTS)), int(byDistance.size())));
+    std::partial_sort(byDistance.begin(), byDistance.begin() + count, byDistance.end());
+
+    maxRadius = 0.0f;
+    for (int slot = 0; slot < count; slot++)
+    {
+        int light = byDistance[slot].second;
+        lightIndices[slot] = sceneIndices != NULL ? (*sceneIndices)[light] : light;
+        lightPositions[slot] = sceneLights[light];
+        maxRadius = std::max(maxRadius, sceneLights[light].w);
+    }
+    for (int slot = count; slot < MAX_SHADOWED_LIGHTS; slot++) {
+        lightIndices[slot] = -1;
+    }
+}
+
+void PointShadows::bindOutput()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_id);
+    glViewport(0, 0, size, size);
+    glClearColor(border[0], border[1], border[2], border[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void PointShadows::bindImage(unsigned unit, int num, GLenum access)
+{
+    glBindImageTexture(unit, tex_ids[num], 0, GL_TRUE, 0, access, format);
+}
+
+void PointShadows::bindTex()
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, tex_ids[0]);
+}
+
+double PointShadows::sizeInBytes() const
+{
+    double texelBytes = (format == GL_RGBA16) ? 8.0 : 16.0;
+    // two moment arrays plus the 24 bit depth array (stored as 32 bit)
+    return double(size) * double(size) * 6.0 * MAX_SHADOWED_LIGHTS * (2.0 * texelBytes + 4.0);
+}
@@ -0,0 +1,64 @@
+#ifndef _POINT_SHADOWS_H_
+#define _POINT_SHADOWS_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Omnidirectional moment shadow maps for a bounded number of point lights.
+// Every shadowed light owns 6 faces of a cube map array. All lights and faces are
+// rendered in a single layered pass: the casters are drawn instanced once per light and
+// a geometry shader routes each triangle to the 6 faces of its light through gl_Layer.
+// The moments hold the distance to the light normalized by the light's radius.
+class PointShadows
+{
+public:
+    static const int MAX_SHADOWED_LIGHTS = 8;
+
+    PointShadows(int size, GLenum format, const float borderColor[4]);
+    ~PointShadows();
+    // Create the cube map arrays and the layered FBO (done on first use)
+    void allocate();
+    // Pick up to maxLights lights closest to the viewer and assign them a cube map slot
+    // (sceneLights holds the world position (xyz) and radius (w) of every candidate light,
+    // sceneIndices their scene light index when the candidates are only a subset)
+    void selectLights(const std::vector<glm::vec4>& sceneLights, const glm::vec3& viewPos, int maxLights, const std::vector<int>* sceneIndices = NULL);
+    // Bind the layered FBO for writing and clear every face to the far plane moments
+    void bindOutput();
+    // Bind all faces of the nth cube map array as an image for compute filtering
+    void bindImage(unsigned unit, int num, GLenum access = GL_READ_WRITE);
+    // Bind the filtered moments for sampling in the point light pass
+    void bindTex();
+
+    int getSize() const { return size; }
+    // number of lights shadowed this frame
+    int getCount() const { return count; }
+    // world position (xyz) and radius (w) per shadowed light
+    const glm::vec4* getLightPositions() const { return lightPositions; }
+    // scene light index per cube map slot, the shaders search it for their light
+    const int* getLightIndices() const { return lightIndices; }
+    // view rotations of the 6 cube faces
+    const glm::mat4* getFaceViews() const { return faceViews; }
+    // largest radius among the shadowed lights (far plane of the cube projection)
+    float getMaxRadius() const { return maxRadius; }
+    // memory used by the cube map arrays
+    double sizeInBytes() const;
+
+private:
+    int size;                                   // width and height of every face
+    GLenum format;                              // moment storage format
+    float border[4];                            // moments of the far plane
+    int count;
+    float maxRadius;
+    GLuint frame_id;                            // layered FBO, 0 until allocated
+    GLuint depth_id;                            // depth cube map array for the z-test
+    GLuint tex_ids[2];                          // moments and the blur ping-pong target
+    glm::vec4 lightPositions[MAX_SHADOWED_LIGHTS];
+    glm::mat4 faceViews[6];
+    int lightIndices[MAX_SHADOWED_LIGHTS];
+
+};
+
+
+#endif
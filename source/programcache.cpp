@@ -0,0 +1,152 @@
+#include "programcache.h"
+#include "hashkey.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    // bump when the file layout changes
+    const unsigned int CACHE_VERSION = 1;
+
+    // 24 bytes in front of the driver's binary
+    struct CacheHeader
+    {
+        char magic[4];            // "MSPB"
+        unsigned int version;
+        unsigned long long key;
+        unsigned int binaryFormat;
+        unsigned int binaryLength;
+    };
+
+    std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value != NULL ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    }
+}
+
+ProgramCache::ProgramCache(const std::string& directory_)
+    :
+    directory(directory_),
+    supported(false),
+    hits(0),
+    misses(0),
+    rejects(0)
+{
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    supported = formats > 0;
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+}
+
+std::string ProgramCache::fileName(unsigned long long key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", key);
+    return directory + "/" + name;
+}
+
+unsigned long long ProgramCache::key(const char* const* sources, int count) const
+{
+    HashKey hash;
+    hash.add(driver.c_str(), driver.size());
+    for (int stage = 0; stage < count; stage++)
+    {
+        if (sources[stage] == NULL) {
+            continue;
+        }
+        // the stage slot and length keep (vertex, fragment) apart from (vertex, geometry)
+        size_t length = std::strlen(sources[stage]);
+        hash.add(stage);
+        hash.add(length);
+        hash.add(sources[stage], length);
+    }
+    return hash.get();
+}
+
+bool ProgramCache::load(unsigned long long key, GLuint program)
+{
+    if (!supported) {
+        return false;
+    }
+    std::ifstream file(fileName(key).c_str(), std::ios::binary | std::ios::ate);
+    // a damaged header must not size the allocation beyond the file
+    const std::streamoff fileSize = file ? std::streamoff(file.tellg()) : 0;
+    file.seekg(0);
+    CacheHeader header;
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "MSPB", 4) != 0 || header.version != CACHE_VERSION || header.key != key || header.binaryLength == 0 ||
+        std::streamoff(header.binaryLength) > fileSize - std::streamoff(sizeof(header))) {
+        misses++;
+        return false;
+    }
+    std::vector<char> binary(header.binaryLength);
+    if (!file.read(&binary[0], binary.size())) {
+        misses++;
+        return false;
+    }
+    file.close();
+
+    // the driver may still refuse a binary of its own (e.g. after an update that kept the version string)
+    glProgramBinary(program, header.binaryFormat, &binary[0], GLsizei(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        rejects++;
+        std::remove(fileName(key).c_str());
+        return false;
+    }
+    hits++;
+    return true;
+}
+
+bool ProgramCache::store(unsigned long long key, GLuint program)
+{
+    if (!supported) {
+        return false;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, &binary[0]);
+    if (written <= 0) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, "MSPB", 4);
+    header.version = CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = (unsigned int)written;
+
+    // a crash halfway through never leaves a truncated binary under the real name
+    std::string target = fileName(key);
+    std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(&binary[0], written);
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
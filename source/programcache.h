@@ -0,0 +1,43 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <string>
+
+// Disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// A program is keyed by a hash of its final stage sources, which already contain every glsw
+// directive token, and of the GL vendor, renderer and version strings. A driver update changes
+// the key, and a binary the driver still rejects just makes load() fail so the caller compiles.
+class ProgramCache
+{
+public:
+    // binaries go into an existing directory, the driver strings come from the current context
+    explicit ProgramCache(const std::string& directory);
+    // false when the driver offers no binary formats (everything gets compiled)
+    bool isSupported() const { return supported; }
+    // key of a program built from count stage sources (NULL entries are skipped)
+    unsigned long long key(const char* const* sources, int count) const;
+    // Link program from the binary stored under key, false when there is none or the driver rejects it
+    bool load(unsigned long long key, GLuint program);
+    // Store the binary of a linked program (created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+    bool store(unsigned long long key, GLuint program);
+
+    int getHitCount() const { return hits; }
+    int getMissCount() const { return misses; }
+    int getRejectCount() const { return rejects; }
+
+private:
+    std::string fileName(unsigned long long key) const;
+
+    std::string directory;
+    std::string driver;       // vendor, renderer and version
+    bool supported;
+    int hits;
+    int misses;               // no binary stored yet
+    int rejects;              // binary found but not accepted
+
+};
+
+
+#endif
@@ -0,0 +1,410 @@
+#include "scenebatch.h"
+#include "meshcache.h"
+#include "meshsimplify.h"
+#include "shader_s.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace
+{
+    // a new buffer with the contents of the old one followed by data, the old one is deleted;
+    // the copy stays on the GPU, the meshes already added are not read back
+    GLuint appendToBuffer(GLuint buffer, GLsizeiptr oldSize, const void* data, GLsizeiptr size)
+    {
+        GLuint grown = 0;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        if (glBufferStorage != NULL) {
+            glBufferStorage(GL_COPY_WRITE_BUFFER, oldSize + size, NULL, GL_DYNAMIC_STORAGE_BIT);
+        }
+        else {
+            glBufferData(GL_COPY_WRITE_BUFFER, oldSize + size, NULL, GL_STATIC_DRAW);
+        }
+        if (oldSize > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, oldSize, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        return grown;
+    }
+}
+
+SceneBatch::SceneBatch(GLuint transformBinding_, const GLuint cullBindings_[4])
+    :
+    vertexBuffer(0),
+    indexBuffer(0),
+    objectIndexBuffer(0),
+    transformBinding(transformBinding_),
+    vertexCount(0),
+    indexCount(0),
+    objectIndexCapacity(0),
+    transformsDirty(false),
+    commandsDirty(false),
+    culledCapacity(0),
+    counterFrame(0)
+{
+    glGenVertexArrays(1, &vao);
+    glGenVertexArrays(1, &batchVao);
+    glGenBuffers(1, &transformBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &boundsBuffer);
+    glGenBuffers(1, &culledBuffer);
+    glGenBuffers(3, counterBuffers);
+    // separate buffers, so reading the counters of a finished frame never waits for the frames after it
+    for (int i = 0; i < 3; i++)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, counterBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, 2 * CULL_LISTS * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+        counterFences[i] = 0;
+        counterLists[i] = 0;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    for (int i = 0; i < 4; i++) {
+        cullBindings[i] = cullBindings_[i];
+    }
+    for (int i = 0; i < CULL_LISTS; i++)
+    {
+        culledObjects[i] = 0;
+        culledTriangles[i] = 0;
+    }
+}
+
+SceneBatch::~SceneBatch()
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteVertexArrays(1, &batchVao);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &objectIndexBuffer);
+    glDeleteBuffers(1, &transformBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteBuffers(1, &culledBuffer);
+    glDeleteBuffers(3, counterBuffers);
+    for (int i = 0; i < 3; i++) {
+        if (counterFences[i] != 0) {
+            glDeleteSync(counterFences[i]);
+        }
+    }
+}
+
+void SceneBatch::setAttributes(GLuint array, bool objectIndex)
+{
+    glBindVertexArray(array);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, texCoords));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    if (objectIndex && objectIndexBuffer != 0)
+    {
+        // advances once per instance, the first instance of a command is its baseInstance
+        glBindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer);
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(3, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int SceneBatch::addMesh(const MeshCache& mesh)
+{
+    if (meshes.size() >= size_t(MAX_MESHES)) {
+        return -1;
+    }
+    Mesh entry;
+    entry.baseVertex = GLint(vertexCount);
+    for (int i = 0; i < mesh.getLodCount(); i++)
+    {
+        MeshLod lod = mesh.getLod(i);
+        lod.firstIndex += unsigned(indexCount);
+        entry.lods.push_back(lod);
+    }
+    entry.boundsMin = mesh.getBoundsMin();
+    entry.boundsMax = mesh.getBoundsMax();
+    entry.geometryHash = mesh.getGeometryHash();
+    entry.objectCount = 0;
+    entry.firstCommand = 0;
+    meshes.push_back(entry);
+
+    // the indices stay relative to the mesh, the commands add baseVertex
+    vertexBuffer = appendToBuffer(vertexBuffer, vertexCount * sizeof(MeshVertex), mesh.getVertices(), GLsizeiptr(mesh.getVertexCount()) * sizeof(MeshVertex));
+    indexBuffer = appendToBuffer(indexBuffer, indexCount * sizeof(unsigned int), mesh.getIndices(), GLsizeiptr(mesh.getIndexCount()) * sizeof(unsigned int));
+    vertexCount += mesh.getVertexCount();
+    indexCount += mesh.getIndexCount();
+    setAttributes(vao, false);
+    setAttributes(batchVao, true);
+    commandsDirty = true;
+    return int(meshes.size()) - 1;
+}
+
+int SceneBatch::addObject(int mesh, const glm::mat4& model)
+{
+    objectMeshes.push_back(mesh);
+    transforms.push_back(model);
+    transformsDirty = true;
+    commandsDirty = true;
+    return int(objectMeshes.size()) - 1;
+}
+
+void SceneBatch::setTransform(int object, const glm::mat4& model)
+{
+    transforms[object] = model;
+    transformsDirty = true;
+}
+
+void SceneBatch::clearObjects()
+{
+    objectMeshes.clear();
+    transforms.clear();
+    transformsDirty = true;
+    commandsDirty = true;
+}
+
+int SceneBatch::selectLod(int mesh, float maxError) const
+{
+    return ::selectLod(meshes[mesh].lods, maxError);
+}
+
+void SceneBatch::update()
+{
+    const GLsizeiptr objectCount = GLsizeiptr(objectMeshes.size());
+    if (objectCount > objectIndexCapacity)
+    {
+        objectIndexCapacity = std::max(GLsizeiptr(256), objectCount * 2);
+        std::vector<GLuint> objectIndices(objectIndexCapacity);
+        for (size_t i = 0; i < objectIndices.size(); i++) {
+            objectIndices[i] = GLuint(i);
+        }
+        glDeleteBuffers(1, &objectIndexBuffer);
+        objectIndexBuffer = appendToBuffer(0, 0, &objectIndices[0], objectIndexCapacity * sizeof(GLuint));
+        setAttributes(batchVao, true);
+    }
+    if (transformsDirty)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objectCount * sizeof(glm::mat4), transforms.empty() ? NULL : &transforms[0], GL_DYNAMIC_DRAW);
+
+        // bounding sphere of every object's box, for culling
+        std::vector<ObjectBounds> bounds(objectCount);
+        for (GLsizeiptr object = 0; object < objectCount; object++)
+        {
+            const Mesh& mesh = meshes[objectMeshes[object]];
+            const glm::mat4& model = transforms[object];
+            glm::vec4 center = model * glm::vec4(0.5f * (mesh.boundsMin + mesh.boundsMax), 1.0f);
+            float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            bounds[object].sphere = glm::vec4(center.x, center.y, center.z, 0.5f * glm::length(mesh.boundsMax - mesh.boundsMin) * scale);
+            bounds[object].mesh = GLuint(objectMeshes[object]);
+            bounds[object].padding[0] = bounds[object].padding[1] = bounds[object].padding[2] = 0;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objectCount * sizeof(ObjectBounds), bounds.empty() ? NULL : &bounds[0], GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        transformsDirty = false;
+    }
+    if (commandsDirty)
+    {
+        // the objects of a mesh follow each other, so do the runs of meshes drawn at the same level
+        int firstCommand = 0;
+        for (Mesh& mesh : meshes) {
+            mesh.objectCount = 0;
+        }
+        for (int mesh : objectMeshes) {
+            meshes[mesh].objectCount++;
+        }
+        for (Mesh& mesh : meshes)
+        {
+            mesh.firstCommand = firstCommand;
+            firstCommand += mesh.objectCount;
+        }
+        std::vector<DrawCommand> commands(MAX_MESH_LODS * objectCount);
+        std::vector<int> nextCommand(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            nextCommand[i] = meshes[i].firstCommand;
+        }
+        for (GLsizeiptr object = 0; object < objectCount; object++)
+        {
+            const Mesh& mesh = meshes[objectMeshes[object]];
+            int slot = nextCommand[objectMeshes[object]]++;
+            for (int level = 0; level < MAX_MESH_LODS; level++)
+            {
+                // meshes with fewer levels repeat their coarsest one
+                const MeshLod& lod = mesh.lods[std::min(level, int(mesh.lods.size()) - 1)];
+                DrawCommand& command = commands[level * objectCount + slot];
+                command.count = lod.indexCount;
+                command.instanceCount = 1;
+                command.firstIndex = lod.firstIndex;
+                command.baseVertex = mesh.baseVertex;
+                command.baseInstance = GLuint(object);
+            }
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.empty() ? NULL : &commands[0], GL_STATIC_DRAW);
+        if (objectCount > culledCapacity)
+        {
+            culledCapacity = objectCount;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culledBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, CULL_LISTS * culledCapacity * sizeof(DrawCommand), NULL, GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        commandsDirty = false;
+    }
+}
+
+int SceneBatch::draw(const int* meshLevels)
+{
+    if (objectMeshes.empty()) {
+        return 0;
+    }
+    update();
+    const int objectCount = int(objectMeshes.size());
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, transformBinding, transformBuffer, 0, objectCount * sizeof(glm::mat4));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindVertexArray(batchVao);
+    int triangles = 0;
+    for (size_t first = 0; first < meshes.size();)
+    {
+        int level = meshLevels != NULL ? std::min(meshLevels[first], getLodCount(int(first)) - 1) : 0;
+        int drawCount = 0;
+        size_t last = first;
+        for (; last < meshes.size(); last++)
+        {
+            int meshLevel = meshLevels != NULL ? std::min(meshLevels[last], getLodCount(int(last)) - 1) : 0;
+            if (meshLevel != level) {
+                break;
+            }
+            drawCount += meshes[last].objectCount;
+            triangles += meshes[last].objectCount * getLodTriangleCount(int(last), level);
+        }
+        if (drawCount > 0)
+        {
+            size_t command = size_t(level) * objectCount + meshes[first].firstCommand;
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(command * sizeof(DrawCommand)), drawCount, 0);
+        }
+        first = last;
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return triangles;
+}
+
+void SceneBatch::drawObject(int object, int level, GLsizei instances) const
+{
+    const Mesh& mesh = meshes[objectMeshes[object]];
+    const MeshLod& lod = mesh.lods[level];
+    glBindVertexArray(vao);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, GLsizei(lod.indexCount), GL_UNSIGNED_INT,
+        (void*)(size_t(lod.firstIndex) * sizeof(unsigned int)), instances, mesh.baseVertex);
+    glBindVertexArray(0);
+}
+
+void SceneBatch::beginFrame()
+{
+    // everything issued since the last call wrote the current counters
+    if (counterLists[counterFrame] != 0) {
+        counterFences[counterFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    counterFrame = (counterFrame + 1) % 3;
+    GLsync& fence = counterFences[counterFrame];
+    if (fence != 0)
+    {
+        // a frame the GPU hasn't finished yet only loses its counts, the CPU never waits
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        {
+            GLuint counters[2 * CULL_LISTS];
+            glBindBuffer(GL_COPY_READ_BUFFER, counterBuffers[counterFrame]);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            for (int list = 0; list < CULL_LISTS; list++)
+            {
+                if (counterLists[counterFrame] & (1u << list)) {
+                    culledObjects[list] = int(counters[2 * list]);
+                    culledTriangles[list] = int(counters[2 * list + 1]);
+                }
+            }
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    counterLists[counterFrame] = 0;
+    const GLuint zero = 0;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, counterBuffers[counterFrame]);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void SceneBatch::cull(Shader& program, int list, const glm::vec4* planes, int planeCount, const int* meshLevels)
+{
+    if (objectMeshes.empty()) {
+        return;
+    }
+    update();
+    const int objectCount = int(objectMeshes.size());
+    // the commands behind the visible ones must draw nothing
+    const GLuint zero = 0;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, culledBuffer);
+    glClearBufferSubData(GL_COPY_WRITE_BUFFER, GL_R32UI, GLintptr(list) * objectCount * sizeof(DrawCommand),
+        GLsizeiptr(objectCount) * sizeof(DrawCommand), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    int levels[MAX_MESHES] = {};
+    for (size_t i = 0; i < meshes.size(); i++) {
+        levels[i] = meshLevels != NULL ? std::max(0, std::min(meshLevels[i], MAX_MESH_LODS - 1)) : 0;
+    }
+    program.use();
+    program.setUniformInt("objectCount", objectCount);
+    program.setUniformVec4v("planes", planes, planeCount);
+    program.setUniformInt("planeCount", planeCount);
+    program.setUniformIntv("meshLevels", levels, MAX_MESHES);
+    program.setUniformInt("outputOffset", list * objectCount);
+    program.setUniformInt("counterOffset", 2 * list);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cullBindings[0], boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cullBindings[1], commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cullBindings[2], culledBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, cullBindings[3], counterBuffers[counterFrame]);
+    glDispatchCompute((objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    // the commands are read by the indirect draw, the counters by beginFrame()
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    counterLists[counterFrame] |= 1u << list;
+}
+
+void SceneBatch::drawCulled(int list)
+{
+    if (objectMeshes.empty()) {
+        return;
+    }
+    const int objectCount = int(objectMeshes.size());
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, transformBinding, transformBuffer, 0, objectCount * sizeof(glm::mat4));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culledBuffer);
+    glBindVertexArray(batchVao);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(size_t(list) * objectCount * sizeof(DrawCommand)), objectCount, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void SceneBatch::frustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // Gribb and Hartmann: the planes of the clip volume are sums and differences of the matrix rows
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        planes[2 * i] = rows[3] + rows[i];
+        planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef _SCENE_BATCH_H_
+#define _SCENE_BATCH_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include "objloader.h"
+
+#include <vector>
+
+class MeshCache;
+class Shader;
+
+// The scene objects as one batch: the vertices and indices of every mesh (levels of detail included)
+// in one shared vertex and index buffer, the object transforms in a storage buffer and one indirect
+// draw command per object and level, so a pass draws all objects with a single
+// glMultiDrawElementsIndirect and the CPU cost doesn't grow with the object count.
+// A command starts its instance at the object index (baseInstance); the instanced attribute at
+// location 3 turns that into the index the batched vertex shaders read their transform with, so
+// GL 4.3 does without gl_DrawID. The commands are ordered by mesh, each level has its own block.
+// cull() has a compute program (sceneCulling.Cull) test the bounding sphere of every object against
+// a frustum and copy the commands of the visible ones, at their mesh's level, to the front of a
+// command list; drawCulled() draws the list, the zeroed commands behind the visible ones draw
+// nothing. The visible counts come back a few frames later, without waiting for the GPU.
+class SceneBatch
+{
+public:
+    // most meshes a batch holds, the culling program gets their levels as a uniform array
+    static const int MAX_MESHES = 16;
+    // command lists culled per frame (a pass each)
+    static const int CULL_LISTS = 6;
+    // objects per workgroup of the culling program
+    static const int CULL_GROUP_SIZE = 64;
+
+    // the transforms are bound to transformBinding by draw(); cull() binds the object bounds, the
+    // commands, the culled lists and the counters to the four bindings in cullBindings
+    SceneBatch(GLuint transformBinding, const GLuint cullBindings[4]);
+    ~SceneBatch();
+    // append the geometry of an opened cache to the shared buffers, returns the mesh index
+    // (-1 when MAX_MESHES are in already)
+    int addMesh(const MeshCache& mesh);
+    // place a mesh in the scene, returns the object index
+    int addObject(int mesh, const glm::mat4& model);
+    void setTransform(int object, const glm::mat4& model);
+    void clearObjects();
+
+    // draw every object with the current program (a batched one), mesh m at level meshLevels[m]
+    // or at full detail without levels; one multi draw per run of meshes at the same level
+    // returns the triangles drawn
+    int draw(const int* meshLevels = NULL);
+    // draw a single object with the current program (a per object one, the caller sets the transform)
+    void drawObject(int object, int level, GLsizei instances = 1) const;
+
+    // Start a frame: read the counters of a finished earlier frame, if there is one, and clear
+    // the counters this frame's cull() calls add to
+    void beginFrame();
+    // Fill command list `list` with the commands of the objects whose bounding sphere is not
+    // entirely outside one of the planes, mesh m at level meshLevels[m] (full detail when null)
+    void cull(Shader& program, int list, const glm::vec4* planes, int planeCount, const int* meshLevels = NULL);
+    // draw a command list with the current program (a batched one)
+    void drawCulled(int list);
+    // visible objects and their triangles of the last finished frame that culled `list`
+    int getCulledObjects(int list) const { return culledObjects[list]; }
+    int getCulledTriangles(int list) const { return culledTriangles[list]; }
+    // normalized planes (inside when dot(plane.xyz, p) + plane.w >= 0) of the clip volume of a
+    // view projection matrix: left, right, bottom, top, near, far
+    static void frustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+    int getMeshCount() const { return int(meshes.size()); }
+    int getObjectCount() const { return int(objectMeshes.size()); }
+    int getObjectMesh(int object) const { return objectMeshes[object]; }
+    const glm::mat4& getTransform(int object) const { return transforms[object]; }
+    // level 0 is the full mesh, see buildShadowLods()
+    int getLodCount(int mesh) const { return int(meshes[mesh].lods.size()); }
+    int getLodTriangleCount(int mesh, int level) const { return int(meshes[mesh].lods[level].indexCount / 3); }
+    // coarsest level of a mesh whose error stays within maxError (object space units)
+    int selectLod(int mesh, float maxError) const;
+    const glm::vec3& getBoundsMin(int mesh) const { return meshes[mesh].boundsMin; }
+    const glm::vec3& getBoundsMax(int mesh) const { return meshes[mesh].boundsMax; }
+    // HashKey of the mesh geometry (MeshCache::getGeometryHash())
+    unsigned long long getGeometryHash(int mesh) const { return meshes[mesh].geometryHash; }
+
+private:
+    SceneBatch(const SceneBatch&);
+    SceneBatch& operator=(const SceneBatch&);
+
+    // layout of glMultiDrawElementsIndirect
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // std430 mirror of the culling program's ObjectBounds
+    struct ObjectBounds
+    {
+        glm::vec4 sphere;             // xyz - world space center, w - radius
+        GLuint mesh;
+        GLuint padding[3];
+    };
+
+    struct Mesh
+    {
+        GLint baseVertex;
+        std::vector<MeshLod> lods;    // firstIndex into the shared index buffer
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        unsigned long long geometryHash;
+        int objectCount;
+        int firstCommand;             // of its objects in every level block
+    };
+
+    // upload the transforms and rebuild the commands changed since the last draw
+    void update();
+    void setAttributes(GLuint array, bool objectIndex);
+
+    GLuint vao;                   // per object draws
+    GLuint batchVao;              // same buffers plus the object index
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLuint objectIndexBuffer;     // 0, 1, 2, ... read through baseInstance
+    GLuint transformBuffer;
+    GLuint commandBuffer;
+    GLuint boundsBuffer;
+    GLuint culledBuffer;          // CULL_LISTS lists of objectCount commands
+    GLuint counterBuffers[3];     // visible objects and triangles of every list, one per frame in flight
+    GLuint transformBinding;
+    GLuint cullBindings[4];       // bounds, commands, culled lists, counters
+    GLsizeiptr vertexCount;
+    GLsizeiptr indexCount;
+    GLsizeiptr objectIndexCapacity;
+    std::vector<Mesh> meshes;
+    std::vector<int> objectMeshes;
+    std::vector<glm::mat4> transforms;
+    bool transformsDirty;
+    bool commandsDirty;
+    GLsizeiptr culledCapacity;    // commands per list the culled buffer holds
+    int counterFrame;             // counter buffer written this frame
+    GLsync counterFences[3];      // end of the frame that wrote each counter buffer
+    unsigned int counterLists[3]; // bit per list culled into each counter buffer
+    int culledObjects[CULL_LISTS];
+    int culledTriangles[CULL_LISTS];
+
+};
+
+
+#endif
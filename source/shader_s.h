@@ -4,6 +4,10 @@
 #include <glad/glad.h>
 #include <string>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "programcache.h"
 
 // GLM
 #include <glm/glm.hpp>
@@ -14,144 +18,266 @@ class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
-    Shader(const char* vShaderSource, const char* fShaderSource, const char* gShaderSource = nullptr)
-    {
-        // compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderSource, NULL);
-        glCompileShader(vertex);
-        if (!checkCompileErrors(vertex, "VERTEX"))
-        {
-            std::cout << vShaderSource << std::endl;
-        }
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderSource, NULL);
-        glCompileShader(fragment);
-        if (!checkCompileErrors(fragment, "FRAGMENT"))
-        {
-            std::cout << fShaderSource << std::endl;
-        }
-        // if the geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (gShaderSource != nullptr)
-        {
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderSource, NULL);
-            glCompileShader(geometry);
-            if (!checkCompileErrors(fragment, "GEOMETRY"))
-            {
-                std::cout << gShaderSource << std::endl;
-            }
-
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (gShaderSource != nullptr) {
-            glAttachShader(ID, geometry);
-        }
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (gShaderSource != nullptr) {
-            glDeleteShader(geometry);
-        }      
+    // constructor issues the compile and link of the shader (or links it from the binary cache when one
+    // is given); the results are only checked in finish(), so the driver can build many programs at once
+    Shader(const char* vShaderSource, const char* fShaderSource, const char* gShaderSource = nullptr, ProgramCache* cache = nullptr)
+        :
+        programCache(cache),
+        cacheKey(0),
+        finished(false)
+    {
+        const char* sources[] = { vShaderSource, fShaderSource, gShaderSource };
+        const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+        build(sources, types, gShaderSource != nullptr ? 3 : 2);
     }
 
     // constructor for compute shader
-    Shader(const char* cShaderSource)
+    Shader(const char* cShaderSource, ProgramCache* cache = nullptr)
+        :
+        programCache(cache),
+        cacheKey(0),
+        finished(false)
     {
-        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
-        glShaderSource(compute, 1, &cShaderSource, NULL);
-        glCompileShader(compute);
-        if (!checkCompileErrors(compute, "COMPUTE"))
+        const GLenum type = GL_COMPUTE_SHADER;
+        build(&cShaderSource, &type, 1);
+    }
+
+    // check the compile and link results (waits for the driver if it is still busy),
+    // store the binary and reflect the uniforms; use() calls it when nobody did before
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        for (const Stage& stage : stages)
         {
-            std::cout << cShaderSource << std::endl;
+            if (!checkCompileErrors(stage.id, stageName(stage.type)))
+            {
+                std::cout << stage.source << std::endl;
+            }
+            // linked into our program now and no longer necessary
+            glDeleteShader(stage.id);
         }
-
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, compute);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        glDeleteShader(compute);
+        if (!stages.empty() && checkCompileErrors(ID, "PROGRAM") && programCache != nullptr) {
+            programCache->store(cacheKey, ID);
+        }
+        stages.clear();
+        cacheUniformLocations();
     }
 
-
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
+        finish();
         glUseProgram(ID);
     }
+    // location of a uniform reflected at link time, -1 (ignored by glUniform*) when it is not active
+    GLint getUniformLocation(const std::string &uniformName) const
+    {
+        if (!finished) {
+            return glGetUniformLocation(ID, uniformName.c_str());
+        }
+        std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(uniformName);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
     // utility uniform functions
     void setUniformBool(const std::string &uniformName, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, uniformName.c_str()), (int)value);
+        glUniform1i(getUniformLocation(uniformName), (int)value);
     }
     // ------------------------------------------------------------------------
     void setUniformInt(const std::string &uniformName, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, uniformName.c_str()), value);
+        glUniform1i(getUniformLocation(uniformName), value);
     }
     // ------------------------------------------------------------------------
     void setUniformFloat(const std::string &uniformName, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, uniformName.c_str()), value);
+        glUniform1f(getUniformLocation(uniformName), value);
     }
     // ------------------------------------------------------------------------
     void setUniformVec2f(const std::string &uniformName, glm::vec2& value) const
     {
-        glUniform2f(glGetUniformLocation(ID, uniformName.c_str()), value.x, value.y);
+        glUniform2f(getUniformLocation(uniformName), value.x, value.y);
     }
     void setUniformVec2f(const std::string &uniformName, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, uniformName.c_str()), x, y);
+        glUniform2f(getUniformLocation(uniformName), x, y);
     }
     // ------------------------------------------------------------------------
     void setUniformVec2fv(const std::string &uniformName, const float* floats) const
     {
-        glUniform2fv(glGetUniformLocation(ID, uniformName.c_str()), 1, floats);
+        glUniform2fv(getUniformLocation(uniformName), 1, floats);
     }
     // ------------------------------------------------------------------------
     void setUniformVec3f(const std::string &uniformName, glm::vec3& value) const
     {
-        glUniform3f(glGetUniformLocation(ID, uniformName.c_str()), value.x, value.y, value.z);
+        glUniform3f(getUniformLocation(uniformName), value.x, value.y, value.z);
     }
     void setUniformVec3f(const std::string &uniformName, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, uniformName.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(uniformName), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setUniformVec3fv(const std::string &uniformName, const float* floats) const
     {
-        glUniform3fv(glGetUniformLocation(ID, uniformName.c_str()), 1, floats);
+        glUniform3fv(getUniformLocation(uniformName), 1, floats);
     }
     // ------------------------------------------------------------------------
     void setUniformVec4f(const std::string &uniformName, glm::vec4& value) const
     {
-        glUniform4f(glGetUniformLocation(ID, uniformName.c_str()), value.x, value.y, value.z, value.a);
+        glUniform4f(getUniformLocation(uniformName), value.x, value.y, value.z, value.a);
     }
     // ------------------------------------------------------------------------
     void setUniformVec4fv(const std::string &uniformName, const float* floats) const
     {
-        glUniform4fv(glGetUniformLocation(ID, uniformName.c_str()), 1, floats);
+        glUniform4fv(getUniformLocation(uniformName), 1, floats);
     }
     // ------------------------------------------------------------------------
     void setUniformMat4(const std::string &uniformName, const glm::mat4 &matrix) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, uniformName.c_str()), 1, GL_FALSE, &matrix[0][0]);
+        glUniformMatrix4fv(getUniformLocation(uniformName), 1, GL_FALSE, &matrix[0][0]);
+    }
+    // handle based setters for the hot path, locations come from getUniformLocation()
+    // ------------------------------------------------------------------------
+    void setUniformInt(GLint location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformFloat(GLint location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformVec3f(GLint location, const glm::vec3& value) const
+    {
+        glUniform3f(location, value.x, value.y, value.z);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformVec4f(GLint location, const glm::vec4& value) const
+    {
+        glUniform4f(location, value.x, value.y, value.z, value.w);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformMat4(GLint location, const glm::mat4 &matrix) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformMat4v(const std::string &uniformName, const glm::mat4* matrices, int count) const
+    {
+        glUniformMatrix4fv(getUniformLocation(uniformName), count, GL_FALSE, &matrices[0][0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformIntv(const std::string &uniformName, const int* ints, int count) const
+    {
+        glUniform1iv(getUniformLocation(uniformName), count, ints);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformVec4v(const std::string &uniformName, const glm::vec4* vectors, int count) const
+    {
+        glUniform4fv(getUniformLocation(uniformName), count, &vectors[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setUniformFloatv(const std::string &uniformName, const float* floats, int count) const
+    {
+        glUniform1fv(getUniformLocation(uniformName), count, floats);
     }
 
 
 private:
+    // a stage compiled by the constructor, checked and released in finish()
+    struct Stage
+    {
+        unsigned int id;
+        GLenum type;
+        const char* source;
+    };
+
+    ProgramCache* programCache;   // where the linked binary goes, may be null
+    unsigned long long cacheKey;
+    bool finished;
+    std::vector<Stage> stages;    // empty when the program came from the binary cache
+    // uniform name -> location, filled once after linking
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // create the program from count stages, nothing is queried from the driver here
+    // ------------------------------------------------------------------------
+    void build(const char* const* sources, const GLenum* types, int count)
+    {
+        ID = glCreateProgram();
+        if (programCache != nullptr)
+        {
+            cacheKey = programCache->key(sources, count);
+            if (programCache->load(cacheKey, ID)) {
+                return;
+            }
+        }
+        for (int i = 0; i < count; i++)
+        {
+            Stage stage = { glCreateShader(types[i]), types[i], sources[i] };
+            glShaderSource(stage.id, 1, &sources[i], NULL);
+            glCompileShader(stage.id);
+            glAttachShader(ID, stage.id);
+            stages.push_back(stage);
+        }
+        if (programCache != nullptr && programCache->isSupported()) {
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(ID);
+    }
+
+    static const char* stageName(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_VERTEX_SHADER: return "VERTEX";
+        case GL_FRAGMENT_SHADER: return "FRAGMENT";
+        case GL_GEOMETRY_SHADER: return "GEOMETRY";
+        default: return "COMPUTE";
+        }
+    }
+
+    // reflect all active uniforms of the linked program so no setter has to ask the driver
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        std::string name(maxNameLength > 0 ? maxNameLength : 1, '\0');
+        for (GLint i = 0; i < uniformCount; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, GLuint(i), GLsizei(name.size()), &length, &size, &type, &name[0]);
+            std::string uniformName(name.c_str(), length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0) {
+                continue; // uniform block members have no location
+            }
+            uniformLocations[uniformName] = location;
+            // arrays are reported as "name[0]", make the plain name and every element reachable too
+            size_t bracket = uniformName.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                std::string baseName = uniformName.substr(0, bracket);
+                uniformLocations[baseName] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     int checkCompileErrors(unsigned int shader, std::string type)
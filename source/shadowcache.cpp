@@ -0,0 +1,110 @@
+#include "shadowcache.h"
+#include "mappedfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    // bump when the layout of the file or the meaning of the moments changes
+    const unsigned int CACHE_VERSION = 1;
+
+    // 32 bytes in front of the texels
+    struct CacheHeader
+    {
+        char magic[4];            // "MSMC"
+        unsigned int version;
+        unsigned long long key;
+        int width;
+        int height;
+        unsigned int format;      // GL internal format
+        unsigned int texelBytes;
+    };
+}
+
+ShadowMapCache::ShadowMapCache(const std::string& directory_, int size_, GLenum format_)
+    :
+    directory(directory_),
+    size(size_),
+    format(format_),
+    pixelType(format_ == GL_RGBA16 ? GL_UNSIGNED_SHORT : GL_FLOAT),
+    texelBytes(format_ == GL_RGBA16 ? 8 : 16),
+    loads(0),
+    stores(0)
+{
+}
+
+std::string ShadowMapCache::fileName(unsigned long long key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.msm", key);
+    return directory + "/" + name;
+}
+
+bool ShadowMapCache::load(unsigned long long key, GLuint texture)
+{
+    MappedFile file(fileName(key));
+    size_t texelDataSize = size_t(size) * size * texelBytes;
+    if (file.length() != sizeof(CacheHeader) + texelDataSize) {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file.bytes(), sizeof(header));
+    if (std::memcmp(header.magic, "MSMC", 4) != 0 || header.version != CACHE_VERSION || header.key != key ||
+        header.width != size || header.height != size || header.format != format || header.texelBytes != texelBytes) {
+        return false;
+    }
+
+    // copied out of the mapping before glTexSubImage2D returns, nothing to keep alive
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, pixelType, file.bytes() + sizeof(CacheHeader));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    loads++;
+    return true;
+}
+
+bool ShadowMapCache::store(unsigned long long key, GLuint texture)
+{
+    CacheHeader header;
+    std::memcpy(header.magic, "MSMC", 4);
+    header.version = CACHE_VERSION;
+    header.key = key;
+    header.width = size;
+    header.height = size;
+    header.format = format;
+    header.texelBytes = (unsigned int)texelBytes;
+
+    std::vector<char> texels(size_t(size) * size * texelBytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, pixelType, &texels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // a crash halfway through never leaves a truncated map under the real name
+    std::string target = fileName(key);
+    std::string temporary = target + ".tmp";
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(&texels[0], texels.size());
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    stores++;
+    return true;
+}
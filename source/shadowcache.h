@@ -0,0 +1,42 @@
+#ifndef _SHADOW_CACHE_H_
+#define _SHADOW_CACHE_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <cstddef>
+#include <string>
+
+// Disk cache of baked (rendered and filtered) moment shadow maps for static lights, keyed by
+// a HashKey of everything that decides the map (light matrix, casters, format, filter settings).
+// Every map is one file named after its key: a small header followed by the raw texels
+// exactly as the texture stores them, so load() maps the file and hands the mapping
+// straight to glTexSubImage2D without reading or converting it first.
+class ShadowMapCache
+{
+public:
+    // maps of size x size texels in format (GL_RGBA32F or GL_RGBA16), files go into directory
+    ShadowMapCache(const std::string& directory, int size, GLenum format);
+    // Upload the map stored under key into texture, false when there is none or it doesn't match
+    bool load(unsigned long long key, GLuint texture);
+    // Read texture back and store it under key (written to a temporary file, then renamed)
+    bool store(unsigned long long key, GLuint texture);
+    // file holding the map of key
+    std::string fileName(unsigned long long key) const;
+
+    const std::string& getDirectory() const { return directory; }
+    int getLoadCount() const { return loads; }
+    int getStoreCount() const { return stores; }
+
+private:
+    std::string directory;
+    int size;                 // width and height of the map
+    GLenum format;            // internal format of the texture
+    GLenum pixelType;         // client side type of a moment (GL_FLOAT or GL_UNSIGNED_SHORT)
+    size_t texelBytes;        // 4 moments
+    int loads;
+    int stores;
+
+};
+
+
+#endif
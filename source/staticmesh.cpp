@@ -0,0 +1,77 @@
+#include "staticmesh.h"
+#include "meshcache.h"
+#include "meshsimplify.h"
+
+#include <cstddef>
+
+namespace
+{
+    // immutable storage the driver can place in video memory right away, the data is never changed
+    void createBuffer(GLenum target, GLuint buffer, GLsizeiptr size, const void* data)
+    {
+        glBindBuffer(target, buffer);
+        if (glBufferStorage != NULL) {
+            glBufferStorage(target, size, data, 0);
+        }
+        else {
+            glBufferData(target, size, data, GL_STATIC_DRAW);
+        }
+    }
+}
+
+StaticMesh::StaticMesh(const MeshCache& mesh)
+    :
+    boundsMin(mesh.getBoundsMin()),
+    boundsMax(mesh.getBoundsMax()),
+    geometryHash(mesh.getGeometryHash())
+{
+    for (int i = 0; i < mesh.getLodCount(); i++) {
+        lods.push_back(mesh.getLod(i));
+    }
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindVertexArray(vao);
+    // the mapped pages are read by the copy, glBufferStorage returns with the data owned by GL
+    createBuffer(GL_ARRAY_BUFFER, vertexBuffer, GLsizeiptr(mesh.getVertexCount()) * sizeof(MeshVertex), mesh.getVertices());
+    createBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer, GLsizeiptr(mesh.getIndexCount()) * sizeof(unsigned int), mesh.getIndices());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, texCoords));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+StaticMesh::~StaticMesh()
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+void StaticMesh::draw() const
+{
+    drawLod(0);
+}
+
+void StaticMesh::drawInstanced(GLsizei instances) const
+{
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, 0, instances);
+    glBindVertexArray(0);
+}
+
+void StaticMesh::drawLod(int level) const
+{
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, GLsizei(lods[level].indexCount), GL_UNSIGNED_INT, (void*)(size_t(lods[level].firstIndex) * sizeof(unsigned int)));
+    glBindVertexArray(0);
+}
+
+int StaticMesh::selectLod(float maxError) const
+{
+    return ::selectLod(lods, maxError);
+}
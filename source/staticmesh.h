@@ -0,0 +1,57 @@
+#ifndef _STATIC_MESH_H_
+#define _STATIC_MESH_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include "objloader.h"
+
+#include <vector>
+
+class MeshCache;
+
+// GPU copy of an opened MeshCache: the interleaved vertices and the indices in two immutable
+// buffers (glBufferStorage, glBufferData without GL 4.4) filled straight from the cache mapping,
+// and a VAO with the attribute layout of the scene shaders (0 position, 1 normal, 2 texcoords).
+// The shadow caster levels of detail of the cache share both buffers, a level is only a range of
+// the indices. The mesh doesn't need the MeshCache any more once constructed.
+class StaticMesh
+{
+public:
+    explicit StaticMesh(const MeshCache& mesh);
+    ~StaticMesh();
+    // draw the triangles of the full mesh with the current program
+    void draw() const;
+    void drawInstanced(GLsizei instances) const;
+    // draw a level of detail, 0 is the full mesh
+    void drawLod(int level) const;
+    // coarsest level whose error stays within maxError (object space units), 0 when none does
+    int selectLod(float maxError) const;
+    int getLodCount() const { return int(lods.size()); }
+    float getLodError(int level) const { return lods[level].error; }
+    GLsizei getLodTriangleCount(int level) const { return GLsizei(lods[level].indexCount / 3); }
+
+    GLuint getVAO() const { return vao; }
+    // indices of the full mesh
+    GLsizei getIndexCount() const { return GLsizei(lods[0].indexCount); }
+    const glm::vec3& getBoundsMin() const { return boundsMin; }
+    const glm::vec3& getBoundsMax() const { return boundsMax; }
+    // HashKey of the geometry (MeshCache::getGeometryHash())
+    unsigned long long getGeometryHash() const { return geometryHash; }
+
+private:
+    StaticMesh(const StaticMesh&);
+    StaticMesh& operator=(const StaticMesh&);
+
+    GLuint vao;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    std::vector<MeshLod> lods;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    unsigned long long geometryHash;
+
+};
+
+
+#endif
@@ -0,0 +1,144 @@
+#include "streambuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLsizeiptr regionSize)
+    :
+    buffer_id(0),
+    regionSize(0),
+    current(0),
+    persistent(false),
+    mapped(NULL),
+    waits(0)
+{
+    for (int i = 0; i < REGIONS; i++) {
+        fences[i] = 0;
+    }
+    allocate(regionSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    release();
+}
+
+void StreamBuffer::allocate(GLsizeiptr size)
+{
+    // regions are bound with glBindBufferRange, so they start at the strictest offset alignment
+    GLint uniformAlignment = 0;
+    GLint storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    GLsizeiptr alignment = std::max(GLsizeiptr(16), GLsizeiptr(std::max(uniformAlignment, storageAlignment)));
+    regionSize = (std::max(size, GLsizeiptr(1)) + alignment - 1) / alignment * alignment;
+    current = 0;
+
+    glGenBuffers(1, &buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    persistent = glBufferStorage != NULL;
+    if (persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, regionSize * REGIONS, NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionSize * REGIONS, flags);
+    }
+#endif
+    if (!persistent)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, regionSize * REGIONS, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::release()
+{
+    for (int i = 0; i < REGIONS; i++)
+    {
+        if (fences[i] != 0) {
+            glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+    if (buffer_id != 0)
+    {
+        if (mapped != NULL)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mapped = NULL;
+        }
+        glDeleteBuffers(1, &buffer_id);
+        buffer_id = 0;
+    }
+}
+
+void StreamBuffer::reserve(GLsizeiptr size)
+{
+    if (size <= regionSize) {
+        return;
+    }
+    // immutable storage can't grow, start over with a new buffer (the driver keeps the
+    // old one alive until the commands reading it are done)
+    release();
+    allocate(size);
+}
+
+void StreamBuffer::waitRegion(int region)
+{
+    if (fences[region] == 0) {
+        return;
+    }
+    GLenum result = glClientWaitSync(fences[region], 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        waits++;
+        // flush so the fence is guaranteed to signal, then block for as long as it takes
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        do {
+            result = glClientWaitSync(fences[region], flags, 1000000);
+            flags = 0;
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fences[region]);
+    fences[region] = 0;
+}
+
+void* StreamBuffer::beginWrite()
+{
+    // everything issued so far may read the region we leave
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % REGIONS;
+    waitRegion(current);
+    if (persistent) {
+        return mapped + getOffset();
+    }
+    // the fence already guarantees the region is free, so the driver must not synchronize
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, getOffset(), regionSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::endWrite()
+{
+    // coherent persistent writes are visible to every command issued afterwards
+    if (!persistent)
+    {
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void StreamBuffer::write(const void* data, GLsizeiptr size)
+{
+    reserve(size);
+    memcpy(beginWrite(), data, size);
+    endWrite();
+}
+
+void StreamBuffer::bindRange(GLenum target, GLuint index, GLsizeiptr size) const
+{
+    glBindBufferRange(target, index, buffer_id, getOffset(), std::max(size, GLsizeiptr(1)));
+}
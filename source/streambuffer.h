@@ -0,0 +1,58 @@
+#ifndef _STREAM_BUFFER_H_
+#define _STREAM_BUFFER_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+// Ring buffer for data the CPU rewrites while the GPU may still read older copies.
+// The storage is split into REGIONS regions and stays mapped for its whole lifetime
+// (glBufferStorage with persistent coherent mapping), so writes never reallocate or
+// orphan anything. A region is fenced when the writer moves on to the next one, so the fence
+// covers every command that could have read it; beginWrite() only waits when the GPU still
+// reads the region being reused, which with 3 regions means it is that many writes behind.
+// Without GL 4.4 / ARB_buffer_storage the regions are mapped unsynchronized per write.
+class StreamBuffer
+{
+public:
+    static const int REGIONS = 3;
+
+    // create storage for REGIONS copies of regionSize bytes
+    StreamBuffer(GLsizeiptr regionSize);
+    ~StreamBuffer();
+    // Grow the regions to hold at least regionSize bytes (a new buffer, only for rare resizes)
+    void reserve(GLsizeiptr regionSize);
+    // Fence the current region, move to the next one, wait until the GPU is done with it
+    // and return its write pointer
+    void* beginWrite();
+    // Finish writing the current region
+    void endWrite();
+    // Copy size bytes into the next region (beginWrite + memcpy + endWrite)
+    void write(const void* data, GLsizeiptr size);
+    // Attach the current region to an indexed binding point (uniform or shader storage)
+    void bindRange(GLenum target, GLuint index, GLsizeiptr size) const;
+
+    GLuint getBuffer() const { return buffer_id; }
+    GLintptr getOffset() const { return GLintptr(current) * regionSize; }
+    GLsizeiptr getRegionSize() const { return regionSize; }
+    // number of writes that had to wait for the GPU
+    int getWaitCount() const { return waits; }
+
+private:
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+
+    void allocate(GLsizeiptr size);
+    void release();
+    void waitRegion(int region);
+
+    GLuint buffer_id;             // buffer object id
+    GLsizeiptr regionSize;        // bytes per region, a multiple of the binding offset alignment
+    int current;                  // region written last (and bound)
+    bool persistent;              // persistently mapped storage is available
+    unsigned char* mapped;        // start of the persistent mapping, NULL on the fallback path
+    GLsync fences[REGIONS];       // last GPU use of every region
+    int waits;
+
+};
+
+
+#endif
@@ -0,0 +1,105 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(int threads)
+    :
+    running(0),
+    stopping(false)
+{
+    if (threads <= 0) {
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::runOne(std::unique_lock<std::mutex>& lock)
+{
+    if (jobs.empty()) {
+        return false;
+    }
+    std::function<void()> job = std::move(jobs.front());
+    jobs.pop_front();
+    running++;
+    lock.unlock();
+    job();
+    lock.lock();
+    running--;
+    finished.notify_all();
+    return true;
+}
+
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping && jobs.empty()) {
+            return;
+        }
+        runOne(lock);
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& task, int minChunk)
+{
+    if (count <= 0) {
+        return;
+    }
+    // a few chunks per thread even out rows that take longer than others
+    int chunks = std::min(getThreadCount() * 4, (count + minChunk - 1) / std::max(1, minChunk));
+    if (chunks <= 1) {
+        task(0, count);
+        return;
+    }
+
+    std::atomic<int> pending(chunks);
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int chunk = 0; chunk < chunks; chunk++)
+    {
+        int begin = int((long long)count * chunk / chunks);
+        int end = int((long long)count * (chunk + 1) / chunks);
+        jobs.emplace_back([&task, &pending, begin, end] {
+            task(begin, end);
+            pending--;  // the waiter is notified once runOne() holds the mutex again
+        });
+    }
+    wake.notify_all();
+
+    // help out instead of just waiting
+    while (pending > 0)
+    {
+        if (!runOne(lock)) {
+            finished.wait(lock);
+        }
+    }
+}
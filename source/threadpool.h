@@ -0,0 +1,43 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel CPU work.
+// parallelFor() cuts a range into chunks that the workers and the calling thread pick up
+// until none are left, so a pool of one thread still makes progress on the caller.
+class ThreadPool
+{
+public:
+    // threads == 0 starts one worker per hardware thread (minus the caller)
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+    // run task(begin, end) over [0, count) in chunks of at least minChunk items, returns when all are done
+    void parallelFor(int count, const std::function<void(int, int)>& task, int minChunk = 1);
+    // queue a job for the workers and return right away (a pool without workers runs it here)
+    void submit(std::function<void()> job);
+    // threads working on a parallelFor(), the caller included
+    int getThreadCount() const { return int(workers.size()) + 1; }
+
+private:
+    void workerLoop();
+    // run one queued job, false when the queue is empty
+    bool runOne(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;       // signals new jobs or shutdown
+    std::condition_variable finished;   // signals a completed job
+    int running;                        // jobs taken but not done yet
+    bool stopping;
+
+};
+
+
+#endif
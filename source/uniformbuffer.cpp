@@ -0,0 +1,16 @@
+#include "uniformbuffer.h"
+
+UniformBuffer::UniformBuffer(GLsizeiptr size, GLuint binding)
+    :
+    stream(size),
+    size(size),
+    binding(binding)
+{
+    stream.bindRange(GL_UNIFORM_BUFFER, binding, size);
+}
+
+void UniformBuffer::update(const void* data)
+{
+    stream.write(data, size);
+    stream.bindRange(GL_UNIFORM_BUFFER, binding, size);
+}
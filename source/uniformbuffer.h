@@ -0,0 +1,49 @@
+#ifndef _UNIFORM_BUFFER_H_
+#define _UNIFORM_BUFFER_H_
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include "streambuffer.h"
+
+// std140 mirror of the ViewConstants block: camera data shared by every program
+// that draws from the camera's point of view
+struct ViewConstants
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPos;            // xyz - camera position
+    glm::mat4 inverseViewProjection;  // clip space -> world space (compact G-buffer positions)
+};
+
+// std140 mirror of the FrameConstants block: global light data of the frame
+struct FrameConstants
+{
+    glm::mat4 lightSpaceMatrix;
+    glm::vec4 lightPosition;      // xyz - global light position
+    glm::vec4 lightColor;         // rgb - global light color
+    glm::vec4 lightAttenuation;   // x - linear, y - quadratic
+};
+
+// Uniform Buffer Object bound to a fixed binding point.
+// Every program declaring the block at that binding sees the new contents after a single
+// update() per frame. The block lives in a StreamBuffer, so an update writes a fresh region
+// while the GPU may still read the previous frames' copies.
+class UniformBuffer
+{
+public:
+    // create the buffer and attach it to the binding point
+    UniformBuffer(GLsizeiptr size, GLuint binding);
+    // Replace the whole contents and bind the written region
+    void update(const void* data);
+    GLuint getBinding() const { return binding; }
+
+private:
+    StreamBuffer stream;          // ring of block copies
+    GLsizeiptr size;              // size of the block in bytes
+    GLuint binding;               // uniform block binding point
+
+};
+
+
+#endif